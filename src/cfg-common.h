@@ -151,6 +151,8 @@ const m_option_t common_opts[] = {
     {"msgmodule", &mp_msg_module, CONF_TYPE_FLAG, CONF_GLOBAL, 0, 1, NULL},
     {"nomsgmodule", &mp_msg_module, CONF_TYPE_FLAG, CONF_GLOBAL, 1, 0, NULL},
     {"msgcharset", &mp_msg_charset, CONF_TYPE_STRING, CONF_GLOBAL, 0, 0, NULL},
+    {"msgasync", &mp_msg_async, CONF_TYPE_FLAG, CONF_GLOBAL, 0, 1, NULL},
+    {"nomsgasync", &mp_msg_async, CONF_TYPE_FLAG, CONF_GLOBAL, 1, 0, NULL},
     {"include", cfg_include, CONF_TYPE_FUNC_PARAM_IMMEDIATE, CONF_NOSAVE, 0, 0, NULL},
     {"noconfig", noconfig_opts, CONF_TYPE_SUBCONFIG, CONF_GLOBAL|CONF_NOCFG|CONF_PRE_PARSE, 0, 0, NULL},
 
@@ -257,6 +259,8 @@ const m_option_t common_opts[] = {
     {"sub-bg-alpha", &sub_bg_alpha, CONF_TYPE_INT, CONF_RANGE, 0, 255, NULL},
     {"sub-no-text-pp", &sub_no_text_pp, CONF_TYPE_FLAG, 0, 0, 1, NULL},
     {"sub-fuzziness", &sub_match_fuzziness, CONF_TYPE_INT, CONF_RANGE, 0, 2, NULL},
+    {"sub-stream", &sub_stream_load, CONF_TYPE_FLAG, 0, 0, 1, NULL},
+    {"nosub-stream", &sub_stream_load, CONF_TYPE_FLAG, 0, 1, 0, NULL},
     {"font", &font_name, CONF_TYPE_STRING, 0, 0, 0, NULL},
     {"subfont", &sub_font_name, CONF_TYPE_STRING, 0, 0, 0, NULL},
     {"ffactor", &font_factor, CONF_TYPE_FLOAT, CONF_RANGE, 0.0, 10.0, NULL},
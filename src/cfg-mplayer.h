@@ -179,6 +179,11 @@ const m_option_t mplayer_opts[]={
     {"noframedrop", &frame_dropping, CONF_TYPE_FLAG, 0, 1, 0, NULL},
 
     {"benchmark", &benchmark, CONF_TYPE_FLAG, 0, 0, 1, NULL},
+    {"parallel-init", &parallel_init, CONF_TYPE_FLAG, 0, 0, 1, NULL},
+    {"noparallel-init", &parallel_init, CONF_TYPE_FLAG, 0, 1, 0, NULL},
+    {"gapless", &gapless_playback, CONF_TYPE_FLAG, 0, 0, 1, NULL},
+    {"nogapless", &gapless_playback, CONF_TYPE_FLAG, 0, 1, 0, NULL},
+    {"prefetch", &prefetch_entries, CONF_TYPE_INT, CONF_RANGE, 0, 64, NULL},
 
     {"gui", "The -gui option will only work as the first command line argument.\n", CONF_TYPE_PRINT, 0, 0, 0, PRIV_NO_EXIT},
     {"nogui", "The -nogui option will only work as the first command line argument.\n", CONF_TYPE_PRINT, 0, 0, 0, PRIV_NO_EXIT},
@@ -196,8 +201,12 @@ const m_option_t mplayer_opts[]={
     {"nocorrect-pts", &user_correct_pts, CONF_TYPE_FLAG, 0, 1, 0, NULL},
     {"noautosync", &autosync, CONF_TYPE_FLAG, 0, 0, -1, NULL},
     {"autosync", &autosync, CONF_TYPE_INT, CONF_RANGE, 0, 10000, NULL},
+    {"hr-seek", &hr_seek, CONF_TYPE_FLAG, 0, 0, 1, NULL},
+    {"nohr-seek", &hr_seek, CONF_TYPE_FLAG, 0, 1, 0, NULL},
 
     {"softsleep", &softsleep, CONF_TYPE_FLAG, 0, 0, 1, NULL},
+    {"display-sync", &display_sync, CONF_TYPE_FLAG, 0, 0, 1, NULL},
+    {"nodisplay-sync", &display_sync, CONF_TYPE_FLAG, 0, 1, 0, NULL},
     {"nortc", &nortc, CONF_TYPE_FLAG, 0, 0, 1, NULL},
     {"rtc", &nortc, CONF_TYPE_FLAG, 0, 1, 0, NULL},
     {"rtc-device", &rtc_device, CONF_TYPE_STRING, 0, 0, 0, NULL},
@@ -205,9 +214,11 @@ const m_option_t mplayer_opts[]={
     {"term-osd", &term_osd, CONF_TYPE_FLAG, 0, 0, 1, NULL},
     {"noterm-osd", &term_osd, CONF_TYPE_FLAG, 0, 1, 0, NULL},
     {"term-osd-esc", &term_osd_esc, CONF_TYPE_STRING, 0, 0, 1, NULL},
+    {"status-interval", &status_interval, CONF_TYPE_INT, CONF_RANGE, 0, 10000, NULL},
     {"playing-msg", &playing_msg, CONF_TYPE_STRING, 0, 0, 0, NULL},
 
     {"slave", &slave_mode, CONF_TYPE_FLAG,CONF_GLOBAL , 0, 1, NULL},
+    {"ipc-socket", &ipc_socket_path, CONF_TYPE_STRING, CONF_GLOBAL, 0, 0, NULL},
     {"idle", &player_idle_mode, CONF_TYPE_FLAG,CONF_GLOBAL , 0, 1, NULL},
     {"noidle", &player_idle_mode, CONF_TYPE_FLAG,CONF_GLOBAL , 1, 0, NULL},
     {"use-stdin", "-use-stdin has been renamed to -noconsolecontrols, use that instead.", CONF_TYPE_PRINT, 0, 0, 0, NULL},
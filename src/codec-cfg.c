@@ -511,6 +511,240 @@ static unsigned codec_addstr(const char *s)
     return codec_strs_len - len;
 }
 
+/* fourcc index
+ *
+ * The fourccs of a codec list are hashed into buckets, and each bucket
+ * gets a seed that maps all its fourccs to slots no other fourcc uses
+ * ("hash and displace"), so a lookup is a single probe. The index for the
+ * builtin codecs.conf is generated by codec-cfg into codecs.conf.h, for an
+ * external codecs.conf it is built when loading it. */
+
+#define INDEX_MAX_SEED 0x100000
+#define INDEX_NO_FOURCC 0xffffffff  ///< unused fourcc[] entry
+
+static codecs_index_t video_index;
+static codecs_index_t audio_index;
+static int index_allocated;
+
+typedef struct {
+    unsigned int  fourcc;
+    codecs_cand_t cand;
+} index_entry_t;
+
+static unsigned int fourcc_hash(unsigned int fourcc, unsigned int seed)
+{
+    unsigned int h = (fourcc ^ seed) * 0x9E3779B1;
+    h ^= h >> 15;
+    h *= 0x85EBCA6B;
+    h ^= h >> 13;
+    return h;
+}
+
+static int cmp_index_entry(const void *a, const void *b)
+{
+    const index_entry_t *x = a, *y = b;
+    if (x->fourcc != y->fourcc)
+        return x->fourcc < y->fourcc ? -1 : 1;
+    return x->cand.codec - y->cand.codec;
+}
+
+static void free_codecs_index(codecs_index_t *idx)
+{
+    free((void *)idx->seeds);
+    free((void *)idx->keys);
+    free((void *)idx->first);
+    free((void *)idx->cand);
+    free((void *)idx->dummy);
+    memset(idx, 0, sizeof(*idx));
+}
+
+/**
+ * \brief Assign a seed to every bucket so that no two keys share a slot.
+ * \param key_bucket bucket of each key
+ * \param slot_key receives the key of each slot, -1 for unused slots
+ * \return 0 if some bucket could not be placed
+ */
+static int place_buckets(const unsigned int *keys, int nr_keys,
+                         const unsigned int *key_bucket, int *next,
+                         unsigned int *seeds, unsigned int nr_buckets,
+                         int *slot_key, unsigned int slot_mask)
+{
+    int *head = malloc(nr_buckets * sizeof(*head));
+    unsigned int *size = calloc(nr_buckets, sizeof(*size));
+    unsigned int b, max_size = 0, n;
+    int k, ok = 0;
+
+    if (!head || !size)
+        goto out;
+    for (b = 0; b < nr_buckets; b++)
+        head[b] = -1;
+    for (k = 0; k < nr_keys; k++) {
+        b = key_bucket[k];
+        next[k] = head[b];
+        head[b] = k;
+        if (++size[b] > max_size)
+            max_size = size[b];
+    }
+    for (b = 0; b <= slot_mask; b++)
+        slot_key[b] = -1;
+
+    // the largest buckets are the hardest to place, do them first
+    for (n = max_size; n > 0; n--)
+        for (b = 0; b < nr_buckets; b++) {
+            unsigned int seed;
+            if (size[b] != n)
+                continue;
+            for (seed = 1; seed < INDEX_MAX_SEED; seed++) {
+                for (k = head[b]; k >= 0; k = next[k]) {
+                    unsigned int slot = fourcc_hash(keys[k], seed) & slot_mask;
+                    if (slot_key[slot] >= 0)
+                        break;
+                    slot_key[slot] = k;
+                }
+                if (k < 0)
+                    break;
+                // undo the keys placed so far
+                for (k = head[b]; k >= 0; k = next[k]) {
+                    unsigned int slot = fourcc_hash(keys[k], seed) & slot_mask;
+                    if (slot_key[slot] != k)
+                        break;
+                    slot_key[slot] = -1;
+                }
+            }
+            if (seed == INDEX_MAX_SEED)
+                goto out;
+            seeds[b] = seed;
+        }
+    ok = 1;
+out:
+    free(head);
+    free(size);
+    return ok;
+}
+
+/**
+ * \brief Build the fourcc index of a codec list.
+ * \return 0 if out of memory
+ */
+static int build_codecs_index(codecs_index_t *idx, const codecs_t *codecs, int nr)
+{
+    index_entry_t *e = NULL;
+    unsigned int *keys = NULL, *key_start = NULL, *key_bucket = NULL;
+    unsigned int *seeds = NULL, *slot_keys = NULL, *first = NULL;
+    unsigned int nr_buckets, slot_mask;
+    unsigned short *dummy = NULL;
+    codecs_cand_t *cand = NULL;
+    int *next = NULL, *slot_key = NULL;
+    int nr_e = 0, nr_keys = 0, nr_dummy = 0;
+    int i, j, k, ok = 0;
+
+    memset(idx, 0, sizeof(*idx));
+    e     = malloc((nr * CODECS_MAX_FOURCC + 1) * sizeof(*e));
+    dummy = malloc((nr + 1) * sizeof(*dummy));
+    if (!e || !dummy)
+        goto out;
+    for (i = 0; i < nr; i++) {
+        if (codecs[i].flags & CODECS_FLAG_DUMMY) {
+            dummy[nr_dummy++] = i;
+            continue;
+        }
+        for (j = 0; j < CODECS_MAX_FOURCC; j++) {
+            unsigned int fourcc = codecs[i].fourcc[j];
+            if (fourcc == INDEX_NO_FOURCC)
+                continue;
+            // find_codec() uses the first occurrence
+            for (k = 0; k < j; k++)
+                if (codecs[i].fourcc[k] == fourcc)
+                    break;
+            if (k < j)
+                continue;
+            e[nr_e].fourcc     = fourcc;
+            e[nr_e].cand.codec = i;
+            e[nr_e].cand.slot  = j;
+            nr_e++;
+        }
+    }
+    qsort(e, nr_e, sizeof(*e), cmp_index_entry);
+
+    keys      = malloc((nr_e + 1) * sizeof(*keys));
+    key_start = malloc((nr_e + 1) * sizeof(*key_start));
+    if (!keys || !key_start)
+        goto out;
+    for (i = 0; i < nr_e; i++)
+        if (!i || e[i].fourcc != e[i - 1].fourcc) {
+            keys[nr_keys]      = e[i].fourcc;
+            key_start[nr_keys] = i;
+            nr_keys++;
+        }
+    key_start[nr_keys] = nr_e;
+
+    // about 4 keys per bucket, half of the slots used
+    for (nr_buckets = 1; nr_buckets * 4 < nr_keys; nr_buckets *= 2)
+        ;
+    for (slot_mask = 1; slot_mask + 1 < 2 * nr_keys; slot_mask = 2 * slot_mask + 1)
+        ;
+    key_bucket = malloc((nr_keys + 1) * sizeof(*key_bucket));
+    next       = malloc((nr_keys + 1) * sizeof(*next));
+    seeds      = calloc(nr_buckets, sizeof(*seeds));
+    if (!key_bucket || !next || !seeds)
+        goto out;
+    for (k = 0; k < nr_keys; k++)
+        key_bucket[k] = fourcc_hash(keys[k], 0) & (nr_buckets - 1);
+    for (;;) {
+        free(slot_key);
+        if (!(slot_key = malloc((slot_mask + 1) * sizeof(*slot_key))))
+            goto out;
+        if (place_buckets(keys, nr_keys, key_bucket, next, seeds, nr_buckets,
+                          slot_key, slot_mask))
+            break;
+        slot_mask = 2 * slot_mask + 1;
+    }
+
+    slot_keys = malloc((slot_mask + 1) * sizeof(*slot_keys));
+    first     = malloc((slot_mask + 2) * sizeof(*first));
+    cand      = malloc((nr_e + 1) * sizeof(*cand));
+    if (!slot_keys || !first || !cand)
+        goto out;
+    first[0] = 0;
+    for (i = 0; i <= slot_mask; i++) {
+        int n = 0;
+        k = slot_key[i];
+        slot_keys[i] = 0;
+        if (k >= 0) {
+            slot_keys[i] = keys[k];
+            for (j = key_start[k]; j < key_start[k + 1]; j++)
+                cand[first[i] + n++] = e[j].cand;
+        }
+        first[i + 1] = first[i] + n;
+    }
+
+    idx->bucket_mask = nr_buckets - 1;
+    idx->slot_mask   = slot_mask;
+    idx->seeds       = seeds;
+    idx->keys        = slot_keys;
+    idx->first       = first;
+    idx->cand        = cand;
+    idx->dummy       = dummy;
+    idx->nr_dummy    = nr_dummy;
+    seeds = slot_keys = first = NULL;
+    cand  = NULL;
+    dummy = NULL;
+    ok = 1;
+out:
+    free(e);
+    free(keys);
+    free(key_start);
+    free(key_bucket);
+    free(next);
+    free(slot_key);
+    free(seeds);
+    free(slot_keys);
+    free(first);
+    free(cand);
+    free(dummy);
+    return ok;
+}
+
 int parse_codec_cfg(const char *cfgfile)
 {
     codecs_t *codec = NULL; // current codec
@@ -537,6 +771,8 @@ int parse_codec_cfg(const char *cfgfile)
         nr_acodecs = sizeof(builtin_audio_codecs)/sizeof(codecs_t);
         codec_strs = builtin_codec_strs;
         codec_strs_len = sizeof(builtin_codec_strs);
+        video_index = builtin_video_index;
+        audio_index = builtin_audio_index;
         return 1;
 #endif
     }
@@ -744,6 +980,13 @@ int parse_codec_cfg(const char *cfgfile)
     mp_msg(MSGT_CODECCFG,MSGL_INFO,MSGTR_AudioVideoCodecTotals, nr_acodecs, nr_vcodecs);
     if(video_codecs) video_codecs[nr_vcodecs].name_idx = 0;
     if(audio_codecs) audio_codecs[nr_acodecs].name_idx = 0;
+    // without an index find_codec() falls back to scanning the list
+    index_allocated = 1;
+    if (!build_codecs_index(&video_index, video_codecs, nr_vcodecs) ||
+        !build_codecs_index(&audio_index, audio_codecs, nr_acodecs)) {
+        free_codecs_index(&video_index);
+        free_codecs_index(&audio_index);
+    }
 out:
     free(line);
     line=NULL;
@@ -771,6 +1014,13 @@ err_out_release_num:
 }
 
 void codecs_uninit_free(void) {
+    if (index_allocated) {
+        free_codecs_index(&video_index);
+        free_codecs_index(&audio_index);
+    }
+    memset(&video_index, 0, sizeof(video_index));
+    memset(&audio_index, 0, sizeof(audio_index));
+    index_allocated = 0;
     free(video_codecs);
     video_codecs=NULL;
     free(audio_codecs);
@@ -792,21 +1042,59 @@ codecs_t *find_video_codec(unsigned int fourcc, unsigned int *fourccmap,
     return find_codec(fourcc, fourccmap, start, 0, force);
 }
 
+static codecs_t *find_codec_indexed(const codecs_index_t *idx,
+                                    codecs_t *codecs, int nr,
+                                    unsigned int fourcc, unsigned int *fourccmap,
+                                    codecs_t *start)
+{
+    unsigned int from = start ? start - codecs + 1 : 0;
+    unsigned int best = nr, slot = 0, k;
+    unsigned int seed = idx->seeds[fourcc_hash(fourcc, 0) & idx->bucket_mask];
+    unsigned int s    = fourcc_hash(fourcc, seed) & idx->slot_mask;
+
+    if (idx->keys[s] == fourcc)
+        for (k = idx->first[s]; k < idx->first[s + 1]; k++)
+            if (idx->cand[k].codec >= from) {
+                best = idx->cand[k].codec;
+                slot = idx->cand[k].slot;
+                break;
+            }
+    for (k = 0; k < idx->nr_dummy; k++)
+        if (idx->dummy[k] >= from) {
+            if (idx->dummy[k] < best) {
+                best = idx->dummy[k];
+                slot = 0;
+            }
+            break;
+        }
+    if (best >= nr)
+        return NULL;
+    if (fourccmap)
+        *fourccmap = codecs[best].fourccmap[slot];
+    return codecs + best;
+}
+
 codecs_t* find_codec(unsigned int fourcc,unsigned int *fourccmap,
                      codecs_t *start, int audioflag, int force)
 {
     int i, j;
     codecs_t *c;
+    const codecs_index_t *idx;
 
     {
         if (audioflag) {
             i = nr_acodecs;
             c = audio_codecs;
+            idx = &audio_index;
         } else {
             i = nr_vcodecs;
             c = video_codecs;
+            idx = &video_index;
         }
         if(!i) return NULL;
+        // with force the next codec is returned anyway, no need to look up
+        if (!force && idx->keys && fourcc != INDEX_NO_FOURCC)
+            return find_codec_indexed(idx, c, i, fourcc, fourccmap, start);
         for (/* NOTHING */; i--; c++) {
             if(start && c<=start) continue;
             for (j = 0; j < CODECS_MAX_FOURCC; j++) {
@@ -978,6 +1266,54 @@ static void print_char_array(const unsigned char* a, int size)
     printf(" }");
 }
 
+static void print_uint_list(const char *type, const char *name,
+                            const unsigned int *a, int size)
+{
+    int i;
+    printf("static const %s %s[] = {", type, name);
+    for (i = 0; i < size; i++)
+        printf("%s%s0x%X", i ? "," : "", i % 8 ? " " : "\n    ", a[i]);
+    if (!size)
+        printf(" 0");
+    printf("\n};\n\n");
+}
+
+static void print_codecs_index(const char *name, const codecs_index_t *idx)
+{
+    char arr[64];
+    unsigned int *dummy = malloc((idx->nr_dummy + 1) * sizeof(*dummy));
+    int nr_cand = idx->first[idx->slot_mask + 1];
+    int i;
+
+    snprintf(arr, sizeof(arr), "%s_seeds", name);
+    print_uint_list("unsigned int", arr, idx->seeds, idx->bucket_mask + 1);
+    snprintf(arr, sizeof(arr), "%s_keys", name);
+    print_uint_list("unsigned int", arr, idx->keys, idx->slot_mask + 1);
+    snprintf(arr, sizeof(arr), "%s_first", name);
+    print_uint_list("unsigned int", arr, idx->first, idx->slot_mask + 2);
+
+    printf("static const codecs_cand_t %s_cand[] = {", name);
+    for (i = 0; i < nr_cand; i++)
+        printf("%s%s{ %d, %d }", i ? "," : "", i % 6 ? " " : "\n    ",
+               idx->cand[i].codec, idx->cand[i].slot);
+    if (!nr_cand)
+        printf(" { 0, 0 }");
+    printf("\n};\n\n");
+
+    for (i = 0; i < idx->nr_dummy; i++)
+        dummy[i] = idx->dummy[i];
+    snprintf(arr, sizeof(arr), "%s_dummy", name);
+    print_uint_list("unsigned short", arr, dummy, idx->nr_dummy);
+    free(dummy);
+
+    printf("const codecs_index_t %s = {\n"
+           "    0x%X, 0x%X,\n"
+           "    %s_seeds, %s_keys, %s_first, %s_cand,\n"
+           "    %s_dummy, %d\n};\n\n",
+           name, idx->bucket_mask, idx->slot_mask,
+           name, name, name, name, name, idx->nr_dummy);
+}
+
 int main(int argc, char* argv[])
 {
     codecs_t *cl;
@@ -1063,7 +1399,11 @@ int main(int argc, char* argv[])
         }
         printf("const char builtin_codec_strs[] = ");
         print_char_array(codec_strs, codec_strs_len);
-        printf(";\n");
+        printf(";\n\n");
+        if (!video_index.keys || !audio_index.keys)
+            exit(1);
+        print_codecs_index("builtin_video_index", &video_index);
+        print_codecs_index("builtin_audio_index", &audio_index);
         exit(0);
     }
 
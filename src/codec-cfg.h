@@ -77,6 +77,27 @@ typedef struct codecs {
     short cpuflags;
 } codecs_t;
 
+typedef struct {
+    unsigned short codec;   ///< index in the codec list
+    unsigned char  slot;    ///< index in its fourcc[]/fourccmap[]
+} codecs_cand_t;
+
+/* fourcc -> codecs lookup table, a two level perfect hash:
+ * seed = seeds[hash(fourcc, 0) & bucket_mask],
+ * slot = hash(fourcc, seed) & slot_mask.
+ * If keys[slot] == fourcc, cand[first[slot]] .. cand[first[slot + 1] - 1]
+ * are the codecs listing that fourcc, in codecs.conf order. */
+typedef struct {
+    unsigned int          bucket_mask;
+    unsigned int          slot_mask;
+    const unsigned int   *seeds;
+    const unsigned int   *keys;
+    const unsigned int   *first;
+    const codecs_cand_t  *cand;
+    const unsigned short *dummy;    ///< codecs flagged dummy, they match any fourcc
+    int                   nr_dummy;
+} codecs_index_t;
+
 int parse_codec_cfg(const char *cfgfile);
 codecs_t* find_video_codec(unsigned int fourcc, unsigned int *fourccmap,
                            codecs_t *start, int force);
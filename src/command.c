@@ -34,6 +34,7 @@
 #include "mplayer.h"
 #include "sub/sub.h"
 #include "m_option.h"
+#include "m_config.h"
 #include "m_property.h"
 #include "help_mp.h"
 #include "metadata.h"
@@ -1072,6 +1073,28 @@ static int mp_property_aspect(m_option_t *prop, int action, void *arg,
     return m_property_float_ro(prop, action, arg, mpctx->sh_video->aspect);
 }
 
+/// A-V desynchronization (RO)
+static int mp_property_avsync(m_option_t *prop, int action, void *arg,
+                              MPContext *mpctx)
+{
+    mp_stats_t st;
+    if (!mpctx->sh_audio || !mpctx->sh_video)
+        return M_PROPERTY_UNAVAILABLE;
+    mp_stats_get(&mpctx->stats, &st);
+    return m_property_float_ro(prop, action, arg, st.av_drift);
+}
+
+/// Number of dropped frames (RO)
+static int mp_property_frame_drop_count(m_option_t *prop, int action,
+                                        void *arg, MPContext *mpctx)
+{
+    mp_stats_t st;
+    if (!mpctx->sh_video)
+        return M_PROPERTY_UNAVAILABLE;
+    mp_stats_get(&mpctx->stats, &st);
+    return m_property_int_ro(prop, action, arg, st.drops);
+}
+
 ///@}
 
 /// \defgroup SubProprties Subtitles properties
@@ -1588,6 +1611,10 @@ static const m_option_t mp_properties[] = {
      0, 0, 0, NULL },
     { "aspect", mp_property_aspect, CONF_TYPE_FLOAT,
      0, 0, 0, NULL },
+    { "avsync", mp_property_avsync, CONF_TYPE_FLOAT,
+     0, 0, 0, NULL },
+    { "frame_drop_count", mp_property_frame_drop_count, CONF_TYPE_INT,
+     0, 0, 0, NULL },
     { "switch_video", mp_property_video, CONF_TYPE_INT,
      CONF_RANGE, -2, 65535, NULL },
     { "switch_program", mp_property_program, CONF_TYPE_INT,
@@ -1642,6 +1669,28 @@ void property_print_help(void)
     m_properties_print_help_list(mp_properties);
 }
 
+/// Tell the config about the option variables properties and commands
+/// write to, so leaving a playlist entry reverts them.
+void property_register_runtime_options(MPContext *mpctx,
+                                       struct m_config *config)
+{
+    // written by the property functions and commands themselves
+    void *vars[] = {
+        &osd_level, &mpctx->loop_times, &playback_speed, &audio_delay,
+        &start_volume, &audio_id, &video_id, &sub_id, &vo_ontop,
+        &vo_rootwin, &vo_border, &frame_dropping, &vo_vsync, &vo_panscan,
+        &sub_delay, &sub_pos, &sub_alignment, &sub_visibility,
+        &text_font_scale_factor
+    };
+    int i;
+
+    for (i = 0; i < sizeof(vars) / sizeof(vars[0]); i++)
+        m_config_register_runtime(config, vars[i]);
+    // properties that name their variable in the table, e.g. the gamma ones
+    for (i = 0; i < sizeof(mp_properties) / sizeof(mp_properties[0]); i++)
+        if (mp_properties[i].priv)
+            m_config_register_runtime(config, mp_properties[i].priv);
+}
 
 ///@}
 // Properties group
@@ -1783,7 +1832,7 @@ static int set_property_command(MPContext *mpctx, mp_cmd_t *cmd)
     return 1;
 }
 
-static const char *property_error_string(int error_value)
+const char *property_error_string(int error_value)
 {
     switch (error_value) {
     case M_PROPERTY_ERROR:
@@ -21,9 +21,13 @@
 
 struct MPContext;
 struct mp_cmd;
+struct m_config;
 
 int run_command(struct MPContext *mpctx, struct mp_cmd *cmd);
 char *property_expand_string(struct MPContext *mpctx, char *str);
 void property_print_help(void);
+void property_register_runtime_options(struct MPContext *mpctx,
+                                       struct m_config *config);
+const char *property_error_string(int error_value);
 
 #endif /* MPLAYER_COMMAND_H */
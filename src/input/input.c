@@ -26,6 +26,8 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <fcntl.h>
 #include <ctype.h>
 
@@ -357,6 +359,7 @@ typedef struct mp_input_fd {
   unsigned got_cmd : 1;
   unsigned no_select : 1;
   unsigned no_readfunc_retval : 1;
+  unsigned ready : 1;
   // These fields are for the cmd fds.
   char* buffer;
   int pos,size;
@@ -370,10 +373,22 @@ struct mp_cmd_filter {
   mp_cmd_filter_t* next;
 };
 
+/// Bindings are compiled into a trie on the key codes of the combination,
+/// each node keeps the children in a small open addressed hash table.
+typedef struct mp_bind_node mp_bind_node_t;
+
+struct mp_bind_node {
+  int key;
+  char* cmd;                ///< bound command, NULL on pure prefix nodes
+  mp_cmd_t* parsed;         ///< cmd parsed once, NULL for "ignore" and invalid commands
+  mp_bind_node_t** child;
+  int num_child, child_size;
+};
+
 typedef struct mp_cmd_bind_section mp_cmd_bind_section_t;
 
 struct mp_cmd_bind_section {
-  mp_cmd_bind_t* cmd_binds;
+  mp_bind_node_t* cmd_binds;
   char* section;
   mp_cmd_bind_section_t* next;
 };
@@ -381,8 +396,10 @@ struct mp_cmd_bind_section {
 // These are the user defined binds
 static mp_cmd_bind_section_t* cmd_binds_section = NULL;
 static char* section = NULL;
-static mp_cmd_bind_t* cmd_binds = NULL;
-static mp_cmd_bind_t* cmd_binds_default = NULL;
+static mp_bind_node_t* cmd_binds = NULL;
+static mp_bind_node_t* cmd_binds_default = NULL;
+// def_cmd_binds, compiled on first use
+static mp_bind_node_t* def_cmd_binds_trie = NULL;
 static mp_cmd_filter_t* cmd_filters = NULL;
 
 // Callback to allow the menu filter to grab the incoming keys
@@ -396,8 +413,19 @@ static mp_input_fd_t key_fds[MP_MAX_KEY_FD];
 static unsigned int num_key_fd = 0;
 static mp_input_fd_t cmd_fds[MP_MAX_CMD_FD];
 static unsigned int num_cmd_fd = 0;
-static mp_cmd_t* cmd_queue[CMD_QUEUE_SIZE];
-static unsigned int cmd_queue_length = 0,cmd_queue_start = 0, cmd_queue_end = 0;
+
+// Commands can be queued from any thread. Producers push onto a lock-free
+// LIFO list, the main thread takes the whole list in one go and appends it
+// reversed to its private FIFO. Since nodes are never popped one by one from
+// the shared list there is no ABA problem.
+static mp_cmd_t* volatile cmd_queue_in = NULL;
+static mp_cmd_t* cmd_queue_head = NULL, *cmd_queue_tail = NULL;
+static volatile int cmd_queue_length = 0;
+
+// All pollable fds plus an eventfd signalled when the first command lands
+// in an empty queue.
+static int input_epoll_fd = -1;
+static int input_wake_fd = -1;
 
 // this is the key currently down
 static int key_down[MP_MAX_KEY_DOWN];
@@ -444,6 +472,60 @@ mp_input_default_cmd_func(int fd,char* buf, int l);
 static char*
 mp_input_get_key_name(int key);
 
+static void
+input_poll_init(void) {
+  struct epoll_event ev = { .events = EPOLLIN };
+
+  if(input_epoll_fd >= 0)
+    return;
+  input_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if(input_epoll_fd < 0) {
+    mp_msg(MSGT_INPUT,MSGL_ERR,"Can't create epoll instance: %s\n",strerror(errno));
+    return;
+  }
+  input_wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  ev.data.fd = input_wake_fd;
+  if(input_wake_fd < 0 ||
+     epoll_ctl(input_epoll_fd,EPOLL_CTL_ADD,input_wake_fd,&ev) < 0)
+    mp_msg(MSGT_INPUT,MSGL_ERR,"Can't set up input wakeup fd: %s\n",strerror(errno));
+}
+
+static void
+input_poll_uninit(void) {
+  if(input_wake_fd >= 0)
+    close(input_wake_fd);
+  if(input_epoll_fd >= 0)
+    close(input_epoll_fd);
+  input_wake_fd = input_epoll_fd = -1;
+}
+
+static void
+input_watch_fd(mp_input_fd_t* mfd) {
+  struct epoll_event ev = { .events = EPOLLIN };
+
+  if(mfd->no_select)
+    return;
+  input_poll_init();
+  if(input_epoll_fd < 0) {
+    mfd->no_select = 1;
+    return;
+  }
+  ev.data.fd = mfd->fd;
+  if(epoll_ctl(input_epoll_fd,EPOLL_CTL_ADD,mfd->fd,&ev) == 0 || errno == EEXIST)
+    return;
+  // Regular files and /dev/null can't be polled, they are always readable
+  // anyway so just try reading them on each pass.
+  if(errno != EPERM)
+    mp_msg(MSGT_INPUT,MSGL_WARN,"Can't poll input fd %d: %s\n",mfd->fd,strerror(errno));
+  mfd->no_select = 1;
+}
+
+static void
+input_unwatch_fd(mp_input_fd_t* mfd) {
+  if(!mfd->no_select && input_epoll_fd >= 0)
+    epoll_ctl(input_epoll_fd,EPOLL_CTL_DEL,mfd->fd,NULL);
+}
+
 
 int
 mp_input_add_cmd_fd(int fd, int select, mp_cmd_func_t read_func, mp_close_func_t close_func) {
@@ -461,6 +543,7 @@ mp_input_add_cmd_fd(int fd, int select, mp_cmd_func_t read_func, mp_close_func_t
   cmd_fds[num_cmd_fd].read_func = read_func ? read_func : mp_input_default_cmd_func;
   cmd_fds[num_cmd_fd].close_func = close_func;
   cmd_fds[num_cmd_fd].no_select = !select;
+  input_watch_fd(&cmd_fds[num_cmd_fd]);
   num_cmd_fd++;
 
   return 1;
@@ -476,6 +559,7 @@ mp_input_rm_cmd_fd(int fd) {
   }
   if(i == num_cmd_fd)
     return;
+  input_unwatch_fd(&cmd_fds[i]);
   if(cmd_fds[i].close_func)
     cmd_fds[i].close_func(cmd_fds[i].fd);
   free(cmd_fds[i].buffer);
@@ -495,6 +579,7 @@ mp_input_rm_key_fd(int fd) {
   }
   if(i == num_key_fd)
     return;
+  input_unwatch_fd(&key_fds[i]);
   if(key_fds[i].close_func)
     key_fds[i].close_func(key_fds[i].fd);
 
@@ -519,6 +604,7 @@ mp_input_add_key_fd(int fd, int select, mp_key_func_t read_func, mp_close_func_t
   key_fds[num_key_fd].read_func = read_func;
   key_fds[num_key_fd].close_func = close_func;
   key_fds[num_key_fd].no_select = !select;
+  input_watch_fd(&key_fds[num_key_fd]);
   num_key_fd++;
 
   return 1;
@@ -541,6 +627,7 @@ mp_input_add_event_fd(int fd, void (*read_func)(void))
   key_fds[num_key_fd].read_func = read_func;
   key_fds[num_key_fd].close_func = NULL;
   key_fds[num_key_fd].no_readfunc_retval = 1;
+  input_watch_fd(&key_fds[num_key_fd]);
   num_key_fd++;
 
   return 1;
@@ -574,8 +661,12 @@ int mp_input_parse_and_queue_cmds(const char *str) {
     return cmd_num;
 }
 
-mp_cmd_t*
-mp_input_parse_cmd(char* str) {
+/**
+ * \param def_pausing pausing mode of commands without a pausing prefix,
+ *                    bindings pass -1 to resolve it when the key is pressed
+ */
+static mp_cmd_t*
+parse_cmd(char* str, int def_pausing) {
   int i,l;
   int pausing = -1;
   char *ptr,*e;
@@ -633,7 +724,7 @@ mp_input_parse_cmd(char* str) {
       case MP_CMD_SET_MOUSE_POS:
         pausing = 4; break;
       default:
-        pausing = pausing_default; break;
+        pausing = def_pausing; break;
     }
   }
   cmd->pausing = pausing;
@@ -725,6 +816,11 @@ mp_input_parse_cmd(char* str) {
   return cmd;
 }
 
+mp_cmd_t*
+mp_input_parse_cmd(char* str) {
+  return parse_cmd(str, pausing_default);
+}
+
 #define MP_CMD_MAX_SIZE 4096
 
 static int
@@ -839,23 +935,113 @@ mp_input_add_cmd_filter(mp_input_cmd_filter func, void* ctx) {
 }
 
 
-static char*
-mp_input_find_bind_for_key(const mp_cmd_bind_t* binds, int n,int* keys) {
-  int j;
-
-  if (n <= 0) return NULL;
-  for(j = 0; binds[j].cmd != NULL; j++) {
-      int found = 1,s;
-      for(s = 0; s < n && binds[j].input[s] != 0; s++) {
-	if(binds[j].input[s] != keys[s]) {
-	  found = 0;
-	  break;
-	}
-      }
-      if(found && binds[j].input[s] == 0 && s == n)
-	break;
+static unsigned
+bind_hash(int key) {
+  return ((unsigned)key * 2654435761U) >> 8;
+}
+
+static mp_bind_node_t*
+bind_node_child(const mp_bind_node_t* node, int key) {
+  unsigned i, mask;
+
+  if(!node->child_size)
+    return NULL;
+  mask = node->child_size - 1;
+  for(i = bind_hash(key) & mask; node->child[i]; i = (i + 1) & mask)
+    if(node->child[i]->key == key)
+      return node->child[i];
+  return NULL;
+}
+
+static void
+bind_node_insert_child(mp_bind_node_t* node, mp_bind_node_t* child) {
+  unsigned i, mask = node->child_size - 1;
+
+  for(i = bind_hash(child->key) & mask; node->child[i]; i = (i + 1) & mask)
+    /* NOTHING */;
+  node->child[i] = child;
+}
+
+static mp_bind_node_t*
+bind_node_add_child(mp_bind_node_t* node, int key) {
+  mp_bind_node_t* child;
+
+  // keep the table at most half full
+  if(2 * (node->num_child + 1) > node->child_size) {
+    mp_bind_node_t** old = node->child;
+    int i, old_size = node->child_size;
+    node->child_size = old_size ? 2 * old_size : 4;
+    node->child = calloc(node->child_size, sizeof(*node->child));
+    for(i = 0; i < old_size; i++)
+      if(old[i])
+        bind_node_insert_child(node, old[i]);
+    free(old);
   }
-  return binds[j].cmd;
+  child = calloc(1, sizeof(*child));
+  child->key = key;
+  bind_node_insert_child(node, child);
+  node->num_child++;
+  return child;
+}
+
+static void
+bind_trie_free(mp_bind_node_t* node) {
+  int i;
+
+  if(!node)
+    return;
+  for(i = 0; i < node->child_size; i++)
+    bind_trie_free(node->child[i]);
+  free(node->child);
+  free(node->cmd);
+  mp_cmd_free(node->parsed);
+  free(node);
+}
+
+static void
+bind_trie_add(mp_bind_node_t** root, const int* keys, const char* cmd) {
+  mp_bind_node_t* node;
+  int i;
+
+  if(!*root)
+    *root = calloc(1, sizeof(**root));
+  node = *root;
+  for(i = 0; keys[i] != 0; i++) {
+    mp_bind_node_t* next = bind_node_child(node, keys[i]);
+    node = next ? next : bind_node_add_child(node, keys[i]);
+  }
+  free(node->cmd);
+  mp_cmd_free(node->parsed);
+  node->cmd = strdup(cmd);
+  node->parsed = NULL;
+  if(strcmp(cmd, "ignore") == 0)
+    return;
+  node->parsed = parse_cmd(node->cmd, -1);
+  if(!node->parsed) {
+    mp_msg(MSGT_INPUT,MSGL_ERR,MSGTR_INPUT_INPUT_ErrInvalidCommandForKey,mp_input_get_key_name(keys[0]));
+    for(i = 1; keys[i] != 0; i++)
+      mp_msg(MSGT_INPUT,MSGL_ERR,"-%s",mp_input_get_key_name(keys[i]));
+    mp_msg(MSGT_INPUT,MSGL_ERR," : %s             \n",cmd);
+  }
+}
+
+static const mp_bind_node_t*
+bind_trie_find(const mp_bind_node_t* node, int n, const int* keys) {
+  int i;
+
+  for(i = 0; node && i < n; i++)
+    node = bind_node_child(node, keys[i]);
+  return node && node->cmd ? node : NULL;
+}
+
+static const mp_bind_node_t*
+get_def_cmd_binds(void) {
+  int i;
+
+  if(!def_cmd_binds_trie)
+    for(i = 0; def_cmd_binds[i].cmd != NULL; i++)
+      bind_trie_add(&def_cmd_binds_trie, def_cmd_binds[i].input, def_cmd_binds[i].cmd);
+  return def_cmd_binds_trie;
 }
 
 static mp_cmd_bind_section_t*
@@ -883,17 +1069,17 @@ mp_input_get_bind_section(char *section) {
 
 static mp_cmd_t*
 mp_input_get_cmd_from_keys(int n,int* keys, int paused) {
-  char* cmd = NULL;
+  const mp_bind_node_t* bind = NULL;
   mp_cmd_t* ret;
 
   if(cmd_binds)
-    cmd = mp_input_find_bind_for_key(cmd_binds,n,keys);
-  if(cmd_binds_default && cmd == NULL)
-    cmd = mp_input_find_bind_for_key(cmd_binds_default,n,keys);
-  if(default_bindings && cmd == NULL)
-    cmd = mp_input_find_bind_for_key(def_cmd_binds,n,keys);
+    bind = bind_trie_find(cmd_binds,n,keys);
+  if(cmd_binds_default && bind == NULL)
+    bind = bind_trie_find(cmd_binds_default,n,keys);
+  if(default_bindings && bind == NULL)
+    bind = bind_trie_find(get_def_cmd_binds(),n,keys);
 
-  if(cmd == NULL) {
+  if(bind == NULL) {
     char key_name[100];
     int i;
     av_strlcpy(key_name, mp_input_get_key_name(keys[0]), sizeof(key_name));
@@ -904,17 +1090,12 @@ mp_input_get_cmd_from_keys(int n,int* keys, int paused) {
     mp_msg(MSGT_INPUT,MSGL_WARN,MSGTR_NoBindFound,key_name);
     return NULL;
   }
-  if (strcmp(cmd, "ignore") == 0) return NULL;
-  ret =  mp_input_parse_cmd(cmd);
-  if(!ret) {
-    mp_msg(MSGT_INPUT,MSGL_ERR,MSGTR_INPUT_INPUT_ErrInvalidCommandForKey,mp_input_get_key_name(key_down[0]));
-    if(  num_key_down > 1) {
-      unsigned int s;
-      for(s=1; s < num_key_down; s++)
-	mp_msg(MSGT_INPUT,MSGL_ERR,"-%s",mp_input_get_key_name(key_down[s]));
-    }
-    mp_msg(MSGT_INPUT,MSGL_ERR," : %s             \n",cmd);
-  }
+  // "ignore", invalid commands were reported when binding them
+  if(!bind->parsed)
+    return NULL;
+  ret = mp_cmd_clone(bind->parsed);
+  if(ret->pausing < 0)
+    ret->pausing = pausing_default;
   return ret;
 }
 
@@ -1015,6 +1196,31 @@ static mp_cmd_t *check_autorepeat(int paused)
 }
 
 
+static void mark_ready(const struct epoll_event *ev)
+{
+    int i;
+    if (ev->data.fd == input_wake_fd) {
+        uint64_t count;
+        // only clears the wakeup, the commands are picked up by the caller
+        if (read(input_wake_fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+            mp_msg(MSGT_INPUT, MSGL_V, "Input wakeup read failed: %s\n",
+                   strerror(errno));
+        return;
+    }
+    for (i = 0; i < num_key_fd; i++)
+        if (key_fds[i].fd == ev->data.fd) {
+            // getch2 can't report EOF, stop watching a hung up stdin
+            // instead of getting woken up for it over and over
+            if (key_fds[i].no_readfunc_retval && !(ev->events & EPOLLIN))
+                key_fds[i].dead = 1;
+            else
+                key_fds[i].ready = 1;
+        }
+    for (i = 0; i < num_cmd_fd; i++)
+        if (cmd_fds[i].fd == ev->data.fd)
+            cmd_fds[i].ready = 1;
+}
+
 /**
  * \param time time to wait at most for an event in milliseconds
  */
@@ -1023,66 +1229,45 @@ static mp_cmd_t *read_events(int time, int paused)
     int i;
     int got_cmd = 0;
     mp_cmd_t *autorepeat_cmd;
-    fd_set fds;
     for (i = 0; i < num_key_fd; i++)
 	if (key_fds[i].dead) {
 	    mp_input_rm_key_fd(key_fds[i].fd);
 	    i--;
-	}
+	} else
+	    key_fds[i].ready = 0;
     for (i = 0; i < num_cmd_fd; i++)
 	if (cmd_fds[i].dead || cmd_fds[i].eof) {
 	    mp_input_rm_cmd_fd(cmd_fds[i].fd);
 	    i--;
 	}
-	else if (cmd_fds[i].got_cmd)
-	    got_cmd = 1;
-    FD_ZERO(&fds);
-    if (!got_cmd) {
-	int max_fd = 0, num_fd = 0;
-	for (i = 0; i < num_key_fd; i++) {
-	    if (key_fds[i].no_select)
-		continue;
-	    if (key_fds[i].fd > max_fd)
-		max_fd = key_fds[i].fd;
-	    FD_SET(key_fds[i].fd, &fds);
-	    num_fd++;
-	}
-	for (i = 0; i < num_cmd_fd; i++) {
-	    if (cmd_fds[i].no_select)
-		continue;
-	    if (cmd_fds[i].fd > max_fd)
-		max_fd = cmd_fds[i].fd;
-	    FD_SET(cmd_fds[i].fd, &fds);
-	    num_fd++;
+	else {
+	    cmd_fds[i].ready = 0;
+	    if (cmd_fds[i].got_cmd)
+		got_cmd = 1;
 	}
-	if (num_fd > 0) {
-	    struct timeval tv, *time_val;
-	    if (time >= 0) {
-		tv.tv_sec = time / 1000;
-		tv.tv_usec = (time % 1000) * 1000;
-		time_val = &tv;
-	    }
-	    else
-		time_val = NULL;
-	    if (select(max_fd + 1, &fds, NULL, NULL, time_val) < 0) {
+    if (!got_cmd) {
+	if (input_epoll_fd >= 0) {
+	    struct epoll_event events[MP_MAX_KEY_FD + MP_MAX_CMD_FD + 1];
+	    int n = epoll_wait(input_epoll_fd, events, FF_ARRAY_ELEMS(events), time);
+	    if (n < 0) {
 		if (errno != EINTR)
 		    mp_msg(MSGT_INPUT, MSGL_ERR, MSGTR_INPUT_INPUT_ErrSelect,
 			    strerror(errno));
-		FD_ZERO(&fds);
+		n = 0;
 	    }
-	} else if (time)
+	    for (i = 0; i < n; i++)
+		mark_ready(&events[i]);
+	} else if (time > 0)
 	    usec_sleep(time * 1000);
     }
 
 
     for (i = 0; i < num_key_fd; i++) {
 	int code;
-	if (!key_fds[i].no_select && !FD_ISSET(key_fds[i].fd, &fds))
+	if (!key_fds[i].no_select && !key_fds[i].ready)
 	    continue;
 
 	if (key_fds[i].no_readfunc_retval) {   // getch2 handler special-cased for now
-	    // TODO: this is quite broken, using e.g. -cache -dumpaudio
-	    // with < /dev/null results in 100% CPU usage.
 	    ((void (*)(void))key_fds[i].read_func)();
 	    if (cmd_queue_length)
 		return NULL;
@@ -1113,7 +1298,7 @@ static mp_cmd_t *read_events(int time, int paused)
     for (i = 0; i < num_cmd_fd; i++) {
 	char *cmd;
 	int r;
-	if (!cmd_fds[i].no_select && !FD_ISSET(cmd_fds[i].fd, &fds) &&
+	if (!cmd_fds[i].no_select && !cmd_fds[i].ready &&
 	    !cmd_fds[i].got_cmd)
 	    continue;
 	r = mp_input_read_cmd(&cmd_fds[i], &cmd);
@@ -1136,26 +1321,77 @@ static mp_cmd_t *read_events(int time, int paused)
 
 int
 mp_input_queue_cmd(mp_cmd_t* cmd) {
-  if(!cmd || cmd_queue_length  >= CMD_QUEUE_SIZE)
+  mp_cmd_t* head;
+
+  if(!cmd)
+    return 0;
+  if(__sync_add_and_fetch(&cmd_queue_length, 1) > CMD_QUEUE_SIZE) {
+    __sync_sub_and_fetch(&cmd_queue_length, 1);
     return 0;
-  cmd_queue[cmd_queue_end] = cmd;
-  cmd_queue_end = (cmd_queue_end + 1) % CMD_QUEUE_SIZE;
-  cmd_queue_length++;
+  }
+  do {
+    head = cmd_queue_in;
+    cmd->queue_next = head;
+  } while(!__sync_bool_compare_and_swap(&cmd_queue_in, head, cmd));
+  // Later commands are picked up together with the first one, so only
+  // that one needs to wake the main loop. It reads the eventfd before
+  // taking the list, so no wakeup can get lost in between.
+  if(!head && input_wake_fd >= 0) {
+    uint64_t one = 1;
+    if(write(input_wake_fd, &one, sizeof(one)) < 0)
+      mp_msg(MSGT_INPUT,MSGL_V,"Input wakeup failed: %s\n",strerror(errno));
+  }
   return 1;
 }
 
+/// Move everything pushed by mp_input_queue_cmd to the main thread FIFO.
+static void
+cmd_queue_collect(void) {
+  mp_cmd_t* in = __sync_lock_test_and_set(&cmd_queue_in, NULL);
+  mp_cmd_t* last = in, *first = NULL;
+
+  // the shared list is newest first
+  while(in) {
+    mp_cmd_t* next = in->queue_next;
+    in->queue_next = first;
+    first = in;
+    in = next;
+  }
+  if(!first)
+    return;
+  if(cmd_queue_tail)
+    cmd_queue_tail->queue_next = first;
+  else
+    cmd_queue_head = first;
+  cmd_queue_tail = last;
+}
+
+/// Put a peeked command back at the front so it is returned next.
+static void
+cmd_queue_unget(mp_cmd_t* cmd) {
+  __sync_add_and_fetch(&cmd_queue_length, 1);
+  cmd->queue_next = cmd_queue_head;
+  cmd_queue_head = cmd;
+  if(!cmd_queue_tail)
+    cmd_queue_tail = cmd;
+}
+
 static mp_cmd_t*
 mp_input_get_queued_cmd(int peek_only) {
   mp_cmd_t* ret;
 
-  if(cmd_queue_length == 0)
+  if(!cmd_queue_head)
+    cmd_queue_collect();
+  ret = cmd_queue_head;
+  if(!ret)
     return NULL;
 
-  ret = cmd_queue[cmd_queue_start];
-
   if (!peek_only) {
-  cmd_queue_length--;
-  cmd_queue_start = (cmd_queue_start + 1) % CMD_QUEUE_SIZE;
+  cmd_queue_head = ret->queue_next;
+  if(!cmd_queue_head)
+    cmd_queue_tail = NULL;
+  ret->queue_next = NULL;
+  __sync_sub_and_fetch(&cmd_queue_length, 1);
   }
 
   return ret;
@@ -1200,12 +1436,9 @@ mp_input_get_cmd(int time, int paused, int peek_only) {
   }
 
 end:
-  // enqueue if necessary, if not possible rather drop
-  // command than leak memory
-  if (!from_queue && peek_only && !mp_input_queue_cmd(ret)) {
-    mp_cmd_free(ret);
-    return NULL;
-  }
+  // enqueue if necessary so the next call returns the same command
+  if (!from_queue && peek_only)
+    cmd_queue_unget(ret);
 
   return ret;
 }
@@ -1235,6 +1468,7 @@ mp_cmd_clone(mp_cmd_t* cmd) {
 
   ret = malloc(sizeof(mp_cmd_t));
   memcpy(ret,cmd,sizeof(mp_cmd_t));
+  ret->queue_next = NULL;
   for(i = 0;  i < MP_CMD_MAX_ARGS && cmd->args[i].type != -1; i++) {
     if(cmd->args[i].type == MP_CMD_ARG_STRING && cmd->args[i].v.s != NULL)
       ret->args[i].v.s = strdup(cmd->args[i].v.s);
@@ -1315,8 +1549,6 @@ mp_input_get_input_from_name(char* name,int* keys) {
 
 static void
 mp_input_bind_keys(const int keys[MP_MAX_KEY_DOWN+1], char* cmd) {
-  int i = 0,j;
-  mp_cmd_bind_t* bind = NULL;
   mp_cmd_bind_section_t* bind_section = NULL;
   char *section=NULL, *p;
 
@@ -1334,40 +1566,7 @@ mp_input_bind_keys(const int keys[MP_MAX_KEY_DOWN+1], char* cmd) {
       /* NOTHING */;
   }
   bind_section=mp_input_get_bind_section(section);
-
-  if(bind_section->cmd_binds) {
-    for(i = 0; bind_section->cmd_binds[i].cmd != NULL ; i++) {
-      for(j = 0 ; bind_section->cmd_binds[i].input[j] == keys[j]  && keys[j] != 0 ; j++)
-	/* NOTHING */;
-      if(keys[j] == 0 && bind_section->cmd_binds[i].input[j] == 0 ) {
-	bind = &bind_section->cmd_binds[i];
-	break;
-      }
-    }
-  }
-
-  if(!bind) {
-    bind_section->cmd_binds = realloc(bind_section->cmd_binds,(i+2)*sizeof(mp_cmd_bind_t));
-    memset(&bind_section->cmd_binds[i],0,2*sizeof(mp_cmd_bind_t));
-    bind = &bind_section->cmd_binds[i];
-  }
-  free(bind->cmd);
-  bind->cmd = strdup(cmd);
-  memcpy(bind->input,keys,(MP_MAX_KEY_DOWN+1)*sizeof(int));
-}
-
-static void
-mp_input_free_binds(mp_cmd_bind_t* binds) {
-  int i;
-
-  if(!binds)
-    return;
-
-  for(i = 0; binds[i].cmd != NULL; i++)
-    free(binds[i].cmd);
-
-  free(binds);
-
+  bind_trie_add(&bind_section->cmd_binds, keys, cmd);
 }
 
 static void strmove(char *dst, const char *src) {
@@ -1584,17 +1783,20 @@ mp_input_uninit(void) {
       cmd_fds[i].close_func(cmd_fds[i].fd);
   }
   while (cmd_binds_section) {
-    mp_input_free_binds(cmd_binds_section->cmd_binds);
+    bind_trie_free(cmd_binds_section->cmd_binds);
     free(cmd_binds_section->section);
     bind_section=cmd_binds_section->next;
     free(cmd_binds_section);
     cmd_binds_section=bind_section;
   }
   cmd_binds_section=NULL;
+  bind_trie_free(def_cmd_binds_trie);
+  def_cmd_binds_trie=NULL;
   // Drop command queue contents to avoid valgrind
   // warnings
   while ((cmd = mp_input_get_queued_cmd(0)))
     mp_cmd_free(cmd);
+  input_poll_uninit();
   mplayer_key_fifo_uninit();
 }
 
@@ -233,6 +233,7 @@ typedef struct mp_cmd {
   int nargs;
   mp_cmd_arg_t args[MP_CMD_MAX_ARGS];
   int pausing;
+  struct mp_cmd *queue_next; ///< link in the command queue, owned by input.c
 } mp_cmd_t;
 
 
@@ -294,6 +295,8 @@ int mp_input_get_key_from_name(const char *name);
 // This function can be used to put a command in the system again. It's used by libmpdemux
 // when it performs a blocking operation to resend the command it received to the main
 // loop.
+// It is safe to call from any thread, the main loop is woken up if it is waiting
+// in mp_input_get_cmd. Returns 0 if the queue is full.
 int
 mp_input_queue_cmd(mp_cmd_t* cmd);
 
@@ -0,0 +1,721 @@
+/*
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "config.h"
+#include "command.h"
+#include "input/input.h"
+#include "ipc.h"
+#include "libavutil/common.h"
+#include "m_option.h"
+#include "m_property.h"
+#include "mp_msg.h"
+#include "mplayer.h"
+#include "osdep/timer.h"
+
+#define MAX_CLIENTS     4
+#define MAX_LINE        (64 * 1024)
+#define MAX_OUTPUT      (1024 * 1024)
+#define JSON_MAX_DEPTH  8
+
+char *ipc_socket_path;
+
+typedef struct {
+    char *data;
+    int len, size;
+} ipc_buf_t;
+
+typedef struct ipc_observed {
+    char *name;
+    char *last;                 ///< JSON of the last value sent
+    struct ipc_observed *next;
+} ipc_observed_t;
+
+typedef struct {
+    int fd;                     ///< -1 for a free slot
+    int dead;
+    ipc_buf_t in, out;
+    ipc_observed_t *observed;
+} ipc_client_t;
+
+static int listen_fd = -1;
+static char *listen_path;
+static ipc_client_t clients[MAX_CLIENTS];
+
+/* output buffers */
+
+static void buf_append(ipc_buf_t *b, const char *data, int len)
+{
+    if (b->len + len + 1 > b->size) {
+        int size = FFMAX(2 * b->size, b->len + len + 1);
+        char *data_new = realloc(b->data, FFMAX(size, 256));
+        if (!data_new)
+            return;
+        b->data = data_new;
+        b->size = FFMAX(size, 256);
+    }
+    memcpy(b->data + b->len, data, len);
+    b->len += len;
+    b->data[b->len] = 0;
+}
+
+static void buf_puts(ipc_buf_t *b, const char *str)
+{
+    buf_append(b, str, strlen(str));
+}
+
+static void buf_printf(ipc_buf_t *b, const char *fmt, ...)
+{
+    char tmp[128];
+    va_list va;
+    int len;
+
+    va_start(va, fmt);
+    len = vsnprintf(tmp, sizeof(tmp), fmt, va);
+    va_end(va);
+    buf_append(b, tmp, FFMIN(len, (int)sizeof(tmp) - 1));
+}
+
+static void buf_json_string(ipc_buf_t *b, const char *str)
+{
+    buf_append(b, "\"", 1);
+    for (; *str; str++) {
+        unsigned char c = *str;
+        if (c == '"' || c == '\\')
+            buf_printf(b, "\\%c", c);
+        else if (c == '\n')
+            buf_puts(b, "\\n");
+        else if (c < 0x20)
+            buf_printf(b, "\\u%04x", c);
+        else
+            buf_append(b, str, 1);
+    }
+    buf_append(b, "\"", 1);
+}
+
+/* a small in-place JSON parser, requests are tiny and short lived */
+
+enum json_type {
+    JSON_NULL, JSON_FALSE, JSON_TRUE, JSON_NUMBER, JSON_STRING,
+    JSON_ARRAY, JSON_OBJECT,
+};
+
+typedef struct json_node {
+    enum json_type type;
+    char *key;                  ///< member name inside objects
+    char *str;                  ///< string contents or number text
+    char num[32];
+    struct json_node *child;
+    struct json_node *next;
+} json_node_t;
+
+static void json_free(json_node_t *n)
+{
+    while (n) {
+        json_node_t *next = n->next;
+        json_free(n->child);
+        free(n);
+        n = next;
+    }
+}
+
+static void skip_ws(char **p)
+{
+    while (**p == ' ' || **p == '\t' || **p == '\r' || **p == '\n')
+        (*p)++;
+}
+
+static int parse_hex4(const char *s, unsigned *val)
+{
+    int i;
+    *val = 0;
+    for (i = 0; i < 4; i++) {
+        int c = s[i];
+        *val <<= 4;
+        if (c >= '0' && c <= '9')
+            *val |= c - '0';
+        else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f')
+            *val |= (c | 0x20) - 'a' + 10;
+        else
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ * \brief Unescape the string starting at the quote at *p in place.
+ * Escapes never expand, so the result always fits.
+ */
+static char *json_parse_string(char **p)
+{
+    char *in = *p + 1, *out = in, *start = in;
+
+    while (*in != '"') {
+        unsigned cp, lo;
+        uint8_t tmp;
+        if ((unsigned char)*in < 0x20)
+            return NULL;
+        if (*in != '\\') {
+            *out++ = *in++;
+            continue;
+        }
+        in++;
+        switch (*in++) {
+        case '"':  *out++ = '"';  break;
+        case '\\': *out++ = '\\'; break;
+        case '/':  *out++ = '/';  break;
+        case 'b':  *out++ = '\b'; break;
+        case 'f':  *out++ = '\f'; break;
+        case 'n':  *out++ = '\n'; break;
+        case 'r':  *out++ = '\r'; break;
+        case 't':  *out++ = '\t'; break;
+        case 'u':
+            if (!parse_hex4(in, &cp))
+                return NULL;
+            in += 4;
+            if (cp >= 0xD800 && cp < 0xDC00 && in[0] == '\\' && in[1] == 'u' &&
+                parse_hex4(in + 2, &lo) && lo >= 0xDC00 && lo < 0xE000) {
+                cp  = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                in += 6;
+            }
+            PUT_UTF8(cp, tmp, *out++ = tmp;)
+            break;
+        default:
+            return NULL;
+        }
+    }
+    *p   = in + 1;
+    *out = 0;
+    return start;
+}
+
+static json_node_t *json_parse_value(char **p, int depth)
+{
+    json_node_t *n, **tail;
+    char close, *end;
+
+    skip_ws(p);
+    if (depth > JSON_MAX_DEPTH)
+        return NULL;
+    n = calloc(1, sizeof(*n));
+    if (!n)
+        return NULL;
+
+    switch (**p) {
+    case '"':
+        n->type = JSON_STRING;
+        if (!(n->str = json_parse_string(p)))
+            goto fail;
+        return n;
+    case 't':
+        n->type = JSON_TRUE;
+        if (strncmp(*p, "true", 4))
+            goto fail;
+        *p += 4;
+        return n;
+    case 'f':
+        n->type = JSON_FALSE;
+        if (strncmp(*p, "false", 5))
+            goto fail;
+        *p += 5;
+        return n;
+    case 'n':
+        n->type = JSON_NULL;
+        if (strncmp(*p, "null", 4))
+            goto fail;
+        *p += 4;
+        return n;
+    case '{':
+    case '[':
+        break;
+    default:
+        n->type = JSON_NUMBER;
+        strtod(*p, &end);
+        if (end == *p || end - *p >= sizeof(n->num))
+            goto fail;
+        memcpy(n->num, *p, end - *p);
+        n->str = n->num;
+        *p     = end;
+        return n;
+    }
+
+    n->type = **p == '{' ? JSON_OBJECT : JSON_ARRAY;
+    close   = **p == '{' ? '}' : ']';
+    tail    = &n->child;
+    (*p)++;
+    skip_ws(p);
+    if (**p == close) {
+        (*p)++;
+        return n;
+    }
+    for (;;) {
+        json_node_t *c;
+        char *key = NULL;
+        if (n->type == JSON_OBJECT) {
+            skip_ws(p);
+            if (**p != '"' || !(key = json_parse_string(p)))
+                goto fail;
+            skip_ws(p);
+            if (*(*p)++ != ':')
+                goto fail;
+        }
+        if (!(c = json_parse_value(p, depth + 1)))
+            goto fail;
+        c->key = key;
+        *tail  = c;
+        tail   = &c->next;
+        skip_ws(p);
+        if (**p == ',') {
+            (*p)++;
+            continue;
+        }
+        if (*(*p)++ == close)
+            return n;
+        goto fail;
+    }
+
+fail:
+    json_free(n);
+    return NULL;
+}
+
+static json_node_t *json_parse(char *str)
+{
+    json_node_t *n = json_parse_value(&str, 0);
+    skip_ws(&str);
+    if (n && *str) {
+        json_free(n);
+        return NULL;
+    }
+    return n;
+}
+
+static json_node_t *json_member(json_node_t *obj, const char *key)
+{
+    json_node_t *c;
+    for (c = obj->child; c; c = c->next)
+        if (!strcmp(c->key, key))
+            return c;
+    return NULL;
+}
+
+/* properties */
+
+/**
+ * \brief Append the value of a property as JSON, null if it can't be read.
+ * Numeric types are sent as numbers, everything else as its string form.
+ */
+static int append_property(ipc_buf_t *b, struct MPContext *mpctx, const char *name)
+{
+    m_option_t *opt = NULL;
+    union {
+        int i;
+        int64_t i64;
+        float f;
+        double d;
+    } v;
+    char *str;
+    int r = mp_property_do(name, M_PROPERTY_GET_TYPE, &opt, mpctx);
+
+    if (r > 0 && opt && (opt->type == CONF_TYPE_FLAG  || opt->type == CONF_TYPE_INT   ||
+                         opt->type == CONF_TYPE_INT64 || opt->type == CONF_TYPE_FLOAT ||
+                         opt->type == CONF_TYPE_DOUBLE || opt->type == CONF_TYPE_TIME)) {
+        memset(&v, 0, sizeof(v));
+        r = mp_property_do(name, M_PROPERTY_GET, &v, mpctx);
+        if (r > 0) {
+            if (opt->type == CONF_TYPE_FLAG)
+                buf_puts(b, v.i ? "true" : "false");
+            else if (opt->type == CONF_TYPE_INT)
+                buf_printf(b, "%d", v.i);
+            else if (opt->type == CONF_TYPE_INT64)
+                buf_printf(b, "%"PRId64, v.i64);
+            else if (opt->type == CONF_TYPE_FLOAT)
+                buf_printf(b, isfinite(v.f) ? "%.7g" : "null", v.f);
+            else
+                buf_printf(b, isfinite(v.d) ? "%.15g" : "null", v.d);
+            return r;
+        }
+    }
+    r = mp_property_do(name, M_PROPERTY_TO_STRING, &str, mpctx);
+    if (r <= 0) {
+        buf_puts(b, "null");
+        return r;
+    }
+    buf_json_string(b, str);
+    free(str);
+    return r;
+}
+
+static int set_property(struct MPContext *mpctx, json_node_t *val)
+{
+    char *str;
+
+    switch (val->type) {
+    case JSON_STRING:
+    case JSON_NUMBER:
+        str = val->str;
+        break;
+    case JSON_TRUE:
+        str = "1";
+        break;
+    case JSON_FALSE:
+        str = "0";
+        break;
+    default:
+        return M_PROPERTY_ERROR;
+    }
+    return mp_property_do(val->key, M_PROPERTY_PARSE, str, mpctx);
+}
+
+/* clients */
+
+static ipc_client_t *find_client(int fd)
+{
+    int i;
+    for (i = 0; i < MAX_CLIENTS; i++)
+        if (clients[i].fd == fd && fd >= 0)
+            return &clients[i];
+    return NULL;
+}
+
+static void observe(ipc_client_t *c, const char *name)
+{
+    ipc_observed_t *o;
+    for (o = c->observed; o; o = o->next)
+        if (!strcmp(o->name, name))
+            return;
+    o = calloc(1, sizeof(*o));
+    if (!o)
+        return;
+    o->name     = strdup(name);
+    o->next     = c->observed;
+    c->observed = o;
+}
+
+static void unobserve(ipc_client_t *c, const char *name)
+{
+    ipc_observed_t **o;
+    for (o = &c->observed; *o; o = &(*o)->next)
+        if (!strcmp((*o)->name, name)) {
+            ipc_observed_t *next = (*o)->next;
+            free((*o)->name);
+            free((*o)->last);
+            free(*o);
+            *o = next;
+            return;
+        }
+}
+
+static void append_errors(ipc_buf_t *b, ipc_buf_t *errors)
+{
+    if (!errors->len)
+        return;
+    buf_puts(b, ",\"errors\":{");
+    buf_append(b, errors->data, errors->len);
+    buf_puts(b, "}");
+}
+
+static void add_error(ipc_buf_t *errors, const char *name, int r)
+{
+    if (errors->len)
+        buf_puts(errors, ",");
+    buf_json_string(errors, name);
+    buf_puts(errors, ":");
+    buf_json_string(errors, property_error_string(r));
+}
+
+static void handle_request(struct MPContext *mpctx, ipc_client_t *c, char *line)
+{
+    json_node_t *req = json_parse(line), *id, *n, *v;
+    ipc_buf_t *b = &c->out;
+    ipc_buf_t errors = { 0 };
+    const char *error = "success";
+
+    buf_puts(b, "{\"id\":");
+    id = req && req->type == JSON_OBJECT ? json_member(req, "id") : NULL;
+    if (id && id->type == JSON_NUMBER)
+        buf_puts(b, id->str);
+    else if (id && id->type == JSON_STRING)
+        buf_json_string(b, id->str);
+    else
+        buf_puts(b, "null");
+
+    if (!req || req->type != JSON_OBJECT) {
+        buf_puts(b, ",\"error\":\"invalid request\"}\n");
+        json_free(req);
+        return;
+    }
+
+    if ((n = json_member(req, "command"))) {
+        mp_cmd_t *cmd = n->type == JSON_STRING ? mp_input_parse_cmd(n->str) : NULL;
+        if (!cmd)
+            error = "invalid command";
+        else if (!mp_input_queue_cmd(cmd)) {
+            mp_cmd_free(cmd);
+            error = "command queue full";
+        }
+    }
+    if ((n = json_member(req, "set")) && n->type == JSON_OBJECT)
+        for (v = n->child; v; v = v->next) {
+            int r = set_property(mpctx, v);
+            if (r <= 0)
+                add_error(&errors, v->key, r);
+        }
+    if ((n = json_member(req, "observe")) && n->type == JSON_ARRAY)
+        for (v = n->child; v; v = v->next)
+            if (v->type == JSON_STRING)
+                observe(c, v->str);
+    if ((n = json_member(req, "unobserve")) && n->type == JSON_ARRAY)
+        for (v = n->child; v; v = v->next)
+            if (v->type == JSON_STRING)
+                unobserve(c, v->str);
+
+    buf_puts(b, ",\"error\":");
+    buf_json_string(b, error);
+    if ((n = json_member(req, "get")) && n->type == JSON_ARRAY) {
+        buf_puts(b, ",\"data\":{");
+        for (v = n->child; v; v = v->next) {
+            int r;
+            if (v->type != JSON_STRING)
+                continue;
+            if (v != n->child)
+                buf_puts(b, ",");
+            buf_json_string(b, v->str);
+            buf_puts(b, ":");
+            r = append_property(b, mpctx, v->str);
+            if (r <= 0)
+                add_error(&errors, v->str, r);
+        }
+        buf_puts(b, "}");
+    }
+    append_errors(b, &errors);
+    buf_puts(b, "}\n");
+    free(errors.data);
+    json_free(req);
+}
+
+static void push_changes(struct MPContext *mpctx, ipc_client_t *c)
+{
+    ipc_buf_t val = { 0 };
+    ipc_observed_t *o;
+
+    for (o = c->observed; o; o = o->next) {
+        val.len = 0;
+        append_property(&val, mpctx, o->name);
+        if (!val.data || (o->last && !strcmp(o->last, val.data)))
+            continue;
+        free(o->last);
+        o->last = strdup(val.data);
+        buf_puts(&c->out, "{\"event\":\"property-change\",\"name\":");
+        buf_json_string(&c->out, o->name);
+        buf_puts(&c->out, ",\"data\":");
+        buf_append(&c->out, val.data, val.len);
+        buf_puts(&c->out, "}\n");
+    }
+    free(val.data);
+}
+
+static void flush_output(ipc_client_t *c)
+{
+    while (c->out.len) {
+        int w = write(c->fd, c->out.data, c->out.len);
+        if (w < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                c->dead = 1;
+            break;
+        }
+        memmove(c->out.data, c->out.data + w, c->out.len - w);
+        c->out.len -= w;
+    }
+    if (c->out.len > MAX_OUTPUT) {
+        mp_msg(MSGT_INPUT, MSGL_WARN, "[ipc] Client is not reading, dropping it.\n");
+        c->dead = 1;
+    }
+}
+
+static void client_close(int fd)
+{
+    ipc_client_t *c = find_client(fd);
+
+    close(fd);
+    if (!c)
+        return;
+    while (c->observed)
+        unobserve(c, c->observed->name);
+    free(c->in.data);
+    free(c->out.data);
+    memset(c, 0, sizeof(*c));
+    c->fd = -1;
+}
+
+static int client_read(int fd)
+{
+    ipc_client_t *c = find_client(fd);
+    char tmp[4096];
+    int r;
+
+    if (!c || c->dead)
+        return MP_INPUT_NOTHING;
+    r = read(fd, tmp, sizeof(tmp));
+    if (r < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK))
+        return MP_INPUT_NOTHING;
+    if (r <= 0) {
+        // removed from mp_ipc_update(), not from inside the input loop
+        c->dead = 1;
+        return MP_INPUT_NOTHING;
+    }
+    buf_append(&c->in, tmp, r);
+    if (c->in.len > MAX_LINE && !memchr(c->in.data, '\n', c->in.len)) {
+        mp_msg(MSGT_INPUT, MSGL_WARN, "[ipc] Request too long, dropping client.\n");
+        c->dead = 1;
+    }
+    return MP_INPUT_NOTHING;
+}
+
+static int listen_accept(int fd)
+{
+    int i, cfd = accept(fd, NULL, NULL);
+
+    if (cfd < 0)
+        return MP_INPUT_NOTHING;
+    fcntl(cfd, F_SETFL, fcntl(cfd, F_GETFL) | O_NONBLOCK);
+    fcntl(cfd, F_SETFD, FD_CLOEXEC);
+    for (i = 0; i < MAX_CLIENTS; i++)
+        if (clients[i].fd < 0)
+            break;
+    if (i == MAX_CLIENTS || !mp_input_add_key_fd(cfd, 1, client_read, client_close)) {
+        mp_msg(MSGT_INPUT, MSGL_WARN, "[ipc] Too many clients.\n");
+        close(cfd);
+        return MP_INPUT_NOTHING;
+    }
+    clients[i].fd = cfd;
+    mp_msg(MSGT_INPUT, MSGL_V, "[ipc] Client connected.\n");
+    return MP_INPUT_NOTHING;
+}
+
+int mp_ipc_init(const char *path)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    mode_t old_mask;
+    int i, res;
+
+    for (i = 0; i < MAX_CLIENTS; i++)
+        clients[i].fd = -1;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        mp_msg(MSGT_INPUT, MSGL_ERR, "[ipc] Socket path too long: %s\n", path);
+        return 0;
+    }
+    strcpy(addr.sun_path, path);
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0)
+        goto err;
+    // a stale socket from a previous run would make bind() fail
+    unlink(path);
+    // the socket gives full control over the player, other users must
+    // not be able to connect to it
+    old_mask = umask(0077);
+    res = bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr));
+    umask(old_mask);
+    if (res < 0 || listen(listen_fd, MAX_CLIENTS) < 0)
+        goto err;
+    if (!mp_input_add_key_fd(listen_fd, 1, listen_accept, NULL)) {
+        errno = EMFILE;
+        goto err;
+    }
+    listen_path = strdup(path);
+    mp_msg(MSGT_INPUT, MSGL_V, "[ipc] Listening on %s\n", path);
+    return 1;
+
+err:
+    mp_msg(MSGT_INPUT, MSGL_ERR, "[ipc] Can't listen on %s: %s\n", path, strerror(errno));
+    if (listen_fd >= 0)
+        close(listen_fd);
+    listen_fd = -1;
+    return 0;
+}
+
+void mp_ipc_uninit(void)
+{
+    int i;
+
+    if (listen_fd < 0)
+        return;
+    for (i = 0; i < MAX_CLIENTS; i++)
+        if (clients[i].fd >= 0)
+            mp_input_rm_key_fd(clients[i].fd);
+    mp_input_rm_key_fd(listen_fd);
+    close(listen_fd);
+    listen_fd = -1;
+    unlink(listen_path);
+    free(listen_path);
+    listen_path = NULL;
+}
+
+void mp_ipc_update(struct MPContext *mpctx)
+{
+    static unsigned int last_push;
+    unsigned int now = GetTimerMS();
+    int push;
+    int i;
+
+    if (listen_fd < 0)
+        return;
+    push = !status_interval || now - last_push >= status_interval;
+    if (push)
+        last_push = now;
+    for (i = 0; i < MAX_CLIENTS; i++) {
+        ipc_client_t *c = &clients[i];
+        char *line, *nl;
+        if (c->fd < 0)
+            continue;
+        line = c->in.data;
+        while (!c->dead && line && (nl = memchr(line, '\n', c->in.data + c->in.len - line))) {
+            *nl = 0;
+            handle_request(mpctx, c, line);
+            line = nl + 1;
+        }
+        if (line && line != c->in.data) {
+            c->in.len -= line - c->in.data;
+            memmove(c->in.data, line, c->in.len + 1);
+        }
+        if (!c->dead && push)
+            push_changes(mpctx, c);
+        if (!c->dead)
+            flush_output(c);
+        if (c->dead) {
+            mp_msg(MSGT_INPUT, MSGL_V, "[ipc] Client disconnected.\n");
+            mp_input_rm_key_fd(c->fd);
+        }
+    }
+}
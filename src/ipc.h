@@ -0,0 +1,53 @@
+/*
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPLAYER_IPC_H
+#define MPLAYER_IPC_H
+
+/* JSON control socket.
+ *
+ * Clients connect to a Unix socket and send one JSON object per line:
+ *
+ *   {"id": 1, "get": ["time_pos", "volume"]}
+ *   {"id": 2, "set": {"volume": 80, "speed": 1.5}}
+ *   {"id": 3, "command": "seek 10 0"}
+ *   {"id": 4, "observe": ["time_pos", "pause"]}
+ *   {"id": 5, "unobserve": ["time_pos"]}
+ *
+ * and get one reply line per request, echoing "id":
+ *
+ *   {"id":1,"error":"success","data":{"time_pos":12.5,"volume":80.0}}
+ *
+ * Observed properties are checked every -status-interval ms and pushed
+ * whenever their value changed:
+ *
+ *   {"event":"property-change","name":"time_pos","data":12.54}
+ *
+ * Requests are parsed when the socket becomes readable, but only run from
+ * mp_ipc_update() so properties are always accessed from the main loop. */
+
+struct MPContext;
+
+extern char *ipc_socket_path;
+
+int  mp_ipc_init(const char *path);
+void mp_ipc_uninit(void);
+/** \brief Answer pending requests and push observed property changes. */
+void mp_ipc_update(struct MPContext *mpctx);
+
+#endif /* MPLAYER_IPC_H */
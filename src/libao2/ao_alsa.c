@@ -838,18 +838,21 @@ static int play(void* data, int len, int flags)
 /* how many byes are free in the buffer */
 static int get_space(void)
 {
-    snd_pcm_status_t *status;
+    snd_pcm_sframes_t avail;
     int ret;
 
-    snd_pcm_status_alloca(&status);
-
-    if ((ret = snd_pcm_status(alsa_handler, status)) < 0)
+    /* snd_pcm_avail() syncs the hw pointer like snd_pcm_status() does,
+     * without filling a whole status struct on every call */
+    if ((avail = snd_pcm_avail(alsa_handler)) < 0)
     {
-	mp_msg(MSGT_AO,MSGL_ERR,MSGTR_AO_ALSA_CannotGetPcmStatus, snd_strerror(ret));
+	/* xrun or suspend, let play() run its recovery */
+	if (avail == -EPIPE || avail == -ESTRPIPE)
+	    return ao_data.outburst;
+	mp_msg(MSGT_AO,MSGL_ERR,MSGTR_AO_ALSA_CannotGetPcmStatus, snd_strerror(avail));
 	return 0;
     }
 
-    ret = snd_pcm_status_get_avail(status) * bytes_per_sample;
+    ret = avail * bytes_per_sample;
     if (ret > ao_data.buffersize)  // Buffer underrun?
 	ret = ao_data.buffersize;
     return ret;
@@ -0,0 +1,191 @@
+/*
+ * benchmark audio output driver, runs on a virtual clock
+ *
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* Unlike ao_null this never looks at the wall clock: every sample handed
+ * to play() is consumed at once and advances the virtual clock, so the
+ * player never waits for the device and two runs over the same input see
+ * exactly the same sequence of calls. Useful with -benchmark to profile
+ * decoding and filtering without a sound card, and to regression test the
+ * audio chain by comparing the hash of the PCM it produced. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+#include "config.h"
+#include "mp_msg.h"
+#include "subopt-helper.h"
+#include "osdep/timer.h"
+#include "libaf/af_format.h"
+#include "audio_out.h"
+#include "audio_out_internal.h"
+
+static const ao_info_t info =
+{
+    "Benchmark audio output (virtual clock)",
+    "bench",
+    "",
+    ""
+};
+
+LIBAO_EXTERN(bench)
+
+#define FNV64_INIT  0xcbf29ce484222325ULL
+#define FNV64_PRIME 0x100000001b3ULL
+
+static int      hash;
+static char    *filename;
+static FILE    *fp;
+static uint64_t pcm_hash;
+static uint64_t frames;     ///< virtual clock, in sample frames
+static int64_t  start_time;
+
+static void print_help(void)
+{
+    mp_msg(MSGT_AO, MSGL_FATAL,
+           "\n-ao bench commandline help:\n"
+           "Example: mplayer -benchmark -ao bench:hash:file=out.raw\n"
+           "\nOptions:\n"
+           "  hash\n"
+           "    Print a 64-bit FNV-1a hash of the PCM data at exit.\n"
+           "  file=<filename>\n"
+           "    Also write the raw PCM data to <filename>.\n");
+}
+
+// to set/get/query special features/parameters
+static int control(int cmd, void *arg)
+{
+    return -1;
+}
+
+// open & setup audio device
+// return: 1=success 0=fail
+static int init(int rate, int channels, int format, int flags)
+{
+    int samplesize = af_fmt2bits(format) / 8;
+    const opt_t subopts[] = {
+        {"hash", OPT_ARG_BOOL,  &hash,     NULL},
+        {"file", OPT_ARG_MSTRZ, &filename, NULL},
+        {NULL}
+    };
+
+    hash = 0;
+    filename = NULL;
+    if (subopt_parse(ao_subdevice, subopts) != 0) {
+        print_help();
+        return 0;
+    }
+    if (filename) {
+        fp = fopen(filename, "wb");
+        if (!fp) {
+            mp_msg(MSGT_AO, MSGL_ERR, "[AO BENCH] Cannot open %s for writing.\n",
+                   filename);
+            free(filename);
+            filename = NULL;
+            return 0;
+        }
+    }
+
+    ao_data.channels   = channels;
+    ao_data.samplerate = rate;
+    ao_data.format     = format;
+    ao_data.bps        = channels * rate * samplesize;
+    ao_data.outburst   = 256 * channels * samplesize;
+    // one second per get_space() keeps the number of calls per run low
+    ao_data.buffersize = (rate / 256 + 1) * ao_data.outburst;
+
+    pcm_hash   = FNV64_INIT;
+    frames     = 0;
+    start_time = GetTimerNS();
+    return 1;
+}
+
+// close audio device
+static void uninit(int immed)
+{
+    double audio = ao_data.samplerate ? (double)frames / ao_data.samplerate : 0;
+    double wall  = (GetTimerNS() - start_time) * 1e-9;
+
+    mp_msg(MSGT_AO, MSGL_INFO,
+           "[AO BENCH] %"PRIu64" samples (%.3fs) in %.3fs: %.0f samples/s, %.2fx realtime\n",
+           frames, audio, wall, wall > 0 ? frames / wall : 0,
+           wall > 0 ? audio / wall : 0);
+    if (hash)
+        mp_msg(MSGT_AO, MSGL_INFO, "[AO BENCH] PCM hash: %016"PRIx64"\n", pcm_hash);
+
+    if (fp)
+        fclose(fp);
+    fp = NULL;
+    free(filename);
+    filename = NULL;
+}
+
+// stop playing and empty buffers (for seeking/pause)
+static void reset(void)
+{
+}
+
+// stop playing, keep buffers (for pause)
+static void audio_pause(void)
+{
+}
+
+// resume playing, after audio_pause()
+static void audio_resume(void)
+{
+}
+
+// return: how many bytes can be played without blocking
+static int get_space(void)
+{
+    // the virtual device drained everything the moment it was played
+    return ao_data.buffersize;
+}
+
+// plays 'len' bytes of 'data'
+// it should round it down to outburst*n
+// return: number of bytes played
+static int play(void *data, int len, int flags)
+{
+    const uint8_t *p = data;
+    int i;
+
+    if (!(flags & AOPLAY_FINAL_CHUNK))
+        len = len / ao_data.outburst * ao_data.outburst;
+
+    if (hash) {
+        uint64_t h = pcm_hash;
+        for (i = 0; i < len; i++)
+            h = (h ^ p[i]) * FNV64_PRIME;
+        pcm_hash = h;
+    }
+    if (fp)
+        fwrite(data, len, 1, fp);
+
+    frames += len / (ao_data.bps / ao_data.samplerate);
+    return len;
+}
+
+// return: delay in seconds between first and last sample in buffer
+static float get_delay(void)
+{
+    return 0;
+}
@@ -35,12 +35,14 @@ ao_data_t ao_data={0,0,0,0,OUTBURST,-1,0};
 char *ao_subdevice = NULL;
 
 extern const ao_functions_t audio_out_null;
+extern const ao_functions_t audio_out_bench;
 extern const ao_functions_t audio_out_alsa;
 
 const ao_functions_t* const audio_out_drivers[] =
 {
         &audio_out_alsa,
         &audio_out_null,
+        &audio_out_bench,
         NULL
 };
 
@@ -72,6 +72,10 @@ int get_current_video_decoder_lag(sh_video_t *sh_video)
 
 void uninit_video(sh_video_t *sh_video)
 {
+    if (sh_video->last_image) {
+        mp_image_release(sh_video->last_image);
+        sh_video->last_image = NULL;
+    }
     if (sh_video->initialized) {
     mp_msg(MSGT_DECVIDEO, MSGL_V, "Uninit video: %s\n", codec_idx2str(sh_video->codec->drv_idx));
     mpvdec->uninit(sh_video);
@@ -84,6 +88,7 @@ void uninit_video(sh_video_t *sh_video)
         vf_uninit_filter_chain(sh_video->vfilter);
         sh_video->vfilter = NULL;
     }
+    mp_image_pool_uninit();
 }
 
 void vfm_help(void)
@@ -244,12 +249,17 @@ void *decode_video(sh_video_t *sh_video, unsigned char *start, int in_size,
                    int drop_frame, double pts, double endpts, int *full_frame)
 {
     mp_image_t *mpi = NULL;
-    unsigned int t = GetTimer();
-    unsigned int t2;
-    double tt;
+    int64_t t = GetTimerNS();
     int delay;
     int got_picture = 1;
 
+    // the image returned last time may be reused by the decoder now,
+    // filters and vos that still need it have acquired it themselves
+    if (sh_video->last_image) {
+        mp_image_release(sh_video->last_image);
+        sh_video->last_image = NULL;
+    }
+
     mpi = mpvdec->decode(sh_video, start, in_size, drop_frame);
 
     //------------------------ frame decoded. --------------------
@@ -282,16 +292,18 @@ void *decode_video(sh_video_t *sh_video, unsigned char *start, int in_size,
             sh_video->num_buffered_pts++;
         }
     }
-    if (correct_pts && mpi && drop_frame && sh_video->num_buffered_pts > 0)
+    if (correct_pts && mpi && (drop_frame & VDFLAGS_DROPFRAME) &&
+        sh_video->num_buffered_pts > 0)
         sh_video->num_buffered_pts--;
 
-    t2 = GetTimer();
-    t = t2 - t;
-    tt = t * 0.000001f;
-    video_time_usage += tt;
+    video_time_usage += (GetTimerNS() - t) * 1e-9;
 
-    if (!mpi || drop_frame)
+    if (!mpi || (drop_frame & VDFLAGS_DROPFRAME)) {
+        if (mpi)
+            mp_image_release(mpi);
         return NULL;            // error / skipped frame
+    }
+    sh_video->last_image = mpi;
 
     if (field_dominance == 0)
         mpi->fields |= MP_IMGFIELD_TOP_FIRST;
@@ -332,7 +344,7 @@ void *decode_video(sh_video_t *sh_video, unsigned char *start, int in_size,
 int filter_video(sh_video_t *sh_video, void *frame, double pts, double endpts)
 {
     mp_image_t *mpi = frame;
-    unsigned int t2 = GetTimer();
+    int64_t t = GetTimerNS();
     vf_instance_t *vf = sh_video->vfilter;
     // apply video filters and call the leaf vo/ve
     int ret = vf->put_image(vf, mpi, pts, endpts);
@@ -340,8 +352,7 @@ int filter_video(sh_video_t *sh_video, void *frame, double pts, double endpts)
         vf->control(vf, VFCTRL_DRAW_OSD, NULL);
     }
 
-    t2 = GetTimer() - t2;
-    vout_time_usage += t2 * 0.000001;
+    vout_time_usage += (GetTimerNS() - t) * 1e-9;
 
     return ret;
 }
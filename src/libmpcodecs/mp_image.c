@@ -24,6 +24,7 @@
 #include <string.h>
 
 #include <malloc.h>
+#include <pthread.h>
 
 #include "libmpcodecs/img_format.h"
 #include "libmpcodecs/mp_image.h"
@@ -31,6 +32,92 @@
 #include "libavutil/mem.h"
 #include "mp_msg.h"
 
+/* Plane buffers are recycled through a global pool instead of going back
+ * to the allocator, so size or format changes and images kept in flight
+ * by several users do not cost a malloc/free per frame.
+ * Sizes are rounded up to classes 4 steps per power of two apart, which
+ * wastes at most 25% and lets e.g. 1080p and 1088p frames share buffers. */
+#define POOL_MIN_SIZE 4096
+#define POOL_CLASSES  64
+#define POOL_MAX_FREE 16   // cached buffers per class
+
+typedef struct pool_buf {
+    struct pool_buf *next;
+} pool_buf_t;
+
+static struct {
+    pool_buf_t *free;
+    int num_free;
+} pool[POOL_CLASSES];
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int pool_class(size_t size, size_t *class_size) {
+    size_t step = POOL_MIN_SIZE / 4;
+    size_t s = POOL_MIN_SIZE;
+    int cls = 0;
+    while (s < size) {
+        s += step;
+        if (s == 8 * step)
+            step *= 2;
+        cls++;
+    }
+    *class_size = s;
+    return cls < POOL_CLASSES ? cls : -1;
+}
+
+static void *pool_get(size_t size, unsigned int *alloc_size) {
+    size_t class_size;
+    int cls = pool_class(size, &class_size);
+    pool_buf_t *buf = NULL;
+    if (cls < 0) {
+        *alloc_size = size;
+        return av_malloc(size);
+    }
+    pthread_mutex_lock(&pool_lock);
+    if (pool[cls].free) {
+        buf = pool[cls].free;
+        pool[cls].free = buf->next;
+        pool[cls].num_free--;
+    }
+    pthread_mutex_unlock(&pool_lock);
+    *alloc_size = class_size;
+    return buf ? (void *)buf : av_malloc(class_size);
+}
+
+static void pool_put(void *ptr, size_t size) {
+    size_t class_size;
+    int cls = pool_class(size, &class_size);
+    pool_buf_t *buf = ptr;
+    if (cls >= 0 && class_size == size) {
+        pthread_mutex_lock(&pool_lock);
+        if (pool[cls].num_free < POOL_MAX_FREE) {
+            buf->next = pool[cls].free;
+            pool[cls].free = buf;
+            pool[cls].num_free++;
+            buf = NULL;
+        }
+        pthread_mutex_unlock(&pool_lock);
+    }
+    av_free(buf);
+}
+
+/**
+ * \brief Free all plane buffers cached for reuse.
+ */
+void mp_image_pool_uninit(void) {
+    int i;
+    pthread_mutex_lock(&pool_lock);
+    for (i = 0; i < POOL_CLASSES; i++) {
+        while (pool[i].free) {
+            pool_buf_t *buf = pool[i].free;
+            pool[i].free = buf->next;
+            av_free(buf);
+        }
+        pool[i].num_free = 0;
+    }
+    pthread_mutex_unlock(&pool_lock);
+}
+
 void mp_image_alloc_planes(mp_image_t *mpi) {
   /* This condition is stricter than needed, but I want to be sure that every
    * calculation step can fit in int32_t. This assumption is true over most of
@@ -48,14 +135,16 @@ void mp_image_alloc_planes(mp_image_t *mpi) {
         mp_msg(MSGT_DECVIDEO,MSGL_WARN,"mp_image: Unreasonable image parameters\n");
         return;
   }
-    mpi->planes[0]=av_malloc(mpi->bpp*mpi->width*(mpi->height+2)/8+
-                            mpi->chroma_width*mpi->chroma_height);
+    mpi->planes[0]=pool_get(mpi->bpp*mpi->width*(mpi->height+2)/8+
+                            mpi->chroma_width*mpi->chroma_height, &mpi->alloc_size);
   } else {
     // for odd width round up to be on the safe side,
     // required in particular for planar formats
     int alloc_w = mpi->width + (mpi->width & 1);
-    mpi->planes[0]=av_malloc(mpi->bpp*alloc_w*(mpi->height+2)/8);
+    mpi->planes[0]=pool_get(mpi->bpp*alloc_w*(mpi->height+2)/8, &mpi->alloc_size);
   }
+  if (!mpi->planes[0])
+    return;
   if (mpi->flags&MP_IMGFLAG_PLANAR) {
     int bpp = IMGFMT_IS_YUVP16(mpi->imgfmt)? 2 : 1;
     // YV12/I420/YVU9/IF09. feel free to add other planar formats here...
@@ -267,14 +356,58 @@ mp_image_t* new_mp_image(int w,int h){
     return mpi;
 }
 
+/**
+ * \brief Return the planes allocated by mp_image_alloc_planes() to the pool.
+ */
+void mp_image_free_planes(mp_image_t *mpi) {
+    if (!(mpi->flags & MP_IMGFLAG_ALLOCATED))
+        return;
+    /* because we allocate the whole image at once */
+    pool_put(mpi->planes[0], mpi->alloc_size);
+    if (mpi->flags & MP_IMGFLAG_RGB_PALETTE)
+        av_free(mpi->planes[1]);
+    memset(mpi->planes, 0, sizeof(mpi->planes));
+    mpi->alloc_size = 0;
+    mpi->flags &= ~MP_IMGFLAG_ALLOCATED;
+}
+
+static void call_release(mp_image_t *mpi) {
+    void (*release)(mp_image_t *mpi) = mpi->release;
+    if (!release)
+        return;
+    mpi->release = NULL;
+    release(mpi);
+    mpi->release_priv = NULL;
+}
+
+/**
+ * \brief Mark an image as in use, e.g. by a decoder reference or a
+ * frame queued in the vo. Images are not handed out again by
+ * vf_get_image() until every user has called mp_image_release().
+ */
+void mp_image_acquire(mp_image_t *mpi) {
+    __sync_add_and_fetch(&mpi->usage_count, 1);
+}
+
+/**
+ * \brief Drop a reference taken by mp_image_acquire() or vf_get_image().
+ * The last one runs the release callback, which frees the buffer the
+ * planes were borrowed from, and returns the image to the pool of the
+ * filter it came from.
+ */
+void mp_image_release(mp_image_t *mpi) {
+    int count = __sync_sub_and_fetch(&mpi->usage_count, 1);
+    if (count < 0) {
+        mp_msg(MSGT_DECVIDEO, MSGL_ERR, "Bad mp_image usage count, please report!\n");
+        mpi->usage_count = 0;
+    } else if (!count)
+        call_release(mpi);
+}
+
 void free_mp_image(mp_image_t* mpi){
     if(!mpi) return;
-    if(mpi->flags&MP_IMGFLAG_ALLOCATED){
-        /* because we allocate the whole image at once */
-        av_free(mpi->planes[0]);
-        if (mpi->flags & MP_IMGFLAG_RGB_PALETTE)
-            av_free(mpi->planes[1]);
-    }
+    call_release(mpi);
+    mp_image_free_planes(mpi);
     free(mpi);
 }
 
@@ -127,9 +127,14 @@ typedef struct mp_image {
     int chroma_height;
     int chroma_x_shift; // horizontal
     int chroma_y_shift; // vertical
-    int usage_count;
+    int usage_count;    // users holding the image, see mp_image_acquire()
+    unsigned int alloc_size; // size of the pooled planes[0] buffer
     /* for private use by filter or vo driver (to store buffer id or dmpi) */
     void* priv;
+    /* called once the last user released the image, to drop whatever
+     * backs planes[] when they are not allocated by the image itself */
+    void (*release)(struct mp_image *mpi);
+    void* release_priv;
 } mp_image_t;
 
 void mp_image_setfmt(mp_image_t* mpi,unsigned int out_fmt);
@@ -138,6 +143,10 @@ void free_mp_image(mp_image_t* mpi);
 
 mp_image_t* alloc_mpi(int w, int h, unsigned long int fmt);
 void mp_image_alloc_planes(mp_image_t *mpi);
+void mp_image_free_planes(mp_image_t *mpi);
+void mp_image_pool_uninit(void);
+void mp_image_acquire(mp_image_t *mpi);
+void mp_image_release(mp_image_t *mpi);
 void copy_mpi(mp_image_t *dmpi, mp_image_t *mpi);
 
 #endif /* MPLAYER_MP_IMAGE_H */
@@ -33,6 +33,7 @@ typedef struct vd_functions
         int (*init)(sh_video_t *sh);
         void (*uninit)(sh_video_t *sh);
         int (*control)(sh_video_t *sh,int cmd,void* arg, ...);
+        // returns an image with a reference for the caller, see mp_image_acquire()
         mp_image_t* (*decode)(sh_video_t *sh,void* data,int len,int flags);
 } vd_functions_t;
 
@@ -66,5 +67,7 @@ mp_image_t* mpcodecs_get_image(sh_video_t *sh, int mp_imgtype, int mp_imgflag, i
 void mpcodecs_draw_slice(sh_video_t *sh, unsigned char** src, int* stride, int w,int h, int x, int y);
 
 #define VDFLAGS_DROPFRAME 3
+/* frame precedes a precise seek target: decode cheaply, still return it */
+#define VDFLAGS_HRSEEK 4
 
 #endif /* MPLAYER_VD_H */
@@ -117,6 +117,7 @@ static char *lavc_param_skip_frame_str = NULL;
 static int lavc_param_threads=1;
 static int lavc_param_bitexact=0;
 static char *lavc_avopt = NULL;
+static enum AVDiscard skip_loop_filter;
 static enum AVDiscard skip_idct;
 static enum AVDiscard skip_frame;
 
@@ -357,6 +358,7 @@ static int init(sh_video_t *sh){
         }
     }
 
+    skip_loop_filter = avctx->skip_loop_filter;
     skip_idct = avctx->skip_idct;
     skip_frame = avctx->skip_frame;
 
@@ -667,11 +669,7 @@ static void release_buffer(struct AVCodecContext *avctx, AVFrame *pic){
             ctx->b_count--;
 
         // release mpi (in case MPI_IMGTYPE_NUMBERED is used, e.g. for VDPAU)
-        mpi->usage_count--;
-        if (mpi->usage_count < 0) {
-            mp_msg(MSGT_DECVIDEO, MSGL_ERR, "Bad mp_image usage count, please report!\n");
-            mpi->usage_count = 0;
-        }
+        mp_image_release(mpi);
     }
 
     for(i=0; i<4; i++){
@@ -718,6 +716,7 @@ static mp_image_t *decode(sh_video_t *sh, void *data, int len, int flags){
         }
     }
 
+    avctx->skip_loop_filter = skip_loop_filter;
     avctx->skip_idct = skip_idct;
     avctx->skip_frame = skip_frame;
 
@@ -725,6 +724,13 @@ static mp_image_t *decode(sh_video_t *sh, void *data, int len, int flags){
         avctx->skip_frame = AVDISCARD_NONREF;
         if (flags&2)
             avctx->skip_idct = AVDISCARD_ALL;
+    } else if (flags & VDFLAGS_HRSEEK) {
+        // Frames before a precise seek target are never shown, so only
+        // the reference frames have to be reconstructed exactly.
+        // Skipping non-reference frames completely would leave their
+        // pts in the reorder buffer, so they are only decoded roughly.
+        avctx->skip_loop_filter = FFMAX(avctx->skip_loop_filter, AVDISCARD_NONREF);
+        avctx->skip_idct        = FFMAX(avctx->skip_idct, AVDISCARD_NONREF);
     }
 
     if (data)
@@ -841,6 +847,8 @@ static mp_image_t *decode(sh_video_t *sh, void *data, int len, int flags){
 //--
 
     if(!got_picture) {
+        if (mpi)
+            mp_image_release(mpi);
         if (avctx->codec->id == AV_CODEC_ID_H264 &&
 	    skip_frame <= AVDISCARD_DEFAULT)
 	    return &mpi_no_picture; // H.264 first field only
@@ -848,10 +856,12 @@ static mp_image_t *decode(sh_video_t *sh, void *data, int len, int flags){
 	    return NULL;    // skipped image
     }
 
-    if(init_vo(sh, avctx->pix_fmt, 0) < 0) return NULL;
+    if(init_vo(sh, avctx->pix_fmt, 0) < 0) goto drop;
 
     if(dr1 && pic->opaque){
+        // the reference from get_buffer() stays with libavcodec
         mpi=pic->opaque;
+        mp_image_acquire(mpi);
     }
 
     if(!mpi)
@@ -866,7 +876,7 @@ static mp_image_t *decode(sh_video_t *sh, void *data, int len, int flags){
         pic->width < mpi->w || pic->height < mpi->h) {
         mp_msg(MSGT_DECVIDEO, MSGL_ERR, "Dropping frame with size not matching configured size (%ix%i vs %ix%i vs %ix%i)\n",
                mpi->w, mpi->h, pic->width, pic->height, avctx->width, avctx->height);
-        return NULL;
+        goto drop;
     }
 
     if(!dr1){
@@ -881,7 +891,7 @@ static mp_image_t *decode(sh_video_t *sh, void *data, int len, int flags){
     }
 
     if (!mpi->planes[0])
-        return NULL;
+        goto drop;
 
     if(ctx->best_csp == IMGFMT_422P && mpi->chroma_y_shift==1){
         // we have 422p but user wants 420p
@@ -899,6 +909,11 @@ static mp_image_t *decode(sh_video_t *sh, void *data, int len, int flags){
     if(pic->repeat_pict == 1) mpi->fields |= MP_IMGFIELD_REPEAT_FIRST;
 
     return mpi;
+
+drop:
+    if (mpi)
+        mp_image_release(mpi);
+    return NULL;
 }
 
 static enum AVPixelFormat get_format(struct AVCodecContext *avctx,
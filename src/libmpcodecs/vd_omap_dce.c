@@ -53,6 +53,7 @@
 #include "../mp_core.h"
 #include "osdep/timer.h"
 #include "../libvo/video_out.h"
+#include "../libvo/omap_dce_share.h"
 #include "libavcodec/avcodec.h"
 
 #define ALIGN2(value, align) (((value) + ((1 << (align)) - 1)) & ~((1 << (align)) - 1))
@@ -71,17 +72,6 @@ static const vd_info_t info = {
 
 LIBVD_EXTERN(omap_dce)
 
-typedef struct {
-	int     handle;
-} DisplayHandle;
-
-typedef struct {
-	void           *priv;
-	uint32_t       handle;
-	int            dmaBuf;
-	int            locked;
-} DisplayVideoBuffer;
-
 typedef struct {
 	uint8_t  *data[4]; // array of pointers for video planes
 	uint32_t stride[4]; // array of widths of video planes in bytes
@@ -98,12 +88,6 @@ typedef struct {
 	int                     locked;
 } FrameBuffer;
 
-typedef struct {
-	DisplayHandle handle;
-	int (*getDisplayVideoBuffer)(DisplayVideoBuffer *handle, uint32_t pixelfmt, int width, int height);
-	int (*releaseDisplayVideoBuffer)(DisplayVideoBuffer *handle);
-} omap_dce_share_t;
-
 omap_dce_share_t omap_dce_share;
 
 static Engine_Handle              _codecEngine;
@@ -502,6 +486,7 @@ static int init(sh_video_t *sh) {
 		goto fail;
 	}
 
+	omap_dce_share.active = 1;
 	return mpcodecs_config_vo(sh, _frameWidth, _frameHeight, IMGFMT_NV12);
 
 fail:
@@ -513,6 +498,8 @@ fail:
 static void uninit(sh_video_t *sh) {
 	int i;
 
+	omap_dce_share.active = 0;
+
 	if (_mpi) {
 		free_mp_image(_mpi);
 		_mpi = NULL;
@@ -770,6 +757,7 @@ static mp_image_t *decode(sh_video_t *sh, void *data, int len, int flags) {
 		mp_msg(MSGT_DECVIDEO, MSGL_ERR, "[vd_omap_dce] decode() repeatFirstFieldFlag\n");
 	}
 
+	mp_image_acquire(_mpi);
 	return _mpi;
 }
 
@@ -42,10 +42,12 @@
 #include "libavutil/mem.h"
 
 extern const vf_info_t vf_info_vo;
+extern const vf_info_t vf_info_lavfi;
 
 // list of available filters:
 static const vf_info_t* const filter_list[]={
     &vf_info_vo,
+    &vf_info_lavfi,
     NULL
 };
 
@@ -100,6 +102,41 @@ void vf_mpi_clear(mp_image_t* mpi,int x0,int y0,int w,int h){
     }
 }
 
+/**
+ * \brief Get image \p number of a pool, growing the pool if needed.
+ * \param number -1 for the first image nobody holds a reference to
+ */
+static mp_image_t *pool_image(mp_image_t ***imgs, int *num, int number, int w, int h){
+  if (number == -1) {
+    for (number = 0; number < *num; number++)
+      if (!(*imgs)[number] || !(*imgs)[number]->usage_count)
+        break;
+  }
+  if (number < 0)
+    return NULL;
+  if (number >= *num) {
+    int n = FFMAX(2 * *num, number + 1);
+    mp_image_t **p = realloc(*imgs, n * sizeof(*p));
+    if (!p)
+      return NULL;
+    memset(p + *num, 0, (n - *num) * sizeof(*p));
+    *imgs = p;
+    *num = n;
+  }
+  if (!(*imgs)[number])
+    (*imgs)[number] = new_mp_image(w, h);
+  if ((*imgs)[number])
+    (*imgs)[number]->number = number;
+  return (*imgs)[number];
+}
+
+static void free_pool(mp_image_t **imgs, int num){
+  int i;
+  for (i = 0; i < num; i++)
+    free_mp_image(imgs[i]);
+  free(imgs);
+}
+
 mp_image_t* vf_get_image(vf_instance_t* vf, unsigned int outfmt, int mp_imgtype, int mp_imgflag, int w, int h){
   mp_image_t* mpi=NULL;
   int w2;
@@ -126,7 +163,8 @@ mp_image_t* vf_get_image(vf_instance_t* vf, unsigned int outfmt, int mp_imgtype,
   if(vf->put_image==vf_next_put_image){
       // passthru mode, if the filter uses the fallback/default put_image() code
       mpi = vf_get_image(vf->next,outfmt,mp_imgtype,mp_imgflag,w,h);
-      mpi->usage_count++;
+      if (mpi)
+          mp_image_acquire(mpi);
       return mpi;
   }
 
@@ -134,21 +172,18 @@ mp_image_t* vf_get_image(vf_instance_t* vf, unsigned int outfmt, int mp_imgtype,
   // and if not, then fallback to software buffers:
   switch(mp_imgtype & 0xff){
   case MP_IMGTYPE_EXPORT:
-    if(!vf->imgctx.export_images[0]) vf->imgctx.export_images[0]=new_mp_image(w2,h);
-    mpi=vf->imgctx.export_images[0];
+    mpi = pool_image(&vf->imgctx.export_images, &vf->imgctx.num_export_images, -1, w2, h);
     break;
   case MP_IMGTYPE_STATIC:
     if(!vf->imgctx.static_images[0]) vf->imgctx.static_images[0]=new_mp_image(w2,h);
     mpi=vf->imgctx.static_images[0];
     break;
   case MP_IMGTYPE_TEMP:
-    if(!vf->imgctx.temp_images[0]) vf->imgctx.temp_images[0]=new_mp_image(w2,h);
-    mpi=vf->imgctx.temp_images[0];
+    mpi = pool_image(&vf->imgctx.temp_images, &vf->imgctx.num_temp_images, -1, w2, h);
     break;
   case MP_IMGTYPE_IPB:
     if(!(mp_imgflag&MP_IMGFLAG_READABLE)){ // B frame:
-      if(!vf->imgctx.temp_images[0]) vf->imgctx.temp_images[0]=new_mp_image(w2,h);
-      mpi=vf->imgctx.temp_images[0];
+      mpi = pool_image(&vf->imgctx.temp_images, &vf->imgctx.num_temp_images, -1, w2, h);
       break;
     }
   case MP_IMGTYPE_IP:
@@ -157,20 +192,7 @@ mp_image_t* vf_get_image(vf_instance_t* vf, unsigned int outfmt, int mp_imgtype,
     vf->imgctx.static_idx^=1;
     break;
   case MP_IMGTYPE_NUMBERED:
-    if (number == -1) {
-      int i;
-      for (i = 0; i < NUM_NUMBERED_MPI; i++)
-        if (!vf->imgctx.numbered_images[i] || !vf->imgctx.numbered_images[i]->usage_count)
-          break;
-      number = i;
-    }
-    if (number < 0 || number >= NUM_NUMBERED_MPI) {
-      mp_msg(MSGT_VFILTER, MSGL_FATAL, "Ran out of numbered images, expect crash. Filter before %s is broken.\n", vf->info->name);
-      return NULL;
-    }
-    if (!vf->imgctx.numbered_images[number]) vf->imgctx.numbered_images[number] = new_mp_image(w2,h);
-    mpi = vf->imgctx.numbered_images[number];
-    mpi->number = number;
+    mpi = pool_image(&vf->imgctx.numbered_images, &vf->imgctx.num_numbered_images, number, w2, h);
     break;
   }
 
@@ -191,13 +213,7 @@ mp_image_t* vf_get_image(vf_instance_t* vf, unsigned int outfmt, int mp_imgtype,
         if(mpi->flags&MP_IMGFLAG_ALLOCATED){
             if(mpi->width<w2 || mpi->height<h || mpi->imgfmt != outfmt || missing_palette){
                 // need to re-allocate buffer memory:
-                av_freep(&mpi->planes[0]);
-                if (mpi->flags & MP_IMGFLAG_RGB_PALETTE)
-                    av_freep(&mpi->planes[1]);
-                mpi->planes[1] = NULL;
-                mpi->planes[2] = NULL;
-                mpi->planes[3] = NULL;
-                mpi->flags&=~MP_IMGFLAG_ALLOCATED;
+                mp_image_free_planes(mpi);
                 mpi->bpp = 0;
                 mp_msg(MSGT_VFILTER,MSGL_V,"vf.c: have to REALLOCATE buffer memory in vf_%s :(\n",
                        vf->info->name);
@@ -270,7 +286,7 @@ mp_image_t* vf_get_image(vf_instance_t* vf, unsigned int outfmt, int mp_imgtype,
     }
 
   mpi->qscale = NULL;
-  mpi->usage_count++;
+  mp_image_acquire(mpi);
   // TODO: figure out what is going on with EXPORT types
   if (mpi->usage_count > 1 && mpi->type != MP_IMGTYPE_EXPORT)
       mp_msg(MSGT_VFILTER, MSGL_V, "Suspicious mp_image usage count %i in vf_%s (type %i)\n",
@@ -523,13 +539,11 @@ int vf_next_query_format(struct vf_instance *vf, unsigned int fmt){
 }
 
 int vf_next_put_image(struct vf_instance *vf,mp_image_t *mpi, double pts, double endpts){
-    mpi->usage_count--;
-    if (mpi->usage_count < 0) {
-        mp_msg(MSGT_VFILTER, MSGL_V, "Bad mp_image usage count %i in vf_%s (type %i)\n",
-               mpi->usage_count, vf->info->name, mpi->type);
-        mpi->usage_count = 0;
-    }
-    return vf->next->put_image(vf->next,mpi, pts, endpts);
+    // the reference from vf_get_image() is given up only afterwards,
+    // the next filter acquires the image if it keeps it
+    int ret = vf->next->put_image(vf->next,mpi, pts, endpts);
+    mp_image_release(mpi);
+    return ret;
 }
 
 void vf_next_draw_slice(struct vf_instance *vf,unsigned char** src, int * stride,int w, int h, int x, int y){
@@ -580,8 +594,9 @@ void vf_uninit_filter(vf_instance_t* vf){
     else free(vf->priv);
     free_mp_image(vf->imgctx.static_images[0]);
     free_mp_image(vf->imgctx.static_images[1]);
-    free_mp_image(vf->imgctx.temp_images[0]);
-    free_mp_image(vf->imgctx.export_images[0]);
+    free_pool(vf->imgctx.temp_images, vf->imgctx.num_temp_images);
+    free_pool(vf->imgctx.export_images, vf->imgctx.num_export_images);
+    free_pool(vf->imgctx.numbered_images, vf->imgctx.num_numbered_images);
     free(vf);
 }
 
@@ -38,13 +38,16 @@ typedef struct vf_info_s {
     const void* opts;
 } vf_info_t;
 
-#define NUM_NUMBERED_MPI 50
-
 typedef struct vf_image_context_s {
+    // static and IP images keep their contents from frame to frame
     mp_image_t* static_images[2];
-    mp_image_t* temp_images[1];
-    mp_image_t* export_images[1];
-    mp_image_t* numbered_images[NUM_NUMBERED_MPI];
+    // the others are pools that grow while all their images are in use
+    mp_image_t** temp_images;
+    int num_temp_images;
+    mp_image_t** export_images;
+    int num_export_images;
+    mp_image_t** numbered_images;
+    int num_numbered_images;
     int static_idx;
 } vf_image_context_t;
 
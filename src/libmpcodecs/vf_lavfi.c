@@ -0,0 +1,412 @@
+/*
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * \file
+ * \brief Run a libavfilter graph as a video filter.
+ *
+ * Usage: -vf lavfi=graph=%12%yadif,hqdn3d:threads=4
+ * (the %len% prefix lets the graph contain ',' and ':').
+ *
+ * Images are handed to the graph without copying when they were
+ * direct rendered into buffers from get_image(), which are refcounted
+ * so the graph can keep them as long as it needs. Output frames are
+ * exported to the next filter without copying, each image holds a
+ * reference to its frame until it is released.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "mp_msg.h"
+#include "m_option.h"
+#include "m_struct.h"
+#include "fmt-conversion.h"
+#include "img_format.h"
+#include "mp_image.h"
+#include "vf.h"
+
+#include "libavfilter/avfilter.h"
+#include "libavfilter/buffersink.h"
+#include "libavfilter/buffersrc.h"
+#include "libavutil/imgutils.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+
+// linesize alignment of the direct rendering buffers
+#define DR_ALIGN 64
+
+struct vf_priv_s {
+    char *graph_str;
+    int threads;
+
+    AVFilterGraph *graph;
+    AVFilterContext *in;
+    AVFilterContext *out;
+    AVFrame *frame;
+    AVBufferPool *pool;    ///< buffers handed out by get_image()
+    int pool_size;
+    enum AVPixelFormat in_pixfmt;
+    unsigned int out_fmt;
+    AVRational sar;
+    AVRational time_base;  ///< of the frames coming out of the graph
+    double in_pts, in_endpts;
+    int warned_copy;
+};
+
+static const struct vf_priv_s vf_priv_dflt = {
+    NULL,
+    0,
+};
+
+static void uninit_graph(struct vf_priv_s *p)
+{
+    avfilter_graph_free(&p->graph);
+    p->in  = NULL;
+    p->out = NULL;
+}
+
+static int config(struct vf_instance *vf,
+                  int width, int height, int d_width, int d_height,
+                  unsigned int flags, unsigned int outfmt)
+{
+    struct vf_priv_s *p = vf->priv;
+    AVFilterInOut *outputs = NULL, *inputs = NULL;
+    enum AVPixelFormat pix_fmts[AV_PIX_FMT_NB + 1];
+    AVRational out_sar;
+    char args[256];
+    int out_w, out_h;
+    int i, n = 0;
+
+    p->in_pixfmt = imgfmt2pixfmt(outfmt);
+    if (p->in_pixfmt == AV_PIX_FMT_NONE)
+        return 0;
+
+    uninit_graph(p);
+    p->graph = avfilter_graph_alloc();
+    if (!p->graph)
+        goto fail;
+    p->graph->nb_threads = p->threads;
+
+    p->sar.num = d_width  * height;
+    p->sar.den = d_height * width;
+    snprintf(args, sizeof(args),
+             "video_size=%dx%d:pix_fmt=%d:time_base=1/%d:pixel_aspect=%d/%d",
+             width, height, p->in_pixfmt, AV_TIME_BASE, p->sar.num, p->sar.den);
+    if (avfilter_graph_create_filter(&p->in, avfilter_get_by_name("buffer"),
+                                     "src", args, NULL, p->graph) < 0 ||
+        avfilter_graph_create_filter(&p->out, avfilter_get_by_name("buffersink"),
+                                     "sink", NULL, NULL, p->graph) < 0)
+        goto fail;
+
+    // let the graph convert to whatever the rest of the chain takes
+    for (i = 0; i < AV_PIX_FMT_NB; i++) {
+        int fmt = pixfmt2imgfmt(i);
+        if (fmt && vf_next_query_format(vf, fmt))
+            pix_fmts[n++] = i;
+    }
+    pix_fmts[n] = AV_PIX_FMT_NONE;
+    if (av_opt_set_int_list(p->out, "pix_fmts", pix_fmts, AV_PIX_FMT_NONE,
+                            AV_OPT_SEARCH_CHILDREN) < 0)
+        goto fail;
+
+    outputs = avfilter_inout_alloc();
+    inputs  = avfilter_inout_alloc();
+    if (!outputs || !inputs)
+        goto fail;
+    outputs->name       = av_strdup("in");
+    outputs->filter_ctx = p->in;
+    inputs->name        = av_strdup("out");
+    inputs->filter_ctx  = p->out;
+    if (avfilter_graph_parse_ptr(p->graph, p->graph_str ? p->graph_str : "null",
+                                 &inputs, &outputs, NULL) < 0 ||
+        avfilter_graph_config(p->graph, NULL) < 0)
+        goto fail;
+    avfilter_inout_free(&inputs);
+    avfilter_inout_free(&outputs);
+
+    out_w        = av_buffersink_get_w(p->out);
+    out_h        = av_buffersink_get_h(p->out);
+    out_sar      = av_buffersink_get_sample_aspect_ratio(p->out);
+    p->time_base = av_buffersink_get_time_base(p->out);
+    p->out_fmt   = pixfmt2imgfmt(av_buffersink_get_format(p->out));
+    if (out_sar.num > 0 && out_sar.den > 0) {
+        d_width  = lrint(out_w * av_q2d(out_sar));
+        d_height = out_h;
+    } else {
+        d_width  = (int64_t)d_width  * out_w / width;
+        d_height = (int64_t)d_height * out_h / height;
+    }
+    mp_msg(MSGT_VFILTER, MSGL_V, "[lavfi] %dx%d %s -> %dx%d %s, %d threads\n",
+           width, height, vo_format_name(outfmt),
+           out_w, out_h, vo_format_name(p->out_fmt), p->graph->nb_threads);
+    return vf_next_config(vf, out_w, out_h, d_width, d_height, flags, p->out_fmt);
+
+fail:
+    mp_msg(MSGT_VFILTER, MSGL_ERR, "[lavfi] Cannot configure filter graph \"%s\".\n",
+           p->graph_str ? p->graph_str : "null");
+    avfilter_inout_free(&inputs);
+    avfilter_inout_free(&outputs);
+    uninit_graph(p);
+    return 0;
+}
+
+static int in_pool(mp_image_t **imgs, int num, mp_image_t *mpi)
+{
+    int i;
+    for (i = 0; i < num; i++)
+        if (mpi == imgs[i])
+            return 1;
+    return 0;
+}
+
+static void unref_pool(mp_image_t **imgs, int num)
+{
+    int i;
+    for (i = 0; i < num; i++)
+        if (imgs[i])
+            av_buffer_unref((AVBufferRef **)&imgs[i]->priv);
+}
+
+/**
+ * \brief Return the buffer get_image() put into \p mpi, if any.
+ * Only images from our own slots qualify, anything else may carry
+ * another filter's private data.
+ */
+static AVBufferRef *own_buffer(struct vf_instance *vf, mp_image_t *mpi)
+{
+    vf_image_context_t *ctx = &vf->imgctx;
+    if (!(mpi->flags & MP_IMGFLAG_DIRECT) || !mpi->priv)
+        return NULL;
+    if (mpi == ctx->static_images[0] || mpi == ctx->static_images[1] ||
+        in_pool(ctx->temp_images, ctx->num_temp_images, mpi) ||
+        in_pool(ctx->numbered_images, ctx->num_numbered_images, mpi))
+        return mpi->priv;
+    return NULL;
+}
+
+static void get_image(struct vf_instance *vf, mp_image_t *mpi)
+{
+    struct vf_priv_s *p = vf->priv;
+    enum AVPixelFormat pixfmt = imgfmt2pixfmt(mpi->imgfmt);
+    uint8_t *data[4];
+    int linesize[4];
+    AVBufferRef *buf;
+    int size, i;
+
+    // drop the buffer this slot had before, the graph holds its own
+    // reference for as long as it still needs the data
+    av_buffer_unref((AVBufferRef **)&mpi->priv);
+    // static images are updated partially and need to keep their
+    // contents, which a fresh buffer for every frame would not
+    if (mpi->type == MP_IMGTYPE_STATIC || pixfmt == AV_PIX_FMT_NONE ||
+        (mpi->flags & MP_IMGFLAG_RGB_PALETTE))
+        return;
+
+    size = av_image_get_buffer_size(pixfmt, FFALIGN(mpi->width, DR_ALIGN),
+                                    mpi->height, DR_ALIGN);
+    if (size <= 0)
+        return;
+    if (size != p->pool_size) {
+        av_buffer_pool_uninit(&p->pool);
+        p->pool      = av_buffer_pool_init(size, NULL);
+        p->pool_size = p->pool ? size : 0;
+    }
+    buf = p->pool ? av_buffer_pool_get(p->pool) : NULL;
+    if (!buf)
+        return;
+    av_image_fill_arrays(data, linesize, buf->data, pixfmt,
+                         FFALIGN(mpi->width, DR_ALIGN), mpi->height, DR_ALIGN);
+    for (i = 0; i < 4; i++) {
+        mpi->planes[i] = data[i];
+        mpi->stride[i] = linesize[i];
+    }
+    mpi->priv   = buf;
+    mpi->flags |= MP_IMGFLAG_DIRECT;
+}
+
+// the exported image can outlive the call to the next filter
+static void release_frame(mp_image_t *mpi)
+{
+    av_frame_free((AVFrame **)&mpi->release_priv);
+}
+
+static int output_frame(struct vf_instance *vf)
+{
+    struct vf_priv_s *p = vf->priv;
+    AVFrame *frame;
+    mp_image_t *dmpi;
+    double pts = MP_NOPTS_VALUE, endpts = MP_NOPTS_VALUE;
+    int i, ret;
+
+    if (!p->out)
+        return 0;
+    frame = av_frame_alloc();
+    if (!frame)
+        return 0;
+    if (av_buffersink_get_frame(p->out, frame) < 0) {
+        av_frame_free(&frame);
+        return 0;
+    }
+    if (frame->pts != AV_NOPTS_VALUE)
+        pts = frame->pts * av_q2d(p->time_base);
+    // the end time only carries over if the graph kept the frame timing
+    if (pts == p->in_pts)
+        endpts = p->in_endpts;
+
+    dmpi = vf_get_image(vf->next, p->out_fmt, MP_IMGTYPE_EXPORT, 0,
+                        frame->width, frame->height);
+    if (!dmpi) {
+        av_frame_free(&frame);
+        return 0;
+    }
+    dmpi->release      = release_frame;
+    dmpi->release_priv = frame;
+    for (i = 0; i < 4; i++) {
+        dmpi->planes[i] = frame->data[i];
+        dmpi->stride[i] = frame->linesize[i];
+    }
+    dmpi->pict_type = frame->pict_type;
+    dmpi->fields    = 0;
+    if (frame->interlaced_frame)
+        dmpi->fields |= MP_IMGFIELD_INTERLACED | MP_IMGFIELD_ORDERED;
+    if (frame->top_field_first)
+        dmpi->fields |= MP_IMGFIELD_TOP_FIRST;
+
+    // frees the frame unless the next filter keeps the image
+    ret = vf_next_put_image(vf, dmpi, pts, endpts);
+    // filters like yadif=1 return more than one frame per input
+    vf_queue_frame(vf, output_frame);
+    return ret;
+}
+
+static int put_image(struct vf_instance *vf, mp_image_t *mpi,
+                     double pts, double endpts)
+{
+    struct vf_priv_s *p = vf->priv;
+    AVFrame *frame = p->frame;
+    AVBufferRef *buf = own_buffer(vf, mpi);
+    int i;
+
+    if (!p->in)
+        return 0;
+
+    frame->width  = mpi->w;
+    frame->height = mpi->h;
+    frame->format = p->in_pixfmt;
+    frame->sample_aspect_ratio = p->sar;
+    frame->pts = pts == MP_NOPTS_VALUE ? AV_NOPTS_VALUE : llrint(pts * AV_TIME_BASE);
+    frame->pict_type        = mpi->pict_type;
+    frame->interlaced_frame = !!(mpi->fields & MP_IMGFIELD_INTERLACED);
+    frame->top_field_first  = !!(mpi->fields & MP_IMGFIELD_TOP_FIRST);
+    if (buf) {
+        frame->buf[0] = av_buffer_ref(buf);
+        if (!frame->buf[0])
+            return 0;
+        for (i = 0; i < 4; i++) {
+            frame->data[i]     = mpi->planes[i];
+            frame->linesize[i] = mpi->stride[i];
+        }
+    } else {
+        // exported or static images belong to the decoder and can
+        // change before the graph is done with them
+        if (!p->warned_copy) {
+            mp_msg(MSGT_VFILTER, MSGL_V, "[lavfi] Input is not direct rendered, copying frames.\n");
+            p->warned_copy = 1;
+        }
+        if (av_frame_get_buffer(frame, DR_ALIGN) < 0) {
+            av_frame_unref(frame);
+            return 0;
+        }
+        av_image_copy(frame->data, frame->linesize,
+                      (const uint8_t **)mpi->planes, mpi->stride,
+                      p->in_pixfmt, mpi->w, mpi->h);
+    }
+    p->in_pts    = pts;
+    p->in_endpts = endpts;
+    if (av_buffersrc_add_frame(p->in, frame) < 0) {
+        av_frame_unref(frame);
+        return 0;
+    }
+    return output_frame(vf);
+}
+
+static int query_format(struct vf_instance *vf, unsigned int fmt)
+{
+    if (imgfmt2pixfmt(fmt) == AV_PIX_FMT_NONE)
+        return 0;
+    // the graph converts to a format the next filter accepts
+    return VFCAP_CSP_SUPPORTED | VFCAP_ACCEPT_STRIDE;
+}
+
+static void uninit(struct vf_instance *vf)
+{
+    struct vf_priv_s *p = vf->priv;
+    vf_image_context_t *ctx = &vf->imgctx;
+    int i;
+
+    // direct rendered planes are not owned by the images themselves
+    for (i = 0; i < 2; i++)
+        if (ctx->static_images[i])
+            av_buffer_unref((AVBufferRef **)&ctx->static_images[i]->priv);
+    unref_pool(ctx->temp_images, ctx->num_temp_images);
+    unref_pool(ctx->numbered_images, ctx->num_numbered_images);
+    av_buffer_pool_uninit(&p->pool);
+    av_frame_free(&p->frame);
+    uninit_graph(p);
+    m_struct_free(vf->info->opts, p);
+}
+
+static int vf_open(vf_instance_t *vf, char *args)
+{
+    vf->config       = config;
+    vf->query_format = query_format;
+    vf->get_image    = get_image;
+    vf->put_image    = put_image;
+    vf->uninit       = uninit;
+    vf->priv->frame  = av_frame_alloc();
+    if (!vf->priv->frame)
+        return 0;
+    return 1;
+}
+
+#define ST_OFF(f) M_ST_OFF(struct vf_priv_s, f)
+static const m_option_t vf_opts_fields[] = {
+    {"graph",   ST_OFF(graph_str), CONF_TYPE_STRING, 0, 0, 0, NULL},
+    {"threads", ST_OFF(threads),   CONF_TYPE_INT, M_OPT_RANGE, 0, 64, NULL},
+    { NULL, NULL, 0, 0, 0, 0, NULL }
+};
+
+static const m_struct_t vf_opts = {
+    "lavfi",
+    sizeof(struct vf_priv_s),
+    &vf_priv_dflt,
+    vf_opts_fields
+};
+
+const vf_info_t vf_info_lavfi = {
+    "libavfilter bridge",
+    "lavfi",
+    "",
+    "threads=0 lets libavfilter pick the thread count",
+    vf_open,
+    &vf_opts
+};
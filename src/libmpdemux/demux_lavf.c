@@ -19,13 +19,19 @@
  */
 
 #include <stdlib.h>
+#include <stdio.h>
 #include <limits.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "config.h"
 #include "mp_msg.h"
 #include "help_mp.h"
 #include "av_opts.h"
 #include "av_helpers.h"
+#include "path.h"
+#include "osdep/timer.h"
 
 #include "stream/stream.h"
 #include "demuxer.h"
@@ -54,8 +60,9 @@ static unsigned int opt_analyzeduration = 0;
 static char *opt_format;
 static char *opt_cryptokey;
 static char *opt_avopt = NULL;
-static AVBSFContext *bsf_handle;
-static int first_frame;
+static int opt_keyindex = 1;
+static int opt_keyindexcache = 1;
+static int opt_faststart = 0;
 
 const m_option_t lavfdopts_conf[] = {
 	{"probesize", &(opt_probesize), CONF_TYPE_INT, CONF_RANGE, 32, INT_MAX, NULL},
@@ -63,11 +70,64 @@ const m_option_t lavfdopts_conf[] = {
 	{"analyzeduration",    &(opt_analyzeduration),    CONF_TYPE_INT,       CONF_RANGE,  0,       INT_MAX, NULL},
 	{"cryptokey", &(opt_cryptokey), CONF_TYPE_STRING,       0,  0,       0, NULL},
         {"o",                  &opt_avopt,                CONF_TYPE_STRING,    0,           0,             0, NULL},
+	{"keyindex", &(opt_keyindex), CONF_TYPE_FLAG, 0, 0, 1, NULL},
+	{"keyindexcache", &(opt_keyindexcache), CONF_TYPE_FLAG, 0, 0, 1, NULL},
+	{"faststart", &(opt_faststart), CONF_TYPE_FLAG, 0, 0, 1, NULL},
 	{NULL, NULL, 0, 0, 0, 0, NULL}
 };
 
 #define BIO_BUFFER_SIZE 32768
 
+// keyframes closer than this (in AV_TIME_BASE units) to an existing index
+// entry are not added to the keyframe index
+#define KEYIDX_MIN_DIST (AV_TIME_BASE / 4)
+#define KEYIDX_MAX_ENTRIES (1 << 20)
+#define KEYIDX_MAGIC MKTAG('M', 'P', 'K', 'I')
+#define KEYIDX_VERSION 1
+// no other keyframe of the indexed stream lies between this entry
+// and the previous one
+#define KEYIDX_CONTIGUOUS 1
+
+typedef struct lavf_keyframe {
+    int64_t pts; ///< AV_TIME_BASE units, same scale as lavf_priv.last_pts
+    int64_t pos; ///< byte position as seen by the AVIOContext
+    int flags;
+} lavf_keyframe_t;
+
+typedef struct lavf_keyidx_header {
+    uint32_t magic;
+    uint32_t version;
+    int64_t file_size;
+    int64_t file_mtime;
+    int32_t stream;
+    int32_t entries;
+} lavf_keyidx_header_t;
+
+// number of sources whose stream parameters are remembered for fast start
+#define PARAMS_CACHE_SIZE 8
+
+typedef struct lavf_stream_params {
+    int id;
+    enum AVMediaType codec_type;
+    enum AVCodecID codec_id;
+    int width, height;
+    int sample_rate;
+    int channels;
+    AVRational frame_rate;
+    uint8_t *extradata;
+    int extradata_size;
+} lavf_stream_params_t;
+
+typedef struct lavf_params_cache {
+    char *url;
+    const AVInputFormat *avif;
+    int nb_streams;
+    lavf_stream_params_t *streams;
+    int64_t last_used;      ///< GetTimerNS() of the last open, for eviction
+} lavf_params_cache_t;
+
+static lavf_params_cache_t params_cache[PARAMS_CACHE_SIZE];
+
 typedef struct lavf_priv {
     const AVInputFormat *avif;
     AVFormatContext *avfc;
@@ -83,6 +143,22 @@ typedef struct lavf_priv {
     int nb_streams_last;
     int use_lavf_netstream;
     int r_gain;
+    // keyframe index, sorted by pts
+    lavf_keyframe_t *keyidx;
+    int keyidx_num;
+    int keyidx_max;
+    int keyidx_stream;  ///< stream the index is built for, -1 if disabled
+    int keyidx_last;    ///< entry of the last keyframe read, -1 after seeks
+    int keyidx_dirty;
+    char *keyidx_file;  ///< persistent cache file, NULL if not cached
+    int64_t keyidx_file_size;
+    int64_t keyidx_file_mtime;
+    AVBSFContext *bsf_handle;
+    int first_frame;
+    int faststart;              ///< opened without avformat_find_stream_info
+    int hold_codecdata;         ///< see DEMUXER_CTRL_HOLD_CODECDATA
+    int got_packet;
+    unsigned int open_done;     ///< GetTimer() at the end of demux_open_lavf
 }lavf_priv_t;
 
 static int mp_read(void *opaque, uint8_t *buf, int size) {
@@ -94,8 +170,9 @@ static int mp_read(void *opaque, uint8_t *buf, int size) {
     if (!ret && stream->eof)
       ret = AVERROR_EOF;
 
-    mp_msg(MSGT_HEADER,MSGL_DBG2,"%d=mp_read(%p, %p, %d), pos: %"PRId64", eof:%d\n",
-           ret, stream, buf, size, stream_tell(stream), stream->eof);
+    mp_trace(MSGT_HEADER,MSGL_DBG2,"%"PRId64"=mp_read(%#"PRIx64", %#"PRIx64", %"PRId64"), pos: %"PRId64", eof:%"PRId64"\n",
+             (int64_t)ret, (int64_t)(intptr_t)stream, (int64_t)(intptr_t)buf,
+             (int64_t)size, (int64_t)stream_tell(stream), (int64_t)stream->eof);
     return ret;
 }
 
@@ -103,7 +180,8 @@ static int64_t mp_seek(void *opaque, int64_t pos, int whence) {
     demuxer_t *demuxer = opaque;
     stream_t *stream = demuxer->stream;
     int64_t current_pos;
-    mp_msg(MSGT_HEADER,MSGL_DBG2,"mp_seek(%p, %"PRId64", %d)\n", stream, pos, whence);
+    mp_trace(MSGT_HEADER,MSGL_DBG2,"mp_seek(%#"PRIx64", %"PRId64", %"PRId64")\n",
+             (int64_t)(intptr_t)stream, pos, (int64_t)whence);
     if(whence == SEEK_CUR)
         pos +=stream_tell(stream);
     else if(whence == SEEK_END && stream->end_pos > 0)
@@ -154,12 +232,29 @@ static void list_formats(void) {
         mp_msg(MSGT_DEMUX, MSGL_INFO, "%15s : %s\n", fmt->name, fmt->long_name);
 }
 
+/**
+ * \brief recognize the containers fast start handles by their first bytes
+ * \return lavf input format name or NULL to run the normal probe
+ */
+static const char *faststart_probe(const uint8_t *buf, int size)
+{
+    if (size >= 3 * 188 &&
+        buf[0] == 0x47 && buf[188] == 0x47 && buf[2 * 188] == 0x47)
+        return "mpegts";
+    if (size >= 8 && (!memcmp(buf + 4, "ftyp", 4) || !memcmp(buf + 4, "moov", 4)))
+        return "mov";
+    if (size >= 4 && AV_RB32(buf) == 0x1A45DFA3)
+        return "matroska";
+    return NULL;
+}
+
 static int lavf_check_file(demuxer_t *demuxer){
     AVProbeData avpd = { 0 };
     lavf_priv_t *priv;
     int probe_data_size = 0;
     int read_size = INITIAL_PROBE_SIZE;
     int score;
+    unsigned int t = GetTimer();
 
     if(!demuxer->priv) {
         demuxer->priv=calloc(sizeof(lavf_priv_t),1);
@@ -195,6 +290,11 @@ static int lavf_check_file(demuxer_t *demuxer){
         avpd.filename= "";
         avpd.buf_size= probe_data_size;
 
+        if (opt_faststart) {
+            const char *name = faststart_probe(avpd.buf, probe_data_size);
+            if (name && (priv->avif = av_find_input_format(name)))
+                break;
+        }
         score = 0;
         priv->avif= av_probe_input_format2(&avpd, probe_data_size > 0, &score);
         read_size = FFMIN(2*read_size, PROBE_BUF_SIZE - probe_data_size);
@@ -202,6 +302,7 @@ static int lavf_check_file(demuxer_t *demuxer){
              score <= AVPROBE_SCORE_MAX / 4 &&
              read_size > 0 && probe_data_size < PROBE_BUF_SIZE);
     av_free(avpd.buf);
+    demuxer->startup_time[DEMUX_STARTUP_PROBE] = GetTimer() - t;
 
     if(!priv->avif){
         mp_msg(MSGT_HEADER,MSGL_V,"LAVF_check: no clue about this gibberish!\n");
@@ -408,20 +509,20 @@ static void handle_stream(demuxer_t *demuxer, AVFormatContext *avfc, int i) {
             }
             if (codec_ctx && codec->codec_id == AV_CODEC_ID_H264) {
                 if (codec->extradata && codec->extradata_size > 0 && codec->extradata[0] == 1) {
-                    if (!bsf_handle) {
+                    if (!priv->bsf_handle) {
                         const AVBitStreamFilter *bsf = av_bsf_get_by_name("h264_mp4toannexb");
                         if (bsf) {
-                            if (av_bsf_alloc(bsf, &bsf_handle) >= 0) {
-                                if (avcodec_parameters_from_context(bsf_handle->par_in, codec_ctx) >= 0) {
-                                    if (av_bsf_init(bsf_handle) < 0) {
+                            if (av_bsf_alloc(bsf, &priv->bsf_handle) >= 0) {
+                                if (avcodec_parameters_from_context(priv->bsf_handle->par_in, codec_ctx) >= 0) {
+                                    if (av_bsf_init(priv->bsf_handle) < 0) {
                                         mp_msg(MSGT_DEMUX, MSGL_FATAL, "Error init bsf\n");
-                                        av_bsf_free(&bsf_handle);
-                                        bsf_handle = NULL;
+                                        av_bsf_free(&priv->bsf_handle);
+                                        priv->bsf_handle = NULL;
                                     }
                                 } else {
                                     mp_msg(MSGT_DEMUX, MSGL_FATAL, "Error copy bsf paramters\n");
-                                    av_bsf_free(&bsf_handle);
-                                    bsf_handle = NULL;
+                                    av_bsf_free(&priv->bsf_handle);
+                                    priv->bsf_handle = NULL;
                                 }
                             } else {
                                 mp_msg(MSGT_DEMUX, MSGL_FATAL, "Error alloc bsf filter\n");
@@ -430,25 +531,25 @@ static void handle_stream(demuxer_t *demuxer, AVFormatContext *avfc, int i) {
                             mp_msg(MSGT_DEMUX, MSGL_FATAL, "Error finding h264_mp4toannexb filter\n");
                         }
                     }
-                    if (!bsf_handle)
+                    if (!priv->bsf_handle)
                         mp_msg(MSGT_DEMUX, MSGL_FATAL, "Error enable h264_mp4toannexb filter\n");
                 }
             }
             if (codec_ctx && codec->codec_id == AV_CODEC_ID_MPEG4) {
-                if (!bsf_handle) {
+                if (!priv->bsf_handle) {
                     const AVBitStreamFilter *bsf = av_bsf_get_by_name("mpeg4_unpack_bframes");
                     if (bsf) {
-                        if (av_bsf_alloc(bsf, &bsf_handle) >= 0) {
-                            if (avcodec_parameters_from_context(bsf_handle->par_in, codec_ctx) >= 0) {
-                                if (av_bsf_init(bsf_handle) < 0) {
+                        if (av_bsf_alloc(bsf, &priv->bsf_handle) >= 0) {
+                            if (avcodec_parameters_from_context(priv->bsf_handle->par_in, codec_ctx) >= 0) {
+                                if (av_bsf_init(priv->bsf_handle) < 0) {
                                     mp_msg(MSGT_DEMUX, MSGL_FATAL, "Error init bsf\n");
-                                    av_bsf_free(&bsf_handle);
-                                    bsf_handle = NULL;
+                                    av_bsf_free(&priv->bsf_handle);
+                                    priv->bsf_handle = NULL;
                                 }
                             } else {
                                 mp_msg(MSGT_DEMUX, MSGL_FATAL, "Error copy bsf paramters\n");
-                                av_bsf_free(&bsf_handle);
-                                bsf_handle = NULL;
+                                av_bsf_free(&priv->bsf_handle);
+                                priv->bsf_handle = NULL;
                             }
                         } else {
                             mp_msg(MSGT_DEMUX, MSGL_FATAL, "Error alloc bsf filter\n");
@@ -457,7 +558,7 @@ static void handle_stream(demuxer_t *demuxer, AVFormatContext *avfc, int i) {
                         mp_msg(MSGT_DEMUX, MSGL_FATAL, "Error finding h264_mp4toannexb filter\n");
                     }
                 }
-                if (!bsf_handle)
+                if (!priv->bsf_handle)
                     mp_msg(MSGT_DEMUX, MSGL_FATAL, "Error enable h264_mp4toannexb filter\n");
             }
             if (codec_ctx)
@@ -537,6 +638,394 @@ static void handle_stream(demuxer_t *demuxer, AVFormatContext *avfc, int i) {
     }
 }
 
+/**
+ * \brief find the first keyframe index entry with pts >= \p pts
+ */
+static int keyidx_search(lavf_priv_t *priv, int64_t pts)
+{
+    int lo = 0, hi = priv->keyidx_num;
+    while (lo < hi) {
+        int mid = (lo + hi) >> 1;
+        if (priv->keyidx[mid].pts < pts)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static void keyidx_add(lavf_priv_t *priv, AVStream *st, AVPacket *pkt)
+{
+    int64_t ts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+    int i, known = -1;
+
+    if (ts == AV_NOPTS_VALUE || pkt->pos < 0)
+        return;
+    ts = av_rescale_q(ts, st->time_base, AV_TIME_BASE_Q);
+
+    i = keyidx_search(priv, ts);
+    if (i < priv->keyidx_num && priv->keyidx[i].pts - ts < KEYIDX_MIN_DIST)
+        known = i;
+    else if (i > 0 && ts - priv->keyidx[i - 1].pts < KEYIDX_MIN_DIST)
+        known = i - 1;
+    if (known >= 0) {
+        // already indexed, but we may have learned that it directly
+        // follows the previous entry
+        if (known > 0 && priv->keyidx_last == known - 1 &&
+            !(priv->keyidx[known].flags & KEYIDX_CONTIGUOUS)) {
+            priv->keyidx[known].flags |= KEYIDX_CONTIGUOUS;
+            priv->keyidx_dirty = 1;
+        }
+        priv->keyidx_last = known;
+        return;
+    }
+    if (priv->keyidx_num >= KEYIDX_MAX_ENTRIES)
+        return;
+    if (priv->keyidx_num >= priv->keyidx_max) {
+        int max = priv->keyidx_max ? 2 * priv->keyidx_max : 1024;
+        lavf_keyframe_t *idx = realloc(priv->keyidx, max * sizeof(*idx));
+        if (!idx)
+            return;
+        priv->keyidx = idx;
+        priv->keyidx_max = max;
+    }
+    memmove(priv->keyidx + i + 1, priv->keyidx + i,
+            (priv->keyidx_num - i) * sizeof(*priv->keyidx));
+    priv->keyidx_num++;
+    priv->keyidx[i].pts = ts;
+    priv->keyidx[i].pos = pkt->pos;
+    priv->keyidx[i].flags = i > 0 && priv->keyidx_last == i - 1 ?
+                            KEYIDX_CONTIGUOUS : 0;
+    // the following entry now has a new predecessor we know nothing about
+    if (i + 1 < priv->keyidx_num)
+        priv->keyidx[i + 1].flags &= ~KEYIDX_CONTIGUOUS;
+    priv->keyidx_last = i;
+    priv->keyidx_dirty = 1;
+}
+
+/**
+ * \brief look up the byte position to seek to for \p pts
+ * \param backward find the keyframe before instead of after pts
+ * \return index entry or NULL if the index does not cover pts
+ */
+static lavf_keyframe_t *keyidx_lookup(lavf_priv_t *priv, int64_t pts, int backward)
+{
+    int i = keyidx_search(priv, pts);
+
+    if (i < priv->keyidx_num && priv->keyidx[i].pts == pts)
+        return &priv->keyidx[i];
+    // only trust entries if we know there is no unindexed keyframe
+    // between them and the target
+    if (i <= 0 || i >= priv->keyidx_num ||
+        !(priv->keyidx[i].flags & KEYIDX_CONTIGUOUS))
+        return NULL;
+    return &priv->keyidx[backward ? i - 1 : i];
+}
+
+static void keyidx_load(demuxer_t *demuxer)
+{
+    lavf_priv_t *priv = demuxer->priv;
+    stream_t *stream = demuxer->stream;
+    lavf_keyidx_header_t hdr;
+    struct stat st;
+    char name[64];
+    FILE *f;
+
+    if (stream->type != STREAMTYPE_FILE || stream->fd <= 0 ||
+        fstat(stream->fd, &st) || !S_ISREG(st.st_mode))
+        return;
+    // device and inode identify the file even if it is renamed
+    snprintf(name, sizeof(name), "keyindex/%"PRIx64"-%"PRIx64".idx",
+             (uint64_t)st.st_dev, (uint64_t)st.st_ino);
+    priv->keyidx_file = get_path(name);
+    priv->keyidx_file_size = st.st_size;
+    priv->keyidx_file_mtime = st.st_mtime;
+    if (!priv->keyidx_file || !(f = fopen(priv->keyidx_file, "rb")))
+        return;
+
+    if (fread(&hdr, sizeof(hdr), 1, f) == 1 &&
+        hdr.magic == KEYIDX_MAGIC && hdr.version == KEYIDX_VERSION &&
+        hdr.file_size == priv->keyidx_file_size &&
+        hdr.file_mtime == priv->keyidx_file_mtime &&
+        hdr.stream == priv->keyidx_stream &&
+        hdr.entries > 0 && hdr.entries <= KEYIDX_MAX_ENTRIES) {
+        priv->keyidx = malloc(hdr.entries * sizeof(*priv->keyidx));
+        if (priv->keyidx &&
+            fread(priv->keyidx, sizeof(*priv->keyidx), hdr.entries, f) == hdr.entries) {
+            priv->keyidx_num = priv->keyidx_max = hdr.entries;
+            mp_msg(MSGT_DEMUX, MSGL_V, "[lavf] Loaded keyframe index with %d entries from %s\n",
+                   priv->keyidx_num, priv->keyidx_file);
+        } else {
+            free(priv->keyidx);
+            priv->keyidx = NULL;
+        }
+    }
+    fclose(f);
+}
+
+static void keyidx_save(lavf_priv_t *priv)
+{
+    lavf_keyidx_header_t hdr = {
+        .magic      = KEYIDX_MAGIC,
+        .version    = KEYIDX_VERSION,
+        .file_size  = priv->keyidx_file_size,
+        .file_mtime = priv->keyidx_file_mtime,
+        .stream     = priv->keyidx_stream,
+        .entries    = priv->keyidx_num,
+    };
+    char *dir, *tmp;
+    FILE *f;
+    int ok;
+
+    if (!opt_keyindexcache || !priv->keyidx_file || !priv->keyidx_dirty ||
+        !priv->keyidx_num)
+        return;
+    if ((dir = get_path("keyindex"))) {
+        mkdir(dir, 0777);
+        free(dir);
+    }
+    // write to a temporary file so concurrent players never see a partial index
+    tmp = av_asprintf("%s.%d", priv->keyidx_file, (int)getpid());
+    if (!tmp || !(f = fopen(tmp, "wb"))) {
+        av_free(tmp);
+        return;
+    }
+    ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1 &&
+         fwrite(priv->keyidx, sizeof(*priv->keyidx), priv->keyidx_num, f) == priv->keyidx_num;
+    if (fclose(f) || !ok || rename(tmp, priv->keyidx_file)) {
+        mp_msg(MSGT_DEMUX, MSGL_V, "[lavf] Could not write keyframe index %s\n",
+               priv->keyidx_file);
+        unlink(tmp);
+    }
+    av_free(tmp);
+}
+
+static int stream_params_missing(AVStream *st)
+{
+    AVCodecParameters *codec = st->codecpar;
+    switch (codec->codec_type) {
+    case AVMEDIA_TYPE_VIDEO:
+        return codec->codec_id == AV_CODEC_ID_NONE ||
+               codec->width <= 0 || codec->height <= 0;
+    case AVMEDIA_TYPE_AUDIO:
+        return codec->codec_id == AV_CODEC_ID_NONE ||
+               codec->sample_rate <= 0 || codec->ch_layout.nb_channels <= 0;
+    default:
+        return 0;
+    }
+}
+
+static lavf_params_cache_t *params_cache_find(demuxer_t *demuxer)
+{
+    lavf_priv_t *priv = demuxer->priv;
+    const char *url = demuxer->stream->url;
+    int i;
+
+    if (!url)
+        return NULL;
+    for (i = 0; i < PARAMS_CACHE_SIZE; i++)
+        if (params_cache[i].url && params_cache[i].avif == priv->avif &&
+            !strcmp(params_cache[i].url, url))
+            return &params_cache[i];
+    return NULL;
+}
+
+static void params_cache_free(lavf_params_cache_t *c)
+{
+    int i;
+    for (i = 0; i < c->nb_streams; i++)
+        av_free(c->streams[i].extradata);
+    free(c->streams);
+    free(c->url);
+    memset(c, 0, sizeof(*c));
+}
+
+/**
+ * \brief remember the probed stream parameters of the current source
+ */
+static void params_cache_store(demuxer_t *demuxer)
+{
+    lavf_priv_t *priv = demuxer->priv;
+    AVFormatContext *avfc = priv->avfc;
+    lavf_params_cache_t *c;
+    int i;
+
+    if (!demuxer->stream->url || !avfc->nb_streams)
+        return;
+    c = params_cache_find(demuxer);
+    if (!c) {
+        // replace the least recently used entry
+        c = &params_cache[0];
+        for (i = 1; i < PARAMS_CACHE_SIZE; i++)
+            if (!params_cache[i].url ||
+                (c->url && params_cache[i].last_used < c->last_used))
+                c = &params_cache[i];
+    }
+    params_cache_free(c);
+    c->streams = calloc(avfc->nb_streams, sizeof(*c->streams));
+    if (!c->streams)
+        return;
+    c->url = strdup(demuxer->stream->url);
+    c->avif = priv->avif;
+    c->nb_streams = avfc->nb_streams;
+    c->last_used = GetTimerNS();
+    for (i = 0; i < avfc->nb_streams; i++) {
+        AVStream *st = avfc->streams[i];
+        AVCodecParameters *codec = st->codecpar;
+        lavf_stream_params_t *p = &c->streams[i];
+        p->id          = st->id;
+        p->codec_type  = codec->codec_type;
+        p->codec_id    = codec->codec_id;
+        p->width       = codec->width;
+        p->height      = codec->height;
+        p->sample_rate = codec->sample_rate;
+        p->channels    = codec->ch_layout.nb_channels;
+        p->frame_rate  = st->r_frame_rate;
+        if (codec->extradata_size > 0 &&
+            (p->extradata = av_mallocz(codec->extradata_size + AV_INPUT_BUFFER_PADDING_SIZE))) {
+            memcpy(p->extradata, codec->extradata, codec->extradata_size);
+            p->extradata_size = codec->extradata_size;
+        }
+    }
+}
+
+/**
+ * \brief fill in stream parameters the container header did not provide
+ *        from an earlier open of the same source
+ */
+static void params_cache_apply(demuxer_t *demuxer, lavf_params_cache_t *c)
+{
+    AVFormatContext *avfc = ((lavf_priv_t *)demuxer->priv)->avfc;
+    int i, j;
+
+    c->last_used = GetTimerNS();
+    for (i = 0; i < avfc->nb_streams; i++) {
+        AVStream *st = avfc->streams[i];
+        AVCodecParameters *codec = st->codecpar;
+        lavf_stream_params_t *p = NULL;
+
+        for (j = 0; j < c->nb_streams; j++)
+            if (c->streams[j].id == st->id &&
+                c->streams[j].codec_type == codec->codec_type) {
+                p = &c->streams[j];
+                break;
+            }
+        if (!p || (codec->codec_id != AV_CODEC_ID_NONE && codec->codec_id != p->codec_id))
+            continue;
+        codec->codec_id = p->codec_id;
+        if (codec->width <= 0 || codec->height <= 0) {
+            codec->width  = p->width;
+            codec->height = p->height;
+        }
+        if (codec->sample_rate <= 0)
+            codec->sample_rate = p->sample_rate;
+        if (codec->ch_layout.nb_channels <= 0 && p->channels > 0) {
+            av_channel_layout_uninit(&codec->ch_layout);
+            av_channel_layout_default(&codec->ch_layout, p->channels);
+        }
+        if (!st->r_frame_rate.num)
+            st->r_frame_rate = p->frame_rate;
+        if (!codec->extradata_size && p->extradata_size &&
+            (codec->extradata = av_mallocz(p->extradata_size + AV_INPUT_BUFFER_PADDING_SIZE))) {
+            memcpy(codec->extradata, p->extradata, p->extradata_size);
+            codec->extradata_size = p->extradata_size;
+        }
+    }
+}
+
+/**
+ * \brief check whether playback can start without avformat_find_stream_info
+ */
+static int faststart_init(demuxer_t *demuxer)
+{
+    lavf_priv_t *priv = demuxer->priv;
+    AVFormatContext *avfc = priv->avfc;
+    lavf_params_cache_t *c;
+    int i, usable = 0, missing = 0;
+
+    if ((c = params_cache_find(demuxer)))
+        params_cache_apply(demuxer, c);
+    for (i = 0; i < avfc->nb_streams; i++) {
+        AVStream *st = avfc->streams[i];
+        enum AVMediaType type = st->codecpar->codec_type;
+        if (type != AVMEDIA_TYPE_VIDEO && type != AVMEDIA_TYPE_AUDIO)
+            continue;
+        if (stream_params_missing(st))
+            missing++;
+        else
+            usable++;
+        // most headers only carry the average rate, which is good enough
+        if (type == AVMEDIA_TYPE_VIDEO && !st->r_frame_rate.num)
+            st->r_frame_rate = st->avg_frame_rate;
+    }
+    mp_msg(MSGT_HEADER, MSGL_V, "LAVF: fast start: %d streams usable, %d incomplete%s\n",
+           usable, missing, c ? " (cached parameters)" : "");
+    return usable && !missing;
+}
+
+/**
+ * \brief hand codec data that arrived in the packets over to the stream
+ *        header
+ *
+ * Decoders only read it when they are opened, so it is dropped for
+ * streams whose decoder is already running, see
+ * DEMUXER_CTRL_LOAD_CODECDATA.
+ */
+static void faststart_publish(demuxer_t *demuxer, AVStream *st)
+{
+    AVCodecParameters *codec = st->codecpar;
+    unsigned char **codecdata = NULL;
+    int *codecdata_len = NULL;
+    int initialized = 0;
+
+    if (codec->codec_type == AVMEDIA_TYPE_VIDEO && demuxer->v_streams[st->index]) {
+        sh_video_t *sh = demuxer->v_streams[st->index];
+        codecdata     = &sh->codecdata;
+        codecdata_len = &sh->codecdata_len;
+        initialized   = sh->initialized;
+    } else if (codec->codec_type == AVMEDIA_TYPE_AUDIO && demuxer->a_streams[st->index]) {
+        sh_audio_t *sh = demuxer->a_streams[st->index];
+        codecdata     = &sh->codecdata;
+        codecdata_len = &sh->codecdata_len;
+        initialized   = sh->initialized;
+    }
+    if (!codecdata || *codecdata_len)
+        return;
+    if (initialized) {
+        mp_msg(MSGT_HEADER, MSGL_V, "LAVF: stream %d: codec data arrived after the decoder was opened\n",
+               st->index);
+        return;
+    }
+    *codecdata     = codec->extradata;
+    *codecdata_len = codec->extradata_size;
+}
+
+/**
+ * \brief fill in codec parameters fast start did not get from the header
+ *        as they show up in the packets
+ *
+ * Decoders pick up picture size and audio format from the bitstream, so
+ * only out-of-band codec data needs to be taken care of here.
+ */
+static void faststart_update(demuxer_t *demuxer, AVStream *st, AVPacket *pkt)
+{
+    lavf_priv_t *priv = demuxer->priv;
+    AVCodecParameters *codec = st->codecpar;
+    uint8_t *data;
+    size_t size;
+
+    if (codec->extradata_size)
+        return;
+    data = av_packet_get_side_data(pkt, AV_PKT_DATA_NEW_EXTRADATA, &size);
+    if (!data || !size ||
+        !(codec->extradata = av_mallocz(size + AV_INPUT_BUFFER_PADDING_SIZE)))
+        return;
+    memcpy(codec->extradata, data, size);
+    codec->extradata_size = size;
+    if (!priv->hold_codecdata)
+        faststart_publish(demuxer, st);
+}
+
 static demuxer_t* demux_open_lavf(demuxer_t *demuxer){
     AVDictionary *opts = NULL;
     AVFormatContext *avfc;
@@ -544,6 +1033,7 @@ static demuxer_t* demux_open_lavf(demuxer_t *demuxer){
     lavf_priv_t *priv= demuxer->priv;
     int i;
     char mp_filename[2048]="mp:";
+    unsigned int t0;
 
     stream_seek(demuxer->stream, 0);
 
@@ -582,10 +1072,12 @@ static demuxer_t* demux_open_lavf(demuxer_t *demuxer){
         avfc->pb = priv->pb;
     }
 
+    t0 = GetTimer();
     if(avformat_open_input(&avfc, mp_filename, priv->avif, &opts)<0){
         mp_msg(MSGT_HEADER,MSGL_ERR,"LAVF_header: av_open_input_stream() failed\n");
         return NULL;
     }
+    demuxer->startup_time[DEMUX_STARTUP_HEADER] = GetTimer() - t0;
     if (av_dict_count(opts)) {
         AVDictionaryEntry *e = NULL;
         int invalid = 0;
@@ -600,14 +1092,20 @@ static demuxer_t* demux_open_lavf(demuxer_t *demuxer){
     }
     av_dict_free(&opts);
 
-    bsf_handle = NULL;
-    first_frame = 1;
+    priv->bsf_handle = NULL;
+    priv->first_frame = 1;
 
     priv->avfc= avfc;
 
-    if(avformat_find_stream_info(avfc, NULL) < 0){
+    t0 = GetTimer();
+    if (opt_faststart && faststart_init(demuxer)) {
+        mp_msg(MSGT_HEADER,MSGL_V,"LAVF: fast start, skipping stream info probing\n");
+        priv->faststart = 1;
+    } else if(avformat_find_stream_info(avfc, NULL) < 0){
         mp_msg(MSGT_HEADER,MSGL_ERR,"LAVF_header: av_find_stream_info() failed\n");
-    }
+    } else if (opt_faststart)
+        params_cache_store(demuxer);
+    demuxer->startup_time[DEMUX_STARTUP_STREAM_INFO] = GetTimer() - t0;
 
     /* Add metadata. */
     while((t = av_dict_get(avfc->metadata, "", t, AV_DICT_IGNORE_SUFFIX)))
@@ -625,6 +1123,16 @@ static demuxer_t* demux_open_lavf(demuxer_t *demuxer){
         handle_stream(demuxer, avfc, i);
     priv->nb_streams_last = avfc->nb_streams;
 
+    priv->keyidx_stream = -1;
+    priv->keyidx_last = -1;
+    if (opt_keyindex && priv->pb && priv->pb->seekable &&
+        !(priv->avif->flags & AVFMT_NO_BYTE_SEEK)) {
+        priv->keyidx_stream = demuxer->video->id >= 0 ? demuxer->video->id :
+                              demuxer->audio->id;
+        if (priv->keyidx_stream >= 0 && opt_keyindexcache)
+            keyidx_load(demuxer);
+    }
+
     if(avfc->nb_programs) {
         int p;
         for (p = 0; p < avfc->nb_programs; p++) {
@@ -648,6 +1156,7 @@ static demuxer_t* demux_open_lavf(demuxer_t *demuxer){
         demuxer->video->id=-2; // audio-only
     } //else if (best_video > 0 && demuxer->video->id == -1) demuxer->video->id = best_video;
 
+    priv->open_done = GetTimer();
     return demuxer;
 }
 
@@ -661,7 +1170,7 @@ static int demux_lavf_fill_buffer(demuxer_t *demux, demux_stream_t *dsds){
     AVCodecParameters *codec;
     unsigned int *ptr;
     double stream_pts = MP_NOPTS_VALUE;
-    mp_msg(MSGT_DEMUX,MSGL_DBG2,"demux_lavf_fill_buffer()\n");
+    mp_trace(MSGT_DEMUX,MSGL_DBG2,"demux_lavf_fill_buffer()\n");
 
     demux->filepos=stream_tell(demux->stream);
 
@@ -677,6 +1186,15 @@ static int demux_lavf_fill_buffer(demuxer_t *demux, demux_stream_t *dsds){
     st= priv->avfc->streams[id];
     codec= st->codecpar;
 
+    if (!priv->got_packet) {
+        priv->got_packet = 1;
+        demux->startup_time[DEMUX_STARTUP_FIRST_PACKET] = GetTimer() - priv->open_done;
+    }
+    if (priv->faststart)
+        faststart_update(demux, st, &pkt);
+    if (id == priv->keyidx_stream && (pkt.flags & AV_PKT_FLAG_KEY))
+        keyidx_add(priv, st, &pkt);
+
     if(id==demux->audio->id){
         // audio
         ds=demux->audio;
@@ -693,12 +1211,12 @@ static int demux_lavf_fill_buffer(demuxer_t *demux, demux_stream_t *dsds){
             mp_msg(MSGT_DEMUX,MSGL_V,"Auto-selected LAVF video ID = %d\n",ds->id);
         }
         sh = ds->sh;
-        if (bsf_handle) {
-            if (av_bsf_send_packet(bsf_handle, &pkt) < 0) {
+        if (priv->bsf_handle) {
+            if (av_bsf_send_packet(priv->bsf_handle, &pkt) < 0) {
                 av_packet_unref(&pkt);
                 return 0;
             }
-            if (av_bsf_receive_packet(bsf_handle, &pkt) < 0) {
+            if (av_bsf_receive_packet(priv->bsf_handle, &pkt) < 0) {
                 av_packet_unref(&pkt);
                 return 0;
             }
@@ -717,7 +1235,7 @@ static int demux_lavf_fill_buffer(demuxer_t *demux, demux_stream_t *dsds){
             codec->codec_id == AV_CODEC_ID_WMV3 &&
             codec->extradata &&
             codec->extradata_size > 0 &&
-            first_frame) {
+            priv->first_frame) {
         dp=new_demux_packet(pkt.size + 36);
         ptr = dp->buffer;
         ptr[0] = 0xc5ffffff;
@@ -730,7 +1248,7 @@ static int demux_lavf_fill_buffer(demuxer_t *demux, demux_stream_t *dsds){
         ptr[7] = 0;
         ptr[8] = 0;
         memcpy(dp->buffer + 36, pkt.data, pkt.size);
-        first_frame = 0;
+        priv->first_frame = 0;
     } else {
         dp=new_demux_packet(pkt.size);
         memcpy(dp->buffer, pkt.data, pkt.size);
@@ -765,7 +1283,7 @@ static void demux_seek_lavf(demuxer_t *demuxer, float rel_seek_secs, float audio
     // This is important also for SEEK_ABSOLUTE because seeking
     // is done by dts, while start_time is relative to pts and thus
     // usually too large.
-    if (rel_seek_secs <= 0) avsflags = AVSEEK_FLAG_BACKWARD;
+    if (rel_seek_secs <= 0 || (flags & SEEK_HR)) avsflags = AVSEEK_FLAG_BACKWARD;
     if (flags & SEEK_FACTOR) {
       if (priv->avfc->duration == 0 || priv->avfc->duration == AV_NOPTS_VALUE)
         return;
@@ -773,6 +1291,21 @@ static void demux_seek_lavf(demuxer_t *demuxer, float rel_seek_secs, float audio
     } else {
       priv->last_pts += rel_seek_secs * AV_TIME_BASE;
     }
+    priv->keyidx_last = -1;
+    if (priv->keyidx_stream >= 0 &&
+        (priv->keyidx_stream == demuxer->video->id ||
+         priv->keyidx_stream == demuxer->audio->id)) {
+        lavf_keyframe_t *kf = keyidx_lookup(priv, priv->last_pts,
+                                            avsflags & AVSEEK_FLAG_BACKWARD);
+        // position the stream directly instead of letting lavf search
+        if (kf && av_seek_frame(priv->avfc, -1, kf->pos, AVSEEK_FLAG_BYTE) >= 0) {
+            mp_msg(MSGT_DEMUX, MSGL_DBG2, "demux_seek_lavf: keyframe index hit pts %"PRId64" pos %"PRId64"\n",
+                   kf->pts, kf->pos);
+            priv->last_pts = kf->pts;
+            priv->keyidx_last = kf - priv->keyidx;
+            return;
+        }
+    }
     if (av_seek_frame(priv->avfc, -1, priv->last_pts, avsflags) < 0) {
         avsflags ^= AVSEEK_FLAG_BACKWARD;
         av_seek_frame(priv->avfc, -1, priv->last_pts, avsflags);
@@ -799,6 +1332,12 @@ static int demux_lavf_control(demuxer_t *demuxer, int cmd, void *arg)
 
 	    *((int *)arg) = (int)((priv->last_pts - priv->avfc->start_time)*100 / priv->avfc->duration);
 	    return DEMUXER_CTRL_OK;
+	case DEMUXER_CTRL_GET_START_TIME:
+	    if (priv->avfc->start_time == AV_NOPTS_VALUE)
+	        return DEMUXER_CTRL_DONTKNOW;
+
+	    *((double *)arg) = (double)priv->avfc->start_time / AV_TIME_BASE;
+	    return DEMUXER_CTRL_OK;
 	case DEMUXER_CTRL_REMAP_AUDIO_ID:
 	case DEMUXER_CTRL_REMAP_SUB_ID:
 	{
@@ -938,6 +1477,26 @@ redo:
                 return DEMUXER_CTRL_DONTKNOW;
             *((int *)arg) = priv->r_gain;
             return DEMUXER_CTRL_OK;
+        case DEMUXER_CTRL_LOAD_CODECDATA:
+            // faststart_update() picks the codec data out of the packets
+            if (priv->faststart && !priv->hold_codecdata) {
+                sh_video_t *sh_video = demuxer->video->sh;
+                sh_audio_t *sh_audio = demuxer->audio->sh;
+                if (sh_video && !sh_video->codecdata_len)
+                    ds_fill_buffer(demuxer->video);
+                if (sh_audio && !sh_audio->codecdata_len)
+                    ds_fill_buffer(demuxer->audio);
+            }
+            return DEMUXER_CTRL_OK;
+        case DEMUXER_CTRL_HOLD_CODECDATA: {
+            int i;
+            priv->hold_codecdata = *((int *)arg);
+            if (!priv->hold_codecdata && priv->faststart)
+                for (i = 0; i < priv->avfc->nb_streams; i++)
+                    if (priv->avfc->streams[i]->codecpar->extradata_size)
+                        faststart_publish(demuxer, priv->avfc->streams[i]);
+            return DEMUXER_CTRL_OK;
+        }
 	default:
 	    return DEMUXER_CTRL_NOTIMPL;
     }
@@ -947,6 +1506,9 @@ static void demux_close_lavf(demuxer_t *demuxer)
 {
     lavf_priv_t* priv = demuxer->priv;
     if (priv){
+        keyidx_save(priv);
+        free(priv->keyidx);
+        free(priv->keyidx_file);
         if(priv->avfc)
         {
          av_freep(&priv->avfc->key);
@@ -954,13 +1516,9 @@ static void demux_close_lavf(demuxer_t *demuxer)
         }
         if (priv->pb) av_freep(&priv->pb->buffer);
         av_freep(&priv->pb);
+        av_bsf_free(&priv->bsf_handle);
         free(priv); demuxer->priv= NULL;
     }
-
-    if (bsf_handle) {
-        av_bsf_free(&bsf_handle);
-        bsf_handle = NULL;
-    }
 }
 
 
@@ -119,6 +119,13 @@ static const demuxer_desc_t *get_demuxer_desc_from_type(int file_format)
 demuxer_t *alloc_demuxer(stream_t *stream, int type, const char *filename)
 {
     demuxer_t *d = calloc(1, sizeof(*d));
+    pthread_mutexattr_t attr;
+
+    // recursive: demuxers call back into ds_fill_buffer() and friends
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&d->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
     d->stream = stream;
     d->stream_pts = MP_NOPTS_VALUE;
     d->reference_clock = MP_NOPTS_VALUE;
@@ -322,6 +329,7 @@ void free_demuxer(demuxer_t *demuxer)
         }
         free(demuxer->attachments);
     }
+    pthread_mutex_destroy(&demuxer->lock);
     free(demuxer);
 }
 
@@ -509,15 +517,16 @@ void ds_read_packet(demux_stream_t *ds, stream_t *stream, int len,
 
 int demux_fill_buffer(demuxer_t *demux, demux_stream_t *ds)
 {
+    int ret;
     // Note: parameter 'ds' can be NULL!
-    return demux->desc->fill_buffer(demux, ds);
+    pthread_mutex_lock(&demux->lock);
+    ret = demux->desc->fill_buffer(demux, ds);
+    pthread_mutex_unlock(&demux->lock);
+    return ret;
 }
 
-// return value:
-//     0 = EOF
-//     1 = successful
 #define MAX_ACCUMULATED_PACKETS 64
-int ds_fill_buffer(demux_stream_t *ds)
+static int fill_buffer_locked(demux_stream_t *ds)
 {
     demuxer_t *demux = ds->demuxer;
     if (ds->current)
@@ -637,6 +646,20 @@ int ds_fill_buffer(demux_stream_t *ds)
     return 0;
 }
 
+// return value:
+//     0 = EOF
+//     1 = successful
+int ds_fill_buffer(demux_stream_t *ds)
+{
+    demuxer_t *demux = ds->demuxer;
+    int ret;
+
+    pthread_mutex_lock(&demux->lock);
+    ret = fill_buffer_locked(ds);
+    pthread_mutex_unlock(&demux->lock);
+    return ret;
+}
+
 int demux_read_data(demux_stream_t *ds, unsigned char *mem, int len)
 {
     int x;
@@ -1195,8 +1218,8 @@ void demux_flush(demuxer_t *demuxer)
     ds_free_packs(demuxer->sub);
 }
 
-int demux_seek(demuxer_t *demuxer, float rel_seek_secs, float audio_delay,
-               int flags)
+static int seek_locked(demuxer_t *demuxer, float rel_seek_secs, float audio_delay,
+                       int flags)
 {
     double tmp = 0;
     double pts;
@@ -1247,6 +1270,17 @@ int demux_seek(demuxer_t *demuxer, float rel_seek_secs, float audio_delay,
     return 1;
 }
 
+int demux_seek(demuxer_t *demuxer, float rel_seek_secs, float audio_delay,
+               int flags)
+{
+    int ret;
+
+    pthread_mutex_lock(&demuxer->lock);
+    ret = seek_locked(demuxer, rel_seek_secs, audio_delay, flags);
+    pthread_mutex_unlock(&demuxer->lock);
+    return ret;
+}
+
 int demux_info_add(demuxer_t *demuxer, const char *opt, const char *param)
 {
     char **info = demuxer->info;
@@ -1312,11 +1346,13 @@ char *demux_info_get(demuxer_t *demuxer, const char *opt)
 
 int demux_control(demuxer_t *demuxer, int cmd, void *arg)
 {
+    int ret = DEMUXER_CTRL_NOTIMPL;
 
+    pthread_mutex_lock(&demuxer->lock);
     if (demuxer->desc->control)
-        return demuxer->desc->control(demuxer, cmd, arg);
-
-    return DEMUXER_CTRL_NOTIMPL;
+        ret = demuxer->desc->control(demuxer, cmd, arg);
+    pthread_mutex_unlock(&demuxer->lock);
+    return ret;
 }
 
 
@@ -20,6 +20,7 @@
 #define MPLAYER_DEMUXER_H
 
 #include <sys/types.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
@@ -108,9 +109,18 @@
 // Query stream IDs that the underlying device/stream would recognize
 #define DEMUXER_CTRL_REMAP_AUDIO_ID 18
 #define DEMUXER_CTRL_REMAP_SUB_ID 19
+#define DEMUXER_CTRL_GET_START_TIME 20
+// arg: int *, while nonzero codec data found in packets is not stored in
+// the stream headers, codecs are being opened from another thread
+#define DEMUXER_CTRL_HOLD_CODECDATA 21
+// read ahead to the first packets of the selected streams, so that codec
+// data carried in them is in the stream headers before the codecs open
+#define DEMUXER_CTRL_LOAD_CODECDATA 22
 
 #define SEEK_ABSOLUTE (1 << 0)
 #define SEEK_FACTOR   (1 << 1)
+// a precise seek follows, land on a keyframe before the target
+#define SEEK_HR       (1 << 2)
 
 #define MP_INPUT_BUFFER_PADDING_SIZE 64
 
@@ -234,6 +244,15 @@ typedef struct demux_attachment
   unsigned int data_size;
 } demux_attachment_t;
 
+/// demuxer startup phases, see demuxer_t.startup_time
+enum demux_startup_phase {
+  DEMUX_STARTUP_PROBE,        ///< file format detection
+  DEMUX_STARTUP_HEADER,       ///< reading the container header
+  DEMUX_STARTUP_STREAM_INFO,  ///< probing packets for codec parameters
+  DEMUX_STARTUP_FIRST_PACKET, ///< from the end of open to the first packet
+  DEMUX_STARTUP_PHASES
+};
+
 typedef struct demuxer {
   const demuxer_desc_t *desc;  ///< Demuxer description structure
   off_t filepos; // input stream current pos.
@@ -270,6 +289,12 @@ typedef struct demuxer {
 
   void* priv;  // fileformat-dependent data
   char** info;
+
+  unsigned int startup_time[DEMUX_STARTUP_PHASES]; ///< usecs, 0 if not measured
+
+  /// Serialises reading, seeking and controls, the audio codec may be
+  /// opened on a worker thread while the main thread uses the demuxer.
+  pthread_mutex_t lock;
 } demuxer_t;
 
 typedef struct {
@@ -111,6 +111,7 @@ typedef struct sh_video {
   // output driver/filters: (set by libmpcodecs core)
   unsigned int outfmtidx;
   struct vf_instance *vfilter;          // the video filter chain, used for this video stream
+  struct mp_image *last_image;          // returned by decode_video(), held until the next call
   int level;
   int vf_initialized;
   // codec-specific:
@@ -0,0 +1,531 @@
+/*
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+
+#include "config.h"
+#include "mp_msg.h"
+#include "drm_present.h"
+
+#ifdef TESTING
+#include <inttypes.h>
+#include <stdio.h>
+#define mp_msg(t, l, ...) fprintf(stderr, __VA_ARGS__)
+#endif
+
+// give up on a flip event after this long and carry on as if it came
+#define FLIP_TIMEOUT_MS 1000
+
+int64_t drm_present_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void drm_present_flipped(drm_present_t *p, unsigned int sequence, int64_t time)
+{
+    int64_t latency;
+
+    if (!p->in_flight)
+        return;
+    if (p->shown && p->shown != p->pending && p->release)
+        p->release(p->shown);
+    p->shown     = p->pending;
+    p->target    = p->pending_target;
+    p->pending   = NULL;
+    p->in_flight = 0;
+
+    latency = time - p->submit_time;
+    if (latency < 0)
+        latency = 0;
+    p->latency   = p->flips ? (7 * p->latency + latency) / 8 : latency;
+    p->flip_time = time;
+    p->sequence  = sequence;
+    p->flips++;
+}
+
+/* events from the kernel, shared by both backends */
+
+static void page_flip_handler(int fd, unsigned int sequence,
+                              unsigned int tv_sec, unsigned int tv_usec,
+                              void *data)
+{
+    drm_present_flipped(data, sequence, (int64_t)tv_sec * 1000000 + tv_usec);
+}
+
+static int kms_wait(drm_present_t *p, int timeout_ms)
+{
+    drmEventContext ev = {
+        .version           = 2,
+        .page_flip_handler = page_flip_handler,
+    };
+    struct pollfd pfd = { .fd = p->fd, .events = POLLIN };
+    int ret = poll(&pfd, 1, timeout_ms);
+
+    if (ret < 0)
+        return errno == EINTR ? 0 : -1;
+    if (ret == 0)
+        return 0;
+    return drmHandleEvent(p->fd, &ev) < 0 ? -1 : 1;
+}
+
+/* atomic modesetting */
+
+enum {
+    PROP_FB_ID, PROP_CRTC_ID,
+    PROP_SRC_X, PROP_SRC_Y, PROP_SRC_W, PROP_SRC_H,
+    PROP_CRTC_X, PROP_CRTC_Y, PROP_CRTC_W, PROP_CRTC_H,
+    PROP_COUNT
+};
+
+static const char * const plane_prop_names[PROP_COUNT] = {
+    "FB_ID", "CRTC_ID",
+    "SRC_X", "SRC_Y", "SRC_W", "SRC_H",
+    "CRTC_X", "CRTC_Y", "CRTC_W", "CRTC_H",
+};
+
+#define MAX_CACHED_PLANES 4
+
+typedef struct {
+    struct {
+        uint32_t plane_id;
+        uint32_t props[PROP_COUNT];
+    } planes[MAX_CACHED_PLANES];
+    int num_planes;
+} atomic_priv_t;
+
+static const uint32_t *plane_props(drm_present_t *p, uint32_t plane_id)
+{
+    atomic_priv_t *priv = p->backend_priv;
+    drmModeObjectPropertiesPtr props;
+    uint32_t *ids;
+    int i, j;
+
+    for (i = 0; i < priv->num_planes; i++)
+        if (priv->planes[i].plane_id == plane_id)
+            return priv->planes[i].props;
+    if (priv->num_planes == MAX_CACHED_PLANES)
+        return NULL;
+
+    props = drmModeObjectGetProperties(p->fd, plane_id, DRM_MODE_OBJECT_PLANE);
+    if (!props)
+        return NULL;
+    ids = priv->planes[priv->num_planes].props;
+    memset(ids, 0, sizeof(priv->planes[0].props));
+    for (i = 0; i < props->count_props; i++) {
+        drmModePropertyPtr prop = drmModeGetProperty(p->fd, props->props[i]);
+        if (!prop)
+            continue;
+        for (j = 0; j < PROP_COUNT; j++)
+            if (!strcmp(prop->name, plane_prop_names[j]))
+                ids[j] = prop->prop_id;
+        drmModeFreeProperty(prop);
+    }
+    drmModeFreeObjectProperties(props);
+
+    for (j = 0; j < PROP_COUNT; j++)
+        if (!ids[j]) {
+            mp_msg(MSGT_VO, MSGL_ERR, "[drm] Plane %u has no %s property.\n",
+                   plane_id, plane_prop_names[j]);
+            return NULL;
+        }
+    priv->planes[priv->num_planes].plane_id = plane_id;
+    priv->num_planes++;
+    return ids;
+}
+
+static int atomic_init(drm_present_t *p)
+{
+    if (drmSetClientCap(p->fd, DRM_CLIENT_CAP_ATOMIC, 1))
+        return -1;
+    p->backend_priv = calloc(1, sizeof(atomic_priv_t));
+    return p->backend_priv ? 0 : -1;
+}
+
+static int atomic_commit(drm_present_t *p, const drm_present_plane_t *planes,
+                         int num_planes)
+{
+    drmModeAtomicReqPtr req = drmModeAtomicAlloc();
+    int i, ret;
+
+    if (!req)
+        return -1;
+    for (i = 0; i < num_planes; i++) {
+        const drm_present_plane_t *pl = &planes[i];
+        const uint32_t *id = plane_props(p, pl->plane_id);
+        if (!id) {
+            drmModeAtomicFree(req);
+            return -1;
+        }
+        drmModeAtomicAddProperty(req, pl->plane_id, id[PROP_FB_ID],   pl->fb_id);
+        drmModeAtomicAddProperty(req, pl->plane_id, id[PROP_CRTC_ID], pl->crtc_id);
+        drmModeAtomicAddProperty(req, pl->plane_id, id[PROP_SRC_X],   pl->src_x);
+        drmModeAtomicAddProperty(req, pl->plane_id, id[PROP_SRC_Y],   pl->src_y);
+        drmModeAtomicAddProperty(req, pl->plane_id, id[PROP_SRC_W],   pl->src_w);
+        drmModeAtomicAddProperty(req, pl->plane_id, id[PROP_SRC_H],   pl->src_h);
+        drmModeAtomicAddProperty(req, pl->plane_id, id[PROP_CRTC_X],  pl->crtc_x);
+        drmModeAtomicAddProperty(req, pl->plane_id, id[PROP_CRTC_Y],  pl->crtc_y);
+        drmModeAtomicAddProperty(req, pl->plane_id, id[PROP_CRTC_W],  pl->crtc_w);
+        drmModeAtomicAddProperty(req, pl->plane_id, id[PROP_CRTC_H],  pl->crtc_h);
+    }
+    ret = drmModeAtomicCommit(p->fd, req,
+                              DRM_MODE_ATOMIC_NONBLOCK | DRM_MODE_PAGE_FLIP_EVENT, p);
+    drmModeAtomicFree(req);
+    if (ret) {
+        mp_msg(MSGT_VO, MSGL_ERR, "[drm] Atomic commit failed: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+static void atomic_uninit(drm_present_t *p)
+{
+    free(p->backend_priv);
+    p->backend_priv = NULL;
+}
+
+const drm_present_backend_t drm_present_atomic = {
+    "atomic",
+    atomic_init,
+    atomic_commit,
+    kms_wait,
+    atomic_uninit,
+};
+
+/* legacy SetPlane, blocks in the kernel and completes immediately */
+
+static int legacy_commit(drm_present_t *p, const drm_present_plane_t *planes,
+                         int num_planes)
+{
+    int i;
+
+    for (i = 0; i < num_planes; i++) {
+        const drm_present_plane_t *pl = &planes[i];
+        if (drmModeSetPlane(p->fd, pl->plane_id, pl->crtc_id, pl->fb_id, 0,
+                            pl->crtc_x, pl->crtc_y, pl->crtc_w, pl->crtc_h,
+                            pl->src_x, pl->src_y, pl->src_w, pl->src_h)) {
+            mp_msg(MSGT_VO, MSGL_ERR, "[drm] Failed set plane: %s\n", strerror(errno));
+            return -1;
+        }
+    }
+    drm_present_flipped(p, p->sequence + 1, drm_present_now());
+    return 0;
+}
+
+const drm_present_backend_t drm_present_legacy = {
+    "legacy",
+    NULL,
+    legacy_commit,
+    kms_wait,
+    NULL,
+};
+
+/* no display at all, flips complete on the vblanks of a steady 60 Hz
+ * clock, for running the queue without KMS. A frame with a target is
+ * held back to the vblank closest to it, never earlier than the first
+ * vblank after the commit. */
+
+#define FAKE_REFRESH_US 16667
+
+static int64_t fake_vblank(const drm_present_t *p)
+{
+    int64_t vblank = (p->submit_time / FAKE_REFRESH_US + 1) * FAKE_REFRESH_US;
+    int64_t target = (p->pending_target + FAKE_REFRESH_US / 2) /
+                     FAKE_REFRESH_US * FAKE_REFRESH_US;
+
+    return target > vblank ? target : vblank;
+}
+
+static int fake_commit(drm_present_t *p, const drm_present_plane_t *planes,
+                       int num_planes)
+{
+    return 0;
+}
+
+static int fake_wait(drm_present_t *p, int timeout_ms)
+{
+    int64_t vblank = fake_vblank(p);
+    int64_t left   = vblank - drm_present_now();
+
+    if (left > (int64_t)timeout_ms * 1000) {
+        usleep(timeout_ms * 1000);
+        return 0;
+    }
+    if (left > 0)
+        usleep(left);
+    drm_present_flipped(p, vblank / FAKE_REFRESH_US, vblank);
+    return 1;
+}
+
+const drm_present_backend_t drm_present_fake = {
+    "fake",
+    NULL,
+    fake_commit,
+    fake_wait,
+    NULL,
+};
+
+// tried in this order by drm_present_init()
+static const drm_present_backend_t * const backends[] = {
+    &drm_present_atomic,
+    &drm_present_legacy,
+    NULL
+};
+
+int drm_present_init_backend(drm_present_t *p, const drm_present_backend_t *backend,
+                             int fd, void (*release)(void *frame))
+{
+    memset(p, 0, sizeof(*p));
+    p->fd      = fd;
+    p->release = release;
+    p->backend = backend;
+    if (backend->init && backend->init(p) < 0) {
+        p->backend = NULL;
+        return -1;
+    }
+    mp_msg(MSGT_VO, MSGL_V, "[drm] Using %s page flips.\n", backend->name);
+    return 0;
+}
+
+int drm_present_init(drm_present_t *p, int fd, void (*release)(void *frame))
+{
+    int i;
+
+    for (i = 0; backends[i]; i++)
+        if (drm_present_init_backend(p, backends[i], fd, release) == 0)
+            return 0;
+    return -1;
+}
+
+void drm_present_uninit(drm_present_t *p)
+{
+    if (!p->backend)
+        return;
+    drm_present_wait(p);
+    if (p->shown && p->release)
+        p->release(p->shown);
+    p->shown = NULL;
+    if (p->backend->uninit)
+        p->backend->uninit(p);
+    p->backend = NULL;
+}
+
+int drm_present_wait(drm_present_t *p)
+{
+    int64_t deadline = drm_present_now() + FLIP_TIMEOUT_MS * 1000;
+
+    while (p->in_flight) {
+        int64_t left = deadline - drm_present_now();
+        if (left <= 0 || p->backend->wait(p, left / 1000 + 1) < 0) {
+            mp_msg(MSGT_VO, MSGL_WARN, "[drm] Lost page flip event.\n");
+            drm_present_flipped(p, p->sequence, drm_present_now());
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void drm_present_poll(drm_present_t *p)
+{
+    if (p->backend && p->in_flight)
+        p->backend->wait(p, 0);
+}
+
+int drm_present_submit(drm_present_t *p, const drm_present_plane_t *planes,
+                       int num_planes, void *frame, int64_t target)
+{
+    if (!p->backend || num_planes > DRM_PRESENT_MAX_PLANES)
+        return -1;
+    drm_present_wait(p);
+
+    p->pending        = frame;
+    p->pending_target = target;
+    p->in_flight      = 1;
+    p->submit_time = drm_present_now();
+    if (p->backend->commit(p, planes, num_planes) < 0) {
+        p->pending   = NULL;
+        p->in_flight = 0;
+        return -1;
+    }
+    p->submitted++;
+    return 0;
+}
+
+#ifdef TESTING
+/* Queue test on the fake backend:
+ *   make libvo/drm_present-test && libvo/drm_present-test */
+
+#define TEST_FRAMES 120
+
+static int released[TEST_FRAMES + 1];
+static int num_released;
+
+static void test_release(void *frame)
+{
+    released[num_released++] = (intptr_t)frame;
+}
+
+static int check_releases(const char *name, int frames)
+{
+    int i;
+
+    if (num_released != frames) {
+        printf("%s: %d of %d frames released\n", name, num_released, frames);
+        return 1;
+    }
+    for (i = 0; i < frames; i++)
+        if (released[i] != i + 1) {
+            printf("%s: frame %d released as #%d\n", name, released[i], i + 1);
+            return 1;
+        }
+    return 0;
+}
+
+/// frames without targets, the producer running at \p frame_us
+static int test_asap(int frame_us)
+{
+    drm_present_plane_t plane = { 0 };
+    drm_present_t p;
+    char name[32];
+    int i;
+
+    snprintf(name, sizeof(name), "asap %dus", frame_us);
+    num_released = 0;
+    if (drm_present_init_backend(&p, &drm_present_fake, -1, test_release) < 0)
+        return 1;
+    for (i = 1; i <= TEST_FRAMES; i++) {
+        if (drm_present_submit(&p, &plane, 1, (void *)(intptr_t)i, 0) < 0) {
+            printf("%s: submit failed\n", name);
+            return 1;
+        }
+        // one deep queue, the flip comes on the first vblank after the commit
+        if (p.flips && (p.flip_time % FAKE_REFRESH_US ||
+                        p.flip_time - p.submit_time > 2 * FAKE_REFRESH_US)) {
+            printf("%s: flip at %"PRId64" off the vblank grid\n", name, p.flip_time);
+            return 1;
+        }
+        if (frame_us) {
+            usleep(frame_us);
+            drm_present_poll(&p);
+        }
+    }
+    drm_present_uninit(&p);
+    return check_releases(name, TEST_FRAMES);
+}
+
+/**
+ * Frames with display times \p frame_us apart, handed over one refresh
+ * early like the player does. Each must flip on the vblank closest to
+ * its target, or on the first one after its commit if that came too
+ * late, and report its target back.
+ */
+static int test_target(int frame_us)
+{
+    drm_present_plane_t plane = { 0 };
+    int64_t targets[TEST_FRAMES + 1], submits[TEST_FRAMES + 1];
+    int64_t start, now, vblank;
+    drm_present_t p;
+    char name[32];
+    int i, missed = 0;
+
+    snprintf(name, sizeof(name), "target %dus", frame_us);
+    num_released = 0;
+    if (drm_present_init_backend(&p, &drm_present_fake, -1, test_release) < 0)
+        return 1;
+    start = drm_present_now() + 2 * FAKE_REFRESH_US;
+    for (i = 1; i <= TEST_FRAMES; i++) {
+        targets[i] = start + (int64_t)i * frame_us;
+        now = drm_present_now();
+        if (targets[i] - FAKE_REFRESH_US > now)
+            usleep(targets[i] - FAKE_REFRESH_US - now);
+        if (drm_present_submit(&p, &plane, 1, (void *)(intptr_t)i, targets[i]) < 0) {
+            printf("%s: submit failed\n", name);
+            return 1;
+        }
+        submits[i] = p.submit_time;
+        if (i == 1)
+            continue;
+        if (p.flips != i - 1 || p.target != targets[i - 1]) {
+            printf("%s: flip %u reports target %"PRId64", frame %d wanted %"PRId64"\n",
+                   name, p.flips, p.target, i - 1, targets[i - 1]);
+            return 1;
+        }
+        vblank = (targets[i - 1] + FAKE_REFRESH_US / 2) / FAKE_REFRESH_US * FAKE_REFRESH_US;
+        if (vblank <= submits[i - 1]) {
+            vblank = (submits[i - 1] / FAKE_REFRESH_US + 1) * FAKE_REFRESH_US;
+            missed++;
+        }
+        if (p.flip_time != vblank) {
+            printf("%s: frame %d for %"PRId64" flipped at %"PRId64", not %"PRId64"\n",
+                   name, i - 1, targets[i - 1], p.flip_time, vblank);
+            return 1;
+        }
+    }
+    drm_present_uninit(&p);
+    if (missed)
+        printf("%s: %d frames committed after their vblank\n", name, missed);
+    return check_releases(name, TEST_FRAMES);
+}
+
+/// a target already in the past flips on the next vblank and shows as late
+static int test_late(void)
+{
+    drm_present_plane_t plane = { 0 };
+    drm_present_t p;
+    int64_t target;
+
+    num_released = 0;
+    if (drm_present_init_backend(&p, &drm_present_fake, -1, test_release) < 0)
+        return 1;
+    target = drm_present_now() - 3 * FAKE_REFRESH_US;
+    drm_present_submit(&p, &plane, 1, (void *)(intptr_t)1, target);
+    drm_present_wait(&p);
+    if (p.flips != 1 || p.target != target ||
+        p.flip_time - p.submit_time > FAKE_REFRESH_US ||
+        p.flip_time - p.target < 2 * FAKE_REFRESH_US) {
+        printf("late: frame for %"PRId64" flipped at %"PRId64"\n", target, p.flip_time);
+        return 1;
+    }
+    drm_present_uninit(&p);
+    return check_releases("late", 1);
+}
+
+int main(void)
+{
+    int ret = 0;
+
+    ret |= test_asap(0);
+    ret |= test_asap(8000);
+    ret |= test_asap(25000);
+    ret |= test_target(FAKE_REFRESH_US);
+    ret |= test_target(40000);
+    ret |= test_target(41708);
+    ret |= test_late();
+    printf("drm_present: %s\n", ret ? "FAILED" : "ok");
+    return ret;
+}
+#endif /* TESTING */
@@ -0,0 +1,118 @@
+/*
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPLAYER_DRM_PRESENT_H
+#define MPLAYER_DRM_PRESENT_H
+
+#include <stdint.h>
+
+/* Non-blocking page flips for the DRM video outputs.
+ *
+ * A frame is one commit of up to DRM_PRESENT_MAX_PLANES planes. At most
+ * one commit is in flight; it completes when the flip event arrives,
+ * at which point the buffers of the frame it replaced are handed back
+ * through the release callback. Each frame may carry the time it should
+ * be shown at; the flip reports back which target it met. The kernel
+ * specific part sits behind drm_present_backend_t so the queue logic can
+ * run on a fake backend, which is what the TESTING build of
+ * drm_present.c does. */
+
+#define DRM_PRESENT_MAX_PLANES 2
+
+typedef struct drm_present_plane {
+    uint32_t plane_id;
+    uint32_t crtc_id;
+    uint32_t fb_id;
+    int32_t  crtc_x, crtc_y;
+    uint32_t crtc_w, crtc_h;
+    uint32_t src_x, src_y;      ///< 16.16 fixed point
+    uint32_t src_w, src_h;      ///< 16.16 fixed point
+} drm_present_plane_t;
+
+struct drm_present;
+
+typedef struct drm_present_backend {
+    const char *name;
+    int  (*init)(struct drm_present *p);
+    /* Queue the commit without blocking. The backend reports completion
+     * through drm_present_flipped(), possibly before returning. */
+    int  (*commit)(struct drm_present *p, const drm_present_plane_t *planes,
+                   int num_planes);
+    /* Wait up to timeout_ms for completion events, returns <0 on error. */
+    int  (*wait)(struct drm_present *p, int timeout_ms);
+    void (*uninit)(struct drm_present *p);
+} drm_present_backend_t;
+
+typedef struct drm_present {
+    const drm_present_backend_t *backend;
+    void *backend_priv;
+    int fd;
+
+    void (*release)(void *frame);  ///< frame is no longer scanned out
+    void *pending;                 ///< submitted, flip not seen yet
+    void *shown;                   ///< currently scanned out
+    int in_flight;
+    int64_t pending_target;        ///< wanted display time of pending, 0 if none
+    int64_t target;                ///< wanted display time of shown, 0 if none
+
+    int64_t submit_time;           ///< CLOCK_MONOTONIC us of the last commit
+    int64_t flip_time;             ///< CLOCK_MONOTONIC us of the last flip
+    int64_t latency;               ///< smoothed commit to flip time in us
+    unsigned int sequence;         ///< vblank counter of the last flip
+    unsigned int flips;            ///< completed flips
+    unsigned int submitted;        ///< successful commits
+} drm_present_t;
+
+extern const drm_present_backend_t drm_present_atomic;
+extern const drm_present_backend_t drm_present_legacy;
+/// Simulated 60 Hz display that honours targets, only through
+/// drm_present_init_backend().
+extern const drm_present_backend_t drm_present_fake;
+
+/**
+ * \brief Set up the queue, trying atomic modesetting first.
+ * \param release called with the frame handle passed to
+ *                drm_present_submit() once that frame left the screen
+ */
+int  drm_present_init(drm_present_t *p, int fd, void (*release)(void *frame));
+int  drm_present_init_backend(drm_present_t *p, const drm_present_backend_t *backend,
+                              int fd, void (*release)(void *frame));
+void drm_present_uninit(drm_present_t *p);
+
+/**
+ * \brief Queue \p frame for display.
+ * Waits for the previous commit first, so this blocks until that one
+ * flipped.
+ * \param target CLOCK_MONOTONIC us the frame should appear at, 0 for the
+ *               next vblank. The KMS backends always flip on the next
+ *               vblank, the caller is expected to submit about half a
+ *               refresh before the target.
+ */
+int  drm_present_submit(drm_present_t *p, const drm_present_plane_t *planes,
+                        int num_planes, void *frame, int64_t target);
+/** \brief Block until no commit is in flight. */
+int  drm_present_wait(drm_present_t *p);
+/** \brief Handle flip events that already arrived, never blocks. */
+void drm_present_poll(drm_present_t *p);
+
+/** \brief Completion entry point for backends. */
+void drm_present_flipped(drm_present_t *p, unsigned int sequence, int64_t time);
+
+int64_t drm_present_now(void);
+
+#endif /* MPLAYER_DRM_PRESENT_H */
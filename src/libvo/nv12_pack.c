@@ -0,0 +1,226 @@
+/*
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define NV12_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define NV12_SSE2 1
+#endif
+
+#include "config.h"
+#include "mp_msg.h"
+#include "libmpcodecs/img_format.h"
+#include "libvo/fastmemcpy.h"
+#include "nv12_pack.h"
+
+#define MAX_BANDS 8
+
+typedef struct {
+    uint8_t *dst_y, *dst_uv;
+    int dst_stride;
+    const mp_image_t *mpi;
+    int interleave;     ///< separate U and V planes in the source
+    int bands;
+} pack_job_t;
+
+static struct {
+    pthread_t threads[MAX_BANDS - 1];
+    int num_threads;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    unsigned int generation;
+    int pending;
+    int quit;
+    const pack_job_t *job;
+} pool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+};
+
+static void interleave_row(uint8_t *dst, const uint8_t *u, const uint8_t *v, int w)
+{
+    int x = 0;
+#if NV12_NEON
+    for (; x + 16 <= w; x += 16) {
+        uint8x16x2_t uv;
+        uv.val[0] = vld1q_u8(u + x);
+        uv.val[1] = vld1q_u8(v + x);
+        vst2q_u8(dst + 2 * x, uv);
+    }
+#elif NV12_SSE2
+    for (; x + 16 <= w; x += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(u + x));
+        __m128i b = _mm_loadu_si128((const __m128i *)(v + x));
+        _mm_storeu_si128((__m128i *)(dst + 2 * x),      _mm_unpacklo_epi8(a, b));
+        _mm_storeu_si128((__m128i *)(dst + 2 * x + 16), _mm_unpackhi_epi8(a, b));
+    }
+#endif
+    for (; x < w; x++) {
+        dst[2 * x]     = u[x];
+        dst[2 * x + 1] = v[x];
+    }
+}
+
+/**
+ * \brief Pack one horizontal band of the image.
+ * Bands are cut on chroma lines so no two bands write the same line.
+ */
+static void pack_band(const pack_job_t *job, int band)
+{
+    const mp_image_t *mpi = job->mpi;
+    int ch    = mpi->chroma_height;
+    int cy0   = ch *  band      / job->bands;
+    int cy1   = ch * (band + 1) / job->bands;
+    int y0    = cy0 << mpi->chroma_y_shift;
+    int y1    = band == job->bands - 1 ? mpi->height : cy1 << mpi->chroma_y_shift;
+    int y;
+
+    if (y1 > y0)
+        memcpy_pic(job->dst_y + y0 * job->dst_stride,
+                   mpi->planes[0] + y0 * mpi->stride[0],
+                   mpi->width, y1 - y0, job->dst_stride, mpi->stride[0]);
+    if (!job->interleave) {
+        if (cy1 > cy0)
+            memcpy_pic(job->dst_uv + cy0 * job->dst_stride,
+                       mpi->planes[1] + cy0 * mpi->stride[1],
+                       2 * mpi->chroma_width, cy1 - cy0,
+                       job->dst_stride, mpi->stride[1]);
+        return;
+    }
+    for (y = cy0; y < cy1; y++)
+        interleave_row(job->dst_uv + y * job->dst_stride,
+                       mpi->planes[1] + y * mpi->stride[1],
+                       mpi->planes[2] + y * mpi->stride[2],
+                       mpi->chroma_width);
+}
+
+static void *pack_thread(void *arg)
+{
+    int band = (intptr_t)arg;
+    unsigned int seen = 0;
+
+    pthread_mutex_lock(&pool.lock);
+    for (;;) {
+        while (!pool.quit && pool.generation == seen)
+            pthread_cond_wait(&pool.wake, &pool.lock);
+        if (pool.quit)
+            break;
+        seen = pool.generation;
+        pthread_mutex_unlock(&pool.lock);
+
+        pack_band(pool.job, band);
+
+        pthread_mutex_lock(&pool.lock);
+        if (--pool.pending == 0)
+            pthread_cond_signal(&pool.done);
+    }
+    pthread_mutex_unlock(&pool.lock);
+    return NULL;
+}
+
+int nv12_pack_init(int threads)
+{
+    long cpus;
+    int i;
+
+    if (pool.num_threads)
+        return pool.num_threads + 1;
+    if (threads <= 0) {
+        cpus    = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? cpus : 1;
+    }
+    if (threads > MAX_BANDS)
+        threads = MAX_BANDS;
+
+    pool.quit = 0;
+    for (i = 0; i < threads - 1; i++) {
+        // band 0 is always done by the calling thread
+        if (pthread_create(&pool.threads[i], NULL, pack_thread,
+                           (void *)(intptr_t)(i + 1)))
+            break;
+        pool.num_threads++;
+    }
+    mp_msg(MSGT_VO, MSGL_V, "[nv12] Packing frames in %d bands.\n",
+           pool.num_threads + 1);
+    return pool.num_threads + 1;
+}
+
+void nv12_pack_uninit(void)
+{
+    int i;
+
+    pthread_mutex_lock(&pool.lock);
+    pool.quit = 1;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+    for (i = 0; i < pool.num_threads; i++)
+        pthread_join(pool.threads[i], NULL);
+    pool.num_threads = 0;
+}
+
+int nv12_pack_image(uint8_t *dst_y, uint8_t *dst_uv, int dst_stride,
+                    const mp_image_t *mpi)
+{
+    pack_job_t job;
+
+    switch (mpi->imgfmt) {
+    case IMGFMT_YV12:
+    case IMGFMT_I420:
+    case IMGFMT_IYUV:
+        job.interleave = 1;
+        break;
+    case IMGFMT_NV12:
+        job.interleave = 0;
+        break;
+    default:
+        return 0;
+    }
+    job.dst_y      = dst_y;
+    job.dst_uv     = dst_uv;
+    job.dst_stride = dst_stride;
+    job.mpi        = mpi;
+    // tiny frames are not worth waking anybody up for
+    job.bands      = mpi->chroma_height >= 64 ? pool.num_threads + 1 : 1;
+
+    if (job.bands > 1) {
+        pthread_mutex_lock(&pool.lock);
+        pool.job     = &job;
+        pool.pending = pool.num_threads;
+        pool.generation++;
+        pthread_cond_broadcast(&pool.wake);
+        pthread_mutex_unlock(&pool.lock);
+    }
+
+    pack_band(&job, 0);
+
+    if (job.bands > 1) {
+        pthread_mutex_lock(&pool.lock);
+        while (pool.pending)
+            pthread_cond_wait(&pool.done, &pool.lock);
+        pthread_mutex_unlock(&pool.lock);
+    }
+    return 1;
+}
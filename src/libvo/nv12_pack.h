@@ -0,0 +1,47 @@
+/*
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPLAYER_NV12_PACK_H
+#define MPLAYER_NV12_PACK_H
+
+#include <stdint.h>
+
+#include "libmpcodecs/mp_image.h"
+
+/* Copy YV12/I420/NV12 images into NV12 scanout buffers, split into
+ * horizontal bands over a small pool of worker threads. */
+
+/**
+ * \brief Start the worker threads.
+ * \param threads total number of bands, 0 picks one per CPU
+ * \return number of bands frames are split into
+ */
+int nv12_pack_init(int threads);
+void nv12_pack_uninit(void);
+
+/**
+ * \brief Pack the whole of \p mpi (width x height) into an NV12 buffer.
+ * \param dst_y luma plane of the destination
+ * \param dst_uv interleaved chroma plane of the destination
+ * \param dst_stride line size of both destination planes
+ * \return 0 if the image format cannot be packed
+ */
+int nv12_pack_image(uint8_t *dst_y, uint8_t *dst_uv, int dst_stride,
+                    const mp_image_t *mpi);
+
+#endif /* MPLAYER_NV12_PACK_H */
@@ -0,0 +1,48 @@
+/*
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPLAYER_OMAP_DCE_SHARE_H
+#define MPLAYER_OMAP_DCE_SHARE_H
+
+#include <stdint.h>
+
+/* Display buffers the omap_dce decoder decodes into and the omap_drm VOs
+ * scan out. The VO in use fills in omap_dce_share at preinit. */
+
+typedef struct {
+	int     handle;
+} DisplayHandle;
+
+typedef struct {
+	void           *priv;
+	uint32_t       handle;
+	int            dmaBuf;
+	int            locked;
+} DisplayVideoBuffer;
+
+typedef struct {
+	DisplayHandle handle;
+	int (*getDisplayVideoBuffer)(DisplayVideoBuffer *handle, uint32_t pixelfmt, int width, int height);
+	int (*releaseDisplayVideoBuffer)(DisplayVideoBuffer *handle);
+	int active;  ///< set while the decoder outputs into display buffers
+} omap_dce_share_t;
+
+/// defined in vd_omap_dce.c
+extern omap_dce_share_t omap_dce_share;
+
+#endif /* MPLAYER_OMAP_DCE_SHARE_H */
@@ -84,6 +84,20 @@
 
 #define VOCTRL_UPDATE_SCREENINFO 32
 
+/* timing of the last completed page flip */
+#define VOCTRL_GET_FLIP_INFO 33
+typedef struct {
+  int64_t flip_time;      // CLOCK_MONOTONIC in microseconds
+  int64_t latency;        // smoothed flip_page() to flip delay in microseconds
+  unsigned int sequence;  // vblank counter at the flip
+  unsigned int count;     // completed flips
+  unsigned int submitted; // frames handed to the display so far
+  int64_t target;         // display time wanted for the flipped frame, 0 if unknown
+} mp_flip_info_t;
+
+// int64_t *, CLOCK_MONOTONIC microseconds the next flip_page() should be shown at
+#define VOCTRL_SET_FLIP_TARGET 34
+
 // Vo can be used by xover
 #define VOCTRL_XOVERLAY_SUPPORT 22
 
@@ -38,8 +38,10 @@
 #include "../mp_core.h"
 #include "osdep/timer.h"
 #include "libavcodec/avcodec.h"
+#include "nv12_pack.h"
+#include "drm_present.h"
+#include "omap_dce_share.h"
 
-#include <libswscale/swscale.h>
 #include <xf86drm.h>
 #include <xf86drmMode.h>
 #include <drm_fourcc.h>
@@ -61,13 +63,6 @@ static const vo_info_t info = {
 	""
 };
 
-typedef struct {
-	void           *priv;
-	uint32_t       handle;
-	int            dmaBuf;
-	int            locked;
-} DisplayVideoBuffer;
-
 typedef struct {
 	uint32_t        handle;
 	uint32_t        fbId;
@@ -92,18 +87,6 @@ typedef struct {
 	DisplayVideoBuffer *db;
 } VideoBuffer;
 
-typedef struct {
-	int     handle;
-} DisplayHandle;
-
-typedef struct {
-	DisplayHandle handle;
-	int (*getDisplayVideoBuffer)(DisplayVideoBuffer *handle, uint32_t pixelfmt, int width, int height);
-	int (*releaseDisplayVideoBuffer)(DisplayVideoBuffer *handle);
-} omap_dce_share_t;
-
-extern omap_dce_share_t omap_dce_share;
-
 #define NUM_OSD_FB   2
 #define NUM_VIDEO_FB 3
 
@@ -135,12 +118,14 @@ int                                _osdChanged;
 int                                _currentOSDBuffer;
 int                                _currentVideoBuffer;
 
-static struct SwsContext           *_scaleCtx;
+static drm_present_t               _present;
+static int64_t                     _flipTarget; ///< for the next flip_page(), 0 for asap
 
 LIBVO_EXTERN(omap_drm)
 
 static int getDisplayVideoBuffer(DisplayVideoBuffer *handle, uint32_t pixelfmt, int width, int height);
 static int releaseDisplayVideoBuffer(DisplayVideoBuffer *handle);
+static void releaseVideoFrame(void *frame);
 
 static int preinit(const char *arg) {
 	int modeId = -1, i, j;
@@ -389,7 +374,11 @@ static int preinit(const char *arg) {
 	omap_dce_share.getDisplayVideoBuffer = &getDisplayVideoBuffer;
 	omap_dce_share.releaseDisplayVideoBuffer = &releaseDisplayVideoBuffer;
 
-	_scaleCtx = NULL;
+	if (drm_present_init(&_present, _fd, releaseVideoFrame) < 0) {
+		mp_msg(MSGT_VO, MSGL_FATAL, "[omap_drm] preinit() Failed to set up page flipping!\n");
+		goto fail;
+	}
+	nv12_pack_init(0);
 	_dce = 0;
 	_currentOSDBuffer = 0;
 	_currentVideoBuffer = 0;
@@ -450,6 +439,9 @@ static void uninit(void) {
 	if (!_initialized)
 		return;
 
+	drm_present_uninit(&_present);
+	nv12_pack_uninit();
+
 	for (int i = 0; i < NUM_OSD_FB; i++) {
 		if (_osdBuffers[i].fbId) {
 			drmModeRmFB(_fd, _osdBuffers[i].fbId);
@@ -655,7 +647,9 @@ static int config(uint32_t width, uint32_t height, uint32_t d_width, uint32_t d_
 
 	switch (format) {
 	case IMGFMT_NV12:
-		_dce = 1;
+		// NV12 also comes from software decoders, only DCE frames
+		// already live in our buffers
+		_dce = omap_dce_share.active;
 		break;
 	case IMGFMT_YV12:
 		_dce = 0;
@@ -701,46 +695,15 @@ static uint32_t put_image(mp_image_t *mpi) {
 		db->locked = 1;
 		_videoBuffers[_currentVideoBuffer] = (VideoBuffer *)db->priv;
 	} else {
-		uint8_t *srcPtr[4] = {};
-		uint8_t *dstPtr[4] = {};
-		int srcStride[4] = {};
-		int dstStride[4] = {};
 		uint8_t *dst;
 
 		if (!_videoBuffers[_currentVideoBuffer]) {
 			_videoBuffers[_currentVideoBuffer] = getVideoBuffer(IMGFMT_NV12, frame_width, frame_height);
+			if (!_videoBuffers[_currentVideoBuffer])
+				goto fail;
 		}
 		dst = (uint8_t *)_videoBuffers[_currentVideoBuffer]->ptr;
-		if (mpi->imgfmt == IMGFMT_YV12) {
-			srcPtr[0] = mpi->planes[0];
-			srcPtr[1] = mpi->planes[1];
-			srcPtr[2] = mpi->planes[2];
-			srcPtr[3] = mpi->planes[3];
-			srcStride[0] = mpi->stride[0];
-			srcStride[1] = mpi->stride[1];
-			srcStride[2] = mpi->stride[2];
-			srcStride[3] = mpi->stride[3];
-			dstPtr[0] = dst;
-			dstPtr[1] = dst + frame_width * frame_height;
-			dstPtr[2] = NULL;
-			dstPtr[3] = NULL;
-			dstStride[0] = frame_width;
-			dstStride[1] = frame_width;
-			dstStride[2] = 0;
-			dstStride[3] = 0;
-
-			if (!_scaleCtx) {
-				_scaleCtx = sws_getContext(frame_width, frame_height, AV_PIX_FMT_YUV420P,
-					                   frame_width, frame_height,
-					                   AV_PIX_FMT_NV12, SWS_POINT, NULL, NULL, NULL);
-				if (!_scaleCtx) {
-					mp_msg(MSGT_VO, MSGL_FATAL,
-						"[omap_drm] Error: put_image() Can not create scale context!\n");
-					goto fail;
-				}
-			}
-			sws_scale(_scaleCtx, (const uint8_t *const *)srcPtr, srcStride, 0, frame_height, dstPtr, dstStride);
-		} else {
+		if (!nv12_pack_image(dst, dst + frame_width * frame_height, frame_width, mpi)) {
 			mp_msg(MSGT_VO, MSGL_FATAL, "[omap_drm] Error: put_image() Not supported format!\n");
 			goto fail;
 		}
@@ -814,46 +777,70 @@ static void draw_alpha(int x0,int y0, int w,int h, unsigned char* src, unsigned
 static void draw_osd(void) {
 	_osdChanged = vo_osd_changed(0);
 	if (_osdChanged) {
+		// the buffer we draw into stays on screen until the flip
+		// in flight completes
+		drm_present_wait(&_present);
 		memset(_osdBuffers[_currentOSDBuffer].ptr, 0, _osdBuffers[_currentOSDBuffer].size);
 
 		vo_draw_text(_modeInfo.hdisplay, _modeInfo.vdisplay - 20, draw_alpha);
 	}
 }
 
+static void releaseVideoFrame(void *frame) {
+	VideoBuffer *videoBuffer = frame;
+
+	// hand DCE output buffers back to the decoder once replaced on screen
+	if (videoBuffer->db)
+		videoBuffer->db->locked = 0;
+}
+
 static void flip_page() {
+	drm_present_plane_t planes[2];
+	VideoBuffer *videoBuffer;
+	int numPlanes = 1;
+	int64_t target = _flipTarget;
+
+	_flipTarget = 0;
+
 	if (!_initialized)
 		goto fail;
 
-	if (drmModeSetPlane(_fd, _videoPlaneId, _crtcId,
-			_videoBuffers[_currentVideoBuffer]->fbId, 0,
-			_videoBuffers[_currentVideoBuffer]->dstX,
-			_videoBuffers[_currentVideoBuffer]->dstY,
-			_videoBuffers[_currentVideoBuffer]->dstWidth,
-			_videoBuffers[_currentVideoBuffer]->dstHeight,
-			_videoBuffers[_currentVideoBuffer]->srcX << 16,
-			_videoBuffers[_currentVideoBuffer]->srcY << 16,
-			_videoBuffers[_currentVideoBuffer]->srcWidth << 16,
-			_videoBuffers[_currentVideoBuffer]->srcHeight << 16
-			)) {
-		mp_msg(MSGT_VO, MSGL_FATAL, "[omap_drm] Error: flip() Failed set plane: %s\n", strerror(errno));
+	videoBuffer = _videoBuffers[_currentVideoBuffer];
+	planes[0].plane_id = _videoPlaneId;
+	planes[0].crtc_id = _crtcId;
+	planes[0].fb_id = videoBuffer->fbId;
+	planes[0].crtc_x = videoBuffer->dstX;
+	planes[0].crtc_y = videoBuffer->dstY;
+	planes[0].crtc_w = videoBuffer->dstWidth;
+	planes[0].crtc_h = videoBuffer->dstHeight;
+	planes[0].src_x = videoBuffer->srcX << 16;
+	planes[0].src_y = videoBuffer->srcY << 16;
+	planes[0].src_w = videoBuffer->srcWidth << 16;
+	planes[0].src_h = videoBuffer->srcHeight << 16;
+
+	if (_osdChanged) {
+		planes[1].plane_id = _osdPlaneId;
+		planes[1].crtc_id = _crtcId;
+		planes[1].fb_id = _osdBuffers[_currentOSDBuffer].fbId;
+		planes[1].crtc_x = 0;
+		planes[1].crtc_y = 0;
+		planes[1].crtc_w = _modeInfo.hdisplay;
+		planes[1].crtc_h = _modeInfo.vdisplay;
+		planes[1].src_x = 0;
+		planes[1].src_y = 0;
+		planes[1].src_w = _modeInfo.hdisplay << 16;
+		planes[1].src_h = _modeInfo.vdisplay << 16;
+		numPlanes = 2;
+	}
+
+	if (drm_present_submit(&_present, planes, numPlanes, videoBuffer, target)) {
+		mp_msg(MSGT_VO, MSGL_FATAL, "[omap_drm] Error: flip() Failed to queue page flip\n");
 		goto fail;
 	}
 	if (++_currentVideoBuffer >= NUM_VIDEO_FB)
 		_currentVideoBuffer = 0;
-	if (_videoBuffers[_currentVideoBuffer] &&
-		_videoBuffers[_currentVideoBuffer]->db) {
-		_videoBuffers[_currentVideoBuffer]->db->locked = 0;
-	}
 
 	if (_osdChanged) {
-		if (drmModeSetPlane(_fd, _osdPlaneId, _crtcId,
-		                    _osdBuffers[_currentOSDBuffer].fbId, 0,
-		                    0, 0, _modeInfo.hdisplay, _modeInfo.vdisplay,
-		                    0, 0, _modeInfo.hdisplay << 16, _modeInfo.vdisplay << 16
-		                   )) {
-			mp_msg(MSGT_VO, MSGL_FATAL, "[omap_drm] Error: flip() Failed set plane: %s\n", strerror(errno));
-			goto fail;
-		}
 		if (++_currentOSDBuffer >= NUM_OSD_FB)
 			_currentOSDBuffer = 0;
 		_osdChanged = 0;
@@ -867,7 +854,7 @@ fail:
 }
 
 static void check_events(void) {
-	// empty
+	drm_present_poll(&_present);
 }
 
 static int control(uint32_t request, void *data) {
@@ -883,6 +870,21 @@ static int control(uint32_t request, void *data) {
 		return VO_TRUE;
 	case VOCTRL_DRAW_IMAGE:
 		return put_image(data);
+	case VOCTRL_GET_FLIP_INFO: {
+		mp_flip_info_t *flip = data;
+		if (!_present.flips)
+			return VO_FALSE;
+		flip->flip_time = _present.flip_time;
+		flip->latency = _present.latency;
+		flip->sequence = _present.sequence;
+		flip->count = _present.flips;
+		flip->submitted = _present.submitted;
+		flip->target = _present.target;
+		return VO_TRUE;
+	}
+	case VOCTRL_SET_FLIP_TARGET:
+		_flipTarget = *(int64_t *)data;
+		return VO_TRUE;
 	}
 	return VO_NOTIMPL;
 }
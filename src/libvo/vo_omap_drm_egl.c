@@ -38,8 +38,10 @@
 #include "../mp_core.h"
 #include "osdep/timer.h"
 #include "libavcodec/avcodec.h"
+#include "nv12_pack.h"
+#include "drm_present.h"
+#include "omap_dce_share.h"
 
-#include <libswscale/swscale.h>
 #include <drm/drm.h>
 #include <xf86drm.h>
 #include <xf86drmMode.h>
@@ -73,13 +75,6 @@ typedef struct {
 	uint32_t        fbId;
 } DrmFb;
 
-typedef struct {
-	void           *priv;
-	uint32_t       handle;
-	int            dmaBuf;
-	int            locked;
-} DisplayVideoBuffer;
-
 typedef struct {
     uint32_t           handle;
 	int                dmabuf;
@@ -90,18 +85,6 @@ typedef struct {
 	DisplayVideoBuffer *db;
 } RenderTexture;
 
-typedef struct {
-	int     handle;
-} DisplayHandle;
-
-typedef struct {
-	DisplayHandle handle;
-	int (*getDisplayVideoBuffer)(DisplayVideoBuffer *handle, uint32_t pixelfmt, int width, int height);
-	int (*releaseDisplayVideoBuffer)(DisplayVideoBuffer *handle);
-} omap_dce_share_t;
-
-extern omap_dce_share_t omap_dce_share;
-
 static int                         _dce;
 static int                         _initialized;
 static int                         _fd;
@@ -115,6 +98,8 @@ static drmModeModeInfo             _modeInfo;
 static uint32_t                    _connectorId;
 static uint32_t                    _crtcId;
 static int                         _planeId;
+static drm_present_t               _present;
+static int64_t                     _flipTarget; ///< for the next flip_page(), 0 for asap
 
 static EGLDisplay                  _eglDisplay;
 static EGLSurface                  _eglSurface;
@@ -127,7 +112,6 @@ static GLuint                      _vertexShader;
 static GLuint                      _fragmentShader;
 static GLuint                      _glProgram;
 static RenderTexture               *_renderTexture;
-static struct SwsContext           *_scaleCtx;
 static uint32_t                    _primaryHandle;
 static uint32_t                    _primaryFbId;
 static void                        *_primaryPtr;
@@ -140,6 +124,7 @@ static int releaseRenderTexture(RenderTexture *texture);
 static DrmFb *getDrmFb(struct gbm_bo *gbmBo);
 static int getDisplayVideoBuffer(DisplayVideoBuffer *handle, uint32_t pixelfmt, int width, int height);
 static int releaseDisplayVideoBuffer(DisplayVideoBuffer *handle);
+static void releaseFrontBuffer(void *frame);
 
 #define EGL_STR_ERROR(value) case value: return #value;
 static const char* eglGetErrorStr(EGLint error) {
@@ -524,7 +509,11 @@ static int preinit(const char *arg) {
 	omap_dce_share.getDisplayVideoBuffer = &getDisplayVideoBuffer;
 	omap_dce_share.releaseDisplayVideoBuffer = &releaseDisplayVideoBuffer;
 
-	_scaleCtx = NULL;
+	if (drm_present_init(&_present, _fd, releaseFrontBuffer) < 0) {
+		mp_msg(MSGT_VO, MSGL_FATAL, "[omap_drm_egl] preinit() Failed to set up page flipping!\n");
+		goto fail;
+	}
+	nv12_pack_init(0);
 	_dce = 0;
 
 	_initialized = 1;
@@ -602,10 +591,8 @@ static void uninit(void) {
 	if (!_initialized)
 		return;
 
-	if (_scaleCtx) {
-		sws_freeContext(_scaleCtx);
-		_scaleCtx = NULL;
-	}
+	drm_present_uninit(&_present);
+	nv12_pack_uninit();
 
 	if (_vertexShader) {
 		glDeleteShader(_vertexShader);
@@ -901,7 +888,7 @@ static int config(uint32_t width, uint32_t height, uint32_t d_width, uint32_t d_
 
 	switch (format) {
 	case IMGFMT_NV12:
-		_dce = 1;
+		_dce = omap_dce_share.active;
 		break;
 	case IMGFMT_YV12:
 		_dce = 0;
@@ -1003,41 +990,9 @@ static uint32_t put_image(mp_image_t *mpi) {
 	}
 
 	if (!_dce) {
-		uint8_t *srcPtr[4] = {};
-		uint8_t *dstPtr[4] = {};
-		int srcStride[4] = {};
-		int dstStride[4] = {};
-		uint8_t *dst;
-
-		dst = renderTexture->mapPtr;
-		if (mpi->imgfmt == IMGFMT_YV12) {
-			srcPtr[0] = mpi->planes[0];
-			srcPtr[1] = mpi->planes[1];
-			srcPtr[2] = mpi->planes[2];
-			srcPtr[3] = mpi->planes[3];
-			srcStride[0] = mpi->stride[0];
-			srcStride[1] = mpi->stride[1];
-			srcStride[2] = mpi->stride[2];
-			srcStride[3] = mpi->stride[3];
-			dstPtr[0] = dst;
-			dstPtr[1] = dst + frame_width * frame_height;
-			dstPtr[2] = NULL;
-			dstPtr[3] = NULL;
-			dstStride[0] = frame_width;
-			dstStride[1] = frame_width;
-			dstStride[2] = 0;
-			dstStride[3] = 0;
-
-			if (!_scaleCtx) {
-				_scaleCtx = sws_getContext(frame_width, frame_height, AV_PIX_FMT_YUV420P, frame_width, frame_height,
-				                           AV_PIX_FMT_NV12, SWS_POINT, NULL, NULL, NULL);
-				if (!_scaleCtx) {
-					mp_msg(MSGT_VO, MSGL_FATAL, "[omap_drm_egl] put_image() Can not create scale context!\n");
-					goto fail;
-				}
-			}
-			sws_scale(_scaleCtx, (const uint8_t *const *)srcPtr, srcStride, 0, frame_height, dstPtr, dstStride);
-		} else {
+		uint8_t *dst = renderTexture->mapPtr;
+
+		if (!nv12_pack_image(dst, dst + frame_width * frame_height, frame_width, mpi)) {
 			mp_msg(MSGT_VO, MSGL_FATAL, "[omap_drm_egl] put_image() Not supported format!\n");
 			goto fail;
 		}
@@ -1067,28 +1022,48 @@ static void draw_osd(void) {
 	// todo
 }
 
+static void releaseFrontBuffer(void *frame) {
+	gbm_surface_release_buffer(_gbmSurface, frame);
+}
+
 static void flip_page() {
+	drm_present_plane_t plane;
 	struct gbm_bo *gbmBo;
 	DrmFb *drmFb;
+	int64_t target = _flipTarget;
+
+	_flipTarget = 0;
 
-	//int old = GetTimerMS();
+	// the previous frame must be on screen before its predecessor's
+	// buffer can be rendered into again
+	drm_present_wait(&_present);
 	eglSwapBuffers(_eglDisplay, _eglSurface);
-	//printf("time: %d              \n", GetTimerMS() - old);
 
 	gbmBo = gbm_surface_lock_front_buffer(_gbmSurface);
+	if (!gbmBo) {
+		mp_msg(MSGT_VO, MSGL_FATAL, "[omap_drm_egl] flip() Failed to lock front buffer\n");
+		return;
+	}
 	drmFb = getDrmFb(gbmBo);
+	if (!drmFb)
+		goto fail;
 
-	if (drmModeSetPlane(_fd, _planeId, _crtcId,
-	                    drmFb->fbId, 0,
-	                    0, 0, _modeInfo.hdisplay, _modeInfo.vdisplay,
-	                    0, 0, _modeInfo.hdisplay << 16, _modeInfo.vdisplay << 16
-	                   )) {
-		mp_msg(MSGT_VO, MSGL_FATAL, "[omap_drm_egl] flip() Failed set plane! %s\n", strerror(errno));
+	plane.plane_id = _planeId;
+	plane.crtc_id = _crtcId;
+	plane.fb_id = drmFb->fbId;
+	plane.crtc_x = 0;
+	plane.crtc_y = 0;
+	plane.crtc_w = _modeInfo.hdisplay;
+	plane.crtc_h = _modeInfo.vdisplay;
+	plane.src_x = 0;
+	plane.src_y = 0;
+	plane.src_w = _modeInfo.hdisplay << 16;
+	plane.src_h = _modeInfo.vdisplay << 16;
+	if (drm_present_submit(&_present, &plane, 1, gbmBo, target)) {
+		mp_msg(MSGT_VO, MSGL_FATAL, "[omap_drm_egl] flip() Failed to queue page flip\n");
 		goto fail;
 	}
 
-	gbm_surface_release_buffer(_gbmSurface, gbmBo);
-
 	return;
 
 fail:
@@ -1097,7 +1072,7 @@ fail:
 }
 
 static void check_events(void) {
-	// empty
+	drm_present_poll(&_present);
 }
 
 static int control(uint32_t request, void *data) {
@@ -1113,6 +1088,21 @@ static int control(uint32_t request, void *data) {
 		return VO_TRUE;
 	case VOCTRL_DRAW_IMAGE:
 		return put_image(data);
+	case VOCTRL_GET_FLIP_INFO: {
+		mp_flip_info_t *flip = data;
+		if (!_present.flips)
+			return VO_FALSE;
+		flip->flip_time = _present.flip_time;
+		flip->latency = _present.latency;
+		flip->sequence = _present.sequence;
+		flip->count = _present.flips;
+		flip->submitted = _present.submitted;
+		flip->target = _present.target;
+		return VO_TRUE;
+	}
+	case VOCTRL_SET_FLIP_TARGET:
+		_flipTarget = *(int64_t *)data;
+		return VO_TRUE;
 	}
 
 	return VO_NOTIMPL;
@@ -22,6 +22,7 @@
 #include "config.h"
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <errno.h>
 #include <string.h>
@@ -35,9 +36,13 @@
 #include "m_option.h"
 #include "mp_msg.h"
 #include "help_mp.h"
+#include "osdep/timer.h"
 
 #define MAX_PROFILE_DEPTH 20
 
+static m_config_save_slot_t*
+m_config_write_slot(m_config_t *config, m_config_option_t *co);
+
 
 static int parse_profile(const m_option_t *opt, const char *name,
                          const char *param, void *dst, int src)
@@ -223,14 +228,17 @@ m_config_free(m_config_t* config) {
     free(p->opts);
     free(p);
   }
+  free(config->name_hash);
+  free(config->addr_hash);
+  free(config->runtime);
   free(config->self_opts);
   free(config);
 }
 
 void
 m_config_push(m_config_t* config) {
-  m_config_option_t *co;
-  m_config_save_slot_t *slot;
+  int64_t start = GetTimerNS();
+  int i;
 
 #ifdef MP_DEBUG
   assert(config != NULL);
@@ -238,30 +246,14 @@ m_config_push(m_config_t* config) {
 #endif
 
   config->lvl++;
+  config->num_pushes++;
 
-  for(co = config->opts ; co ; co = co->next ) {
-    if(co->opt->type->flags & M_OPT_TYPE_HAS_CHILD)
-      continue;
-    if(co->opt->flags & (M_OPT_GLOBAL|M_OPT_NOSAVE))
-      continue;
-    if((co->opt->flags & M_OPT_OLD) && !(co->flags & M_CFG_OPT_SET))
-      continue;
-    if(co->flags & M_CFG_OPT_ALIAS)
-      continue;
-
-    // Update the current status
-    m_option_save(co->opt,co->slots->data,co->opt->p);
-
-    // Allocate a new slot
-    slot = calloc(1,sizeof(m_config_save_slot_t) + co->opt->type->size);
-    slot->lvl = config->lvl;
-    slot->prev = co->slots;
-    co->slots = slot;
-    m_option_copy(co->opt,co->slots->data,co->slots->prev->data);
-    // Reset our set flag
-    co->flags &= ~M_CFG_OPT_SET;
-  }
+  // Options get their slot when they are set, except the ones that can
+  // also change behind our back, their current value must be saved now.
+  for(i = 0 ; i < config->num_runtime ; i++)
+    m_config_write_slot(config,config->runtime[i]);
 
+  config->push_pop_time += GetTimerNS() - start;
   mp_msg(MSGT_CFGPARSER, MSGL_DBG2,"Config pushed level is now %d\n",config->lvl);
 }
 
@@ -269,38 +261,154 @@ void
 m_config_pop(m_config_t* config) {
   m_config_option_t *co;
   m_config_save_slot_t *slot;
+  int64_t start = GetTimerNS();
 
 #ifdef MP_DEBUG
   assert(config != NULL);
   assert(config->lvl > 1);
 #endif
 
-  for(co = config->opts ; co ; co = co->next ) {
-    int pop = 0;
-    if(co->opt->type->flags & M_OPT_TYPE_HAS_CHILD)
-      continue;
-    if(co->opt->flags & (M_OPT_GLOBAL|M_OPT_NOSAVE))
-      continue;
-    if(co->flags & M_CFG_OPT_ALIAS)
-      continue;
-    if(co->slots->lvl > config->lvl)
-      mp_msg(MSGT_CFGPARSER, MSGL_WARN,MSGTR_SaveSlotTooOld,config->lvl,co->slots->lvl);
-
-    while(co->slots->lvl >= config->lvl) {
-      m_option_free(co->opt,co->slots->data);
-      slot = co->slots;
-      co->slots = slot->prev;
-      free(slot);
-      pop++;
-    }
-    if(pop) // We removed some ctx -> set the previous value
-      m_option_set(co->opt,co->opt->p,co->slots->data);
+  // Slots of one option are stacked in the same order as the changed
+  // list, so the head of the list is always the top slot of its owner.
+  while((slot = config->changed) && slot->lvl >= config->lvl) {
+    co = slot->owner;
+    if(slot->lvl > config->lvl)
+      mp_msg(MSGT_CFGPARSER, MSGL_WARN,MSGTR_SaveSlotTooOld,config->lvl,slot->lvl);
+    config->changed = slot->changed_next;
+    co->slots = slot->prev;
+    m_option_free(co->opt,slot->data);
+    free(slot);
+    // We removed some ctx -> set the previous value
+    m_option_set(co->opt,co->opt->p,co->slots->data);
   }
 
   config->lvl--;
+  config->push_pop_time += GetTimerNS() - start;
   mp_msg(MSGT_CFGPARSER, MSGL_DBG2,"Config poped level=%d\n",config->lvl);
 }
 
+static int
+is_wildcard(const m_config_option_t *co) {
+  int l = strlen(co->name) - 1;
+  return (co->opt->type->flags & M_OPT_TYPE_ALLOW_WILDCARD) && co->name[l] == '*';
+}
+
+static unsigned int
+addr_hash(const void *p) {
+  uintptr_t v = (uintptr_t)p;
+  return (v >> 3) ^ (v >> 15);
+}
+
+static void
+m_config_index_option(m_config_t *config, m_config_option_t *co) {
+  unsigned int mask = config->hash_size - 1;
+
+  if(!is_wildcard(co)) {
+    m_config_option_t **b = &config->name_hash[m_option_hash_name(co->name) & mask];
+    co->hash_next = *b;
+    *b = co;
+  }
+  if(co->opt->p) {
+    m_config_option_t **b = &config->addr_hash[addr_hash(co->opt->p) & mask];
+    co->addr_next = *b;
+    *b = co;
+  }
+}
+
+/// Grow the hash tables so they stay at most as full as they are large.
+static void
+m_config_grow_index(m_config_t *config) {
+  m_config_option_t *co;
+  unsigned int size = config->hash_size ? 2 * config->hash_size : 256;
+  m_config_option_t **name_hash = calloc(size, sizeof(*name_hash));
+  m_config_option_t **addr_hash = calloc(size, sizeof(*addr_hash));
+
+  if(!name_hash || !addr_hash) {
+    free(name_hash);
+    free(addr_hash);
+    return;
+  }
+  free(config->name_hash);
+  free(config->addr_hash);
+  config->name_hash = name_hash;
+  config->addr_hash = addr_hash;
+  config->hash_size = size;
+  for(co = config->opts ; co ; co = co->next)
+    m_config_index_option(config, co);
+}
+
+static m_config_option_t*
+m_config_find_alias(const m_config_t *config, const void *p) {
+  m_config_option_t *co, *best = NULL;
+
+  if(!config->hash_size)
+    return NULL;
+  for(co = config->addr_hash[addr_hash(p) & (config->hash_size - 1)] ; co ; co = co->addr_next)
+    if(co->opt->p == p && (!best || co->seq > best->seq))
+      best = co;
+  return best;
+}
+
+/// The option that owns the save slots of \p co, which differs for aliases.
+static m_config_option_t*
+m_config_slot_owner(const m_config_t *config, m_config_option_t *co) {
+  m_config_option_t *o;
+
+  if(!(co->flags & M_CFG_OPT_ALIAS))
+    return co;
+  for(o = config->addr_hash[addr_hash(co->opt->p) & (config->hash_size - 1)] ; o ; o = o->addr_next)
+    if(o->opt->p == co->opt->p && !(o->flags & M_CFG_OPT_ALIAS) &&
+       !(o->opt->type->flags & M_OPT_TYPE_HAS_CHILD))
+      return o;
+  return co;
+}
+
+static void
+m_config_track_slot(m_config_t *config, m_config_option_t *co,
+                    m_config_save_slot_t *slot) {
+  slot->owner = co;
+  slot->changed_next = config->changed;
+  config->changed = slot;
+}
+
+/// Get the slot to store a new value of \p co in at the current level.
+/** The first time an option is set at a level its current value is
+ *  saved and a new slot is stacked on top, the way m_config_push()
+ *  used to do for every option.
+ */
+static m_config_save_slot_t*
+m_config_write_slot(m_config_t *config, m_config_option_t *co) {
+  m_config_save_slot_t *slot;
+
+  co = m_config_slot_owner(config, co);
+  if(co->slots->lvl >= config->lvl)
+    return co->slots;
+  if(co->opt->flags & (M_OPT_GLOBAL|M_OPT_NOSAVE))
+    return co->slots;
+
+  // Update the current status
+  m_option_save(co->opt,co->slots->data,co->opt->p);
+
+  slot = calloc(1,sizeof(m_config_save_slot_t) + co->opt->type->size);
+  slot->lvl = config->lvl;
+  slot->prev = co->slots;
+  co->slots = slot;
+  m_option_copy(co->opt,slot->data,slot->prev->data);
+  if(config->lvl > 1)
+    m_config_track_slot(config, co, slot);
+  return slot;
+}
+
+/// Whether \p co was set at the current level.
+static int
+m_config_is_set(const m_config_t *config, m_config_option_t *co) {
+  if(!(co->flags & M_CFG_OPT_SET))
+    return 0;
+  if(co->opt->flags & (M_OPT_GLOBAL|M_OPT_NOSAVE))
+    return 1;
+  return m_config_slot_owner(config, co)->slots->lvl == config->lvl;
+}
+
 static void
 m_config_add_option(m_config_t *config, const m_option_t *arg, const char* prefix) {
   m_config_option_t *co;
@@ -334,14 +442,10 @@ m_config_add_option(m_config_t *config, const m_option_t *arg, const char* prefi
   } else {
     m_config_option_t *i;
     // Check if there is already an option pointing to this address
-    if(arg->p) {
-      for(i = config->opts ; i ; i = i->next ) {
-	if(i->opt->p == arg->p) { // So we don't save the same vars more than 1 time
-	  co->slots = i->slots;
-	  co->flags |= M_CFG_OPT_ALIAS;
-	  break;
-	}
-      }
+    if(arg->p && (i = m_config_find_alias(config, arg->p))) {
+      // So we don't save the same vars more than 1 time
+      co->slots = i->slots;
+      co->flags |= M_CFG_OPT_ALIAS;
     }
     if(!(co->flags & M_CFG_OPT_ALIAS)) {
     // Allocate a slot for the defaults
@@ -359,10 +463,23 @@ m_config_add_option(m_config_t *config, const m_option_t *arg, const char* prefi
     co->slots->prev = sl;
     co->slots->lvl = config->lvl;
     m_option_copy(co->opt,co->slots->data,sl->data);
+    // Options registered inside a pushed level get their defaults
+    // back when it is popped.
+    if(config->lvl > 1)
+      m_config_track_slot(config, co, co->slots);
     } // !M_OPT_ALIAS
   }
   co->next = config->opts;
   config->opts = co;
+  co->seq = config->num_opts++;
+  if(config->num_opts > config->hash_size)
+    m_config_grow_index(config);
+  else
+    m_config_index_option(config, co);
+  if(is_wildcard(co)) {
+    co->hash_next = config->wildcards;
+    config->wildcards = co;
+  }
 }
 
 int
@@ -381,25 +498,46 @@ m_config_register_options(m_config_t *config, const m_option_t *args) {
   return 1;
 }
 
+int
+m_config_register_runtime(m_config_t *config, const void *p) {
+  m_config_option_t *co = m_config_find_alias(config, p), **runtime;
+  int i;
+
+  if(!co)
+    return 0;
+  co = m_config_slot_owner(config, co);
+  for(i = 0 ; i < config->num_runtime ; i++)
+    if(config->runtime[i] == co)
+      return 1;
+  runtime = realloc(config->runtime, (config->num_runtime + 1) * sizeof(*runtime));
+  if(!runtime)
+    return 0;
+  config->runtime = runtime;
+  config->runtime[config->num_runtime++] = co;
+  return 1;
+}
+
 static m_config_option_t*
 m_config_get_co(const m_config_t *config, char *arg) {
-  m_config_option_t *co;
-
-  for(co = config->opts ; co ; co = co->next ) {
-    int l = strlen(co->name) - 1;
-    if((co->opt->type->flags & M_OPT_TYPE_ALLOW_WILDCARD) &&
-       (co->name[l] == '*')) {
-      if(av_strncasecmp(co->name,arg,l) == 0)
-	return co;
-    } else if(av_strcasecmp(co->name,arg) == 0)
-      return co;
-  }
-  return NULL;
+  m_config_option_t *co, *best = NULL;
+
+  // Of several matches the latest registered one wins, as it would
+  // come first in config->opts.
+  if(config->hash_size)
+    for(co = config->name_hash[m_option_hash_name(arg) & (config->hash_size - 1)] ; co ; co = co->hash_next)
+      if((!best || co->seq > best->seq) && av_strcasecmp(co->name,arg) == 0)
+        best = co;
+  for(co = config->wildcards ; co ; co = co->hash_next)
+    if((!best || co->seq > best->seq) &&
+       av_strncasecmp(co->name,arg,strlen(co->name) - 1) == 0)
+      best = co;
+  return best;
 }
 
 static int
-m_config_parse_option(const m_config_t *config, char *arg, char *param, int set) {
+m_config_parse_option(m_config_t *config, char *arg, char *param, int set) {
   m_config_option_t *co;
+  m_config_save_slot_t *slot = NULL;
   int r = 0;
 
 #ifdef MP_DEBUG
@@ -433,7 +571,7 @@ m_config_parse_option(const m_config_t *config, char *arg, char *param, int set)
   if(((config->mode == M_COMMAND_LINE_PRE_PARSE) &&
       !(co->opt->flags & M_OPT_PRE_PARSE)) ||
      ((config->mode != M_COMMAND_LINE_PRE_PARSE) &&
-      (co->opt->flags & M_OPT_PRE_PARSE) && (co->flags & M_CFG_OPT_SET)))
+      (co->opt->flags & M_OPT_PRE_PARSE) && m_config_is_set(config,co)))
     set = 0;
 
   // Option with children are a bit different to parse
@@ -467,15 +605,18 @@ m_config_parse_option(const m_config_t *config, char *arg, char *param, int set)
       free(lst[2*i+1]);
     }
     free(lst);
-  } else
-    r = m_option_parse(co->opt,arg,param,set ? co->slots->data : NULL,config->mode);
+  } else {
+    if(set)
+      slot = m_config_write_slot(config,co);
+    r = m_option_parse(co->opt,arg,param,slot ? slot->data : NULL,config->mode);
+  }
 
   // Parsing failed ?
   if(r < 0)
     return r;
   // Set the option
-  if(set) {
-    m_option_set(co->opt,co->opt->p,co->slots->data);
+  if(slot) {
+    m_option_set(co->opt,co->opt->p,slot->data);
     co->flags |= M_CFG_OPT_SET;
   }
 
@@ -489,9 +630,10 @@ m_config_set_option(m_config_t *config, char* arg, char* param) {
 }
 
 int
-m_config_check_option(const m_config_t *config, char *arg, char *param) {
+m_config_check_option(m_config_t *config, char *arg, char *param) {
   int r;
   mp_msg(MSGT_CFGPARSER, MSGL_DBG2,"Checking %s=%s\n",arg,param);
+  // Only checking never touches the save slots.
   r=m_config_parse_option(config,arg,param,0);
   if(r==M_OPT_MISSING_PARAM){
     mp_msg(MSGT_CFGPARSER, MSGL_ERR,MSGTR_MissingOptionParameter,arg);
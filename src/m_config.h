@@ -19,6 +19,8 @@
 #ifndef MPLAYER_M_CONFIG_H
 #define MPLAYER_M_CONFIG_H
 
+#include <stdint.h>
+
 /// \defgroup Config Config manager
 ///
 /// m_config provides an API to manipulate the config variables in MPlayer.
@@ -36,11 +38,20 @@ struct m_option;
 struct m_option_type;
 
 /// Config option save slot
+/** Slots are copy-on-write: an option only gets a slot at a level when
+ *  it is set at that level, so pushing a level only saves the few
+ *  \ref m_config::runtime options and popping it only restores the
+ *  options that changed.
+ */
 struct m_config_save_slot {
   /// Previous level slot.
   m_config_save_slot_t* prev;
   /// Level at which the save was made.
   int lvl;
+  /// Option the slot belongs to.
+  m_config_option_t* owner;
+  /// Next slot in m_config::changed.
+  m_config_save_slot_t* changed_next;
   // We have to store other datatypes in this as well,
   // so make sure we get properly aligned addresses.
   unsigned char data[0] __attribute__ ((aligned (8)));
@@ -49,6 +60,12 @@ struct m_config_save_slot {
 /// Config option
 struct m_config_option {
   m_config_option_t* next;
+  /// Next option in the same name hash bucket or in the wildcard list.
+  m_config_option_t* hash_next;
+  /// Next option in the same variable address hash bucket.
+  m_config_option_t* addr_next;
+  /// Registration order, later options shadow earlier ones of the same name.
+  unsigned int seq;
   /// Full name (ie option:subopt).
   char* name;
   /// Option description.
@@ -96,13 +113,35 @@ typedef struct m_config {
   int profile_depth;
   /// Options defined by the config itself.
   struct m_option* self_opts;
+  /// Index on the case folded full option names.
+  m_config_option_t** name_hash;
+  /// Index on the option variables, to find aliases.
+  m_config_option_t** addr_hash;
+  /// Options ending in a wildcard, they are matched by prefix.
+  m_config_option_t* wildcards;
+  /// Size of both hash tables, a power of 2.
+  unsigned int hash_size;
+  /// Number of registered options.
+  unsigned int num_opts;
+  /// Slots added above level 1, newest first, that is what to undo on pop.
+  m_config_save_slot_t* changed;
+  /// Options whose variable is also changed at runtime, outside the config.
+  /** They are saved on every push so popping the level reverts them. */
+  m_config_option_t** runtime;
+  /// Number of entries in \ref runtime.
+  int num_runtime;
+  /// Number of levels pushed so far, for -benchmark.
+  unsigned int num_pushes;
+  /// Time spent pushing and popping levels in nanoseconds, for -benchmark.
+  int64_t push_pop_time;
 } m_config_t;
 
 /// \defgroup ConfigOptionFlags Config option flags
 /// \ingroup Config
 ///@{
 
-/// Set if an option has been set at the current level.
+/// Set if an option has been set. Unless the option is global or nosave
+/// this only counts at the level of its top slot.
 #define M_CFG_OPT_SET    (1<<0)
 
 /// Set if another option already uses the same variable.
@@ -132,6 +171,16 @@ m_config_push(m_config_t* config);
 void
 m_config_pop(m_config_t* config);
 
+/// Declare an option variable that is also written at runtime.
+/** Such a variable can change without going through the config, e.g. from
+ *  a property, so it is saved on each push instead of when it is set.
+ *  \param config The config object.
+ *  \param p The variable, as used by a registered option.
+ *  \return 1 on success, 0 if no option uses \p p.
+ */
+int
+m_config_register_runtime(m_config_t *config, const void *p);
+
 /// Register some options to be used.
 /** \param config The config object.
  *  \param args An array of \ref m_option struct.
@@ -156,7 +205,7 @@ m_config_set_option(m_config_t *config, char* arg, char* param);
  *  \return See \ref OptionParserReturn.
  */
 int
-m_config_check_option(const m_config_t *config, char *arg, char *param);
+m_config_check_option(m_config_t *config, char *arg, char *param);
 
 /// Get the option matching the given name.
 /** \param config The config object.
@@ -57,6 +57,94 @@ const m_option_t* m_option_list_find(const m_option_t* list,const char* name) {
   return NULL;
 }
 
+unsigned int m_option_hash_name(const char* name) {
+  // FNV-1a on the lower cased name
+  unsigned int h = 2166136261U;
+  for( ; *name ; name++)
+    h = (h ^ av_tolower(*name)) * 16777619U;
+  return h;
+}
+
+struct m_option_index {
+  const m_option_t* list;
+  unsigned int mask;
+  int* bucket;    ///< first entry of each chain, -1 if empty
+  int* next;      ///< next entry in the same chain
+  int* wildcards; ///< wildcard entries in list order, -1 terminated
+};
+
+static int is_wildcard(const m_option_t* opt) {
+  int l = strlen(opt->name) - 1;
+  return (opt->type->flags & M_OPT_TYPE_ALLOW_WILDCARD) && l > 0 &&
+         opt->name[l] == '*';
+}
+
+m_option_index_t* m_option_index_new(const m_option_t* list) {
+  m_option_index_t* index;
+  unsigned int size = 4;
+  int i, n, w = 0;
+
+  for(n = 0 ; list[n].name ; n++)
+    /* NOTHING */;
+  while(size < 2 * n)
+    size *= 2;
+  index = calloc(1, sizeof(*index));
+  if(!index)
+    return NULL;
+  index->list = list;
+  index->mask = size - 1;
+  index->bucket = malloc(size * sizeof(int));
+  index->next = malloc((n + 1) * sizeof(int));
+  index->wildcards = malloc((n + 1) * sizeof(int));
+  if(!index->bucket || !index->next || !index->wildcards) {
+    m_option_index_free(index);
+    return NULL;
+  }
+  memset(index->bucket, -1, size * sizeof(int));
+  for(i = 0 ; i < n ; i++)
+    if(is_wildcard(&list[i]))
+      index->wildcards[w++] = i;
+  index->wildcards[w] = -1;
+  // insert backwards so the first of several equal names is found first
+  for(i = n - 1 ; i >= 0 ; i--) {
+    unsigned int h;
+    if(is_wildcard(&list[i]))
+      continue;
+    h = m_option_hash_name(list[i].name) & index->mask;
+    index->next[i] = index->bucket[h];
+    index->bucket[h] = i;
+  }
+  return index;
+}
+
+void m_option_index_free(m_option_index_t* index) {
+  if(!index)
+    return;
+  free(index->bucket);
+  free(index->next);
+  free(index->wildcards);
+  free(index);
+}
+
+const m_option_t* m_option_index_find(const m_option_index_t* index, const char* name) {
+  const m_option_t* list = index->list;
+  int i, best = -1;
+  const int* w;
+
+  for(i = index->bucket[m_option_hash_name(name) & index->mask] ; i >= 0 ; i = index->next[i])
+    if(av_strcasecmp(list[i].name,name) == 0) {
+      best = i;
+      break;
+    }
+  // a wildcard earlier in the list takes precedence, as in m_option_list_find()
+  for(w = index->wildcards ; *w >= 0 && (best < 0 || *w < best) ; w++)
+    if(av_strncasecmp(list[*w].name,name,strlen(list[*w].name) - 1) == 0) {
+      best = *w;
+      break;
+    }
+  return best >= 0 ? &list[best] : NULL;
+}
+
 // Default function that just does a memcpy
 
 static void copy_opt(const m_option_t* opt,void* dst,const void* src) {
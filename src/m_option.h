@@ -489,6 +489,21 @@ struct m_option {
  */
 const m_option_t* m_option_list_find(const m_option_t* list,const char* name);
 
+/// Case insensitive hash of an option name.
+/** \ingroup Options */
+unsigned int m_option_hash_name(const char* name);
+
+/// Hash index over a static option list.
+/** \ingroup Options
+ *  Gives the same results as \ref m_option_list_find, including wildcards,
+ *  without scanning the whole list. The list must not change afterwards.
+ */
+typedef struct m_option_index m_option_index_t;
+
+m_option_index_t* m_option_index_new(const m_option_t* list);
+void m_option_index_free(m_option_index_t* index);
+const m_option_t* m_option_index_find(const m_option_index_t* index, const char* name);
+
 /// Helper to parse options, see \ref m_option_type::parse.
 static inline int
 m_option_parse(const m_option_t* opt,const char *name, const char *param, void* dst, int src) {
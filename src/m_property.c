@@ -27,6 +27,7 @@
 #include <inttypes.h>
 #include <unistd.h>
 
+#include "libavutil/common.h"
 #include "libavutil/mem.h"
 #include "m_option.h"
 #include "m_property.h"
@@ -34,6 +35,25 @@
 #include "mpcommon.h"
 #include "help_mp.h"
 
+/// Property lists are static and searched on every access, so index each
+/// of them once.
+static const m_option_t* find_property(const m_option_t* prop_list,
+                                       const char* name) {
+    static struct {
+        const m_option_t* list;
+        m_option_index_t* index;
+    } cache[4];
+    int i;
+    for(i = 0; i < FF_ARRAY_ELEMS(cache) && cache[i].list; i++)
+        if(cache[i].list == prop_list)
+            return m_option_index_find(cache[i].index, name);
+    if(i == FF_ARRAY_ELEMS(cache) ||
+       !(cache[i].index = m_option_index_new(prop_list)))
+        return m_option_list_find(prop_list, name);
+    cache[i].list = prop_list;
+    return m_option_index_find(cache[i].index, name);
+}
+
 static int do_action(const m_option_t* prop_list, const char* name,
                      int action, void* arg, void *ctx) {
     const char* sep;
@@ -43,7 +63,7 @@ static int do_action(const m_option_t* prop_list, const char* name,
     if((sep = strchr(name,'/')) && sep[1]) {
         int len = sep-name;
         char *base = av_strndup(name, len);
-        prop = m_option_list_find(prop_list, base);
+        prop = find_property(prop_list, base);
         av_freep(&base);
         ka.key = sep+1;
         ka.action = action;
@@ -51,7 +71,7 @@ static int do_action(const m_option_t* prop_list, const char* name,
         action = M_PROPERTY_KEY_ACTION;
         arg = &ka;
     } else
-        prop = m_option_list_find(prop_list, name);
+        prop = find_property(prop_list, name);
     if(!prop) return M_PROPERTY_UNKNOWN;
     r = ((m_property_ctrl_f)prop->p)(prop,action,arg,ctx);
     if(action == M_PROPERTY_GET_TYPE && r < 0) {
@@ -27,6 +27,7 @@
 #include "libmpdemux/demuxer.h"
 #include "libmpdemux/stheader.h"
 #include "mixer.h"
+#include "mp_stats.h"
 #include "libvo/video_out.h"
 #include "sub/subreader.h"
 #include "libavutil/attributes.h"
@@ -95,7 +96,12 @@ typedef struct MPContext {
     // used to retry decoding after startup/seeking to compensate for codec delay
     int startup_decode_retry;
     // how long until we need to display the "current" frame
-    float time_frame;
+    double time_frame;
+
+    // precise seek: video frames and audio samples before these pts
+    // are decoded but not presented, MP_NOPTS_VALUE once reached
+    double hrseek_pts;
+    double hrseek_audio_pts;
 
     // AV sync: the next frame should be shown when the audio out has this
     // much (in seconds) buffered data left. Increased when more data is
@@ -118,6 +124,13 @@ typedef struct MPContext {
     int file_format;
 
     int was_paused;
+
+    // startup timing of the current file, in GetTimer() usecs
+    unsigned int startup_start;
+    unsigned int startup_open;
+    int startup_reported;
+
+    mp_stats_t stats;
 } MPContext;
 
 
@@ -19,10 +19,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
 
 #include "config.h"
 #include "libavutil/avstring.h"
+#include "libavutil/common.h"
 #include "osdep/getch2.h"
 
 #include <iconv.h>
@@ -38,6 +44,7 @@ int mp_msg_level_all = MSGL_STATUS;
 int verbose = 0;
 int mp_msg_color = 0;
 int mp_msg_module = 0;
+int mp_msg_async = 0;
 char *mp_msg_charset = NULL;
 // only used to simplify freeing get_term_charset
 // result, even when it was overwritten by command-line options.
@@ -86,8 +93,11 @@ void mp_msg_init(void){
     }
 }
 
+static void writer_stop(void);
+
 void mp_msg_uninit(void)
 {
+    writer_stop();
     if (old_charset) {
         free(old_charset);
         iconv_close(msgiconv);
@@ -183,25 +193,64 @@ static void print_msg_module(FILE* stream, int mod)
     fprintf(stream, ": ");
 }
 
-void mp_msg(int mod, int lev, const char *format, ... ){
-    va_list va;
-    va_start(va, format);
-    mp_msg_va(mod, lev, format, va);
-    va_end(va);
+// messages may come from several threads, the state below is shared
+static pthread_mutex_t print_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t printing_once = PTHREAD_ONCE_INIT;
+static pthread_key_t printing_key;  ///< set while the thread is in msg_print()
+
+// a thread that has hung or crashed while printing must not silence the rest
+#define PRINT_LOCK_TIMEOUT_MS 1000
+
+static void printing_key_create(void)
+{
+    pthread_key_create(&printing_key, NULL);
 }
 
-void mp_msg_va(int mod, int lev, const char *format, va_list va){
-    char tmp[MSGSIZE_MAX];
+/**
+ * \brief Take print_lock unless that would deadlock.
+ * A signal or crash handler can call mp_msg() while the thread it
+ * interrupted is printing, possibly holding the lock; it then prints
+ * without the lock. The mark is set before locking so that this also
+ * holds right around the lock operations.
+ * \return 1 if the lock was taken, 0 if not, -1 when re-entered
+ */
+static int print_lock_acquire(void)
+{
+    struct timespec ts;
+
+    pthread_once(&printing_once, printing_key_create);
+    if (pthread_getspecific(printing_key))
+        return -1;
+    pthread_setspecific(printing_key, &print_lock);
+    if (!pthread_mutex_trylock(&print_lock))
+        return 1;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec  += PRINT_LOCK_TIMEOUT_MS / 1000;
+    ts.tv_nsec += PRINT_LOCK_TIMEOUT_MS % 1000 * 1000000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+    return !pthread_mutex_timedlock(&print_lock, &ts);
+}
+
+static void print_lock_release(int locked)
+{
+    if (locked < 0)
+        return;
+    if (locked)
+        pthread_mutex_unlock(&print_lock);
+    pthread_setspecific(printing_key, NULL);
+}
+
+static void msg_print(int mod, int lev, char *tmp)
+{
     FILE *stream = lev <= MSGL_WARN ? stderr : stdout;
     static int header = 1;
     // indicates if last line printed was a status line
     static int statusline;
     size_t len;
-
-    if (!mp_msg_test(mod, lev)) return; // do not display
-    vsnprintf(tmp, MSGSIZE_MAX, format, va);
-    tmp[MSGSIZE_MAX-2] = '\n';
-    tmp[MSGSIZE_MAX-1] = 0;
+    int locked = print_lock_acquire();
 
     if (mp_msg_charset && av_strcasecmp(mp_msg_charset, "noconv")) {
       char tmp2[MSGSIZE_MAX];
@@ -247,4 +296,484 @@ void mp_msg_va(int mod, int lev, const char *format, va_list va){
     if (mp_msg_color)
         fprintf(stream, "\033[0m");
     fflush(stream);
+    print_lock_release(locked);
+}
+
+/* -msgasync
+ *
+ * Every thread that logs gets its own single-producer ring, so mp_msg()
+ * neither locks nor touches stdio: it appends the formatted text (or, for
+ * mp_trace(), only the format pointer and the arguments) and returns.
+ * A writer thread merges the rings by sequence number and does the charset
+ * conversion and the output. A message that does not fit is dropped and
+ * counted; fatal errors and errors wait until they have been written.
+ *
+ * A thread announces in its ring's pending field that it is about to take
+ * a sequence number before it takes one, and withdraws it once the record
+ * is published. The writer does not print a record while an older number
+ * may still be pending, so the output keeps the order of the calls. */
+
+#define RING_SIZE (1 << 16)
+#define WRITER_PERIOD_MS 20
+// how often the writer yields to a thread still publishing an older message
+#define WRITER_MAX_WAITS 1000
+#define NO_SEQ UINT64_MAX
+
+enum { REC_TEXT, REC_TRACE };
+
+typedef struct {
+    uint32_t size;      ///< whole record including this header, multiple of 8
+    uint8_t  kind;
+    uint8_t  mod;
+    uint8_t  lev;
+    uint64_t seq;       ///< global order of the messages of all threads
+} msg_rec_t;
+
+/* head and tail only ever grow and are only accessed with atomic operations,
+ * which also publish the record data to the other side. */
+typedef struct msg_ring {
+    struct msg_ring *next;
+    uint32_t         head;      ///< read position, only moved by the writer
+    uint32_t         tail;      ///< write position, only moved by the owner
+    unsigned         dropped;   ///< only changed by the owner
+    unsigned         reported;  ///< drops the writer already complained about
+    uint64_t         pending;   ///< lowest sequence number the owner may be writing, or NO_SEQ
+    int              orphan;    ///< owner exited, ring can be handed out again
+    volatile int     busy;      ///< owner is in msg_queue(), only used by the owner
+    unsigned char    buf[RING_SIZE];
+} msg_ring_t;
+
+#define LOAD(x) __sync_fetch_and_add(&(x), 0)
+
+static msg_ring_t *rings;   ///< protected by rings_lock, never shrinks
+static pthread_mutex_t rings_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t ring_key;
+static uint64_t msg_seq;
+static int queue_users;     ///< threads inside msg_queue(), rings are freed only at 0
+
+static pthread_once_t writer_once = PTHREAD_ONCE_INIT;
+static pthread_t writer_thread;
+static pthread_mutex_t writer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+static volatile int writer_running;
+static int writer_quit;
+static int writer_wake;
+static unsigned writer_rounds;
+
+static void ring_copy_in(msg_ring_t *r, uint32_t pos, const void *data, uint32_t len)
+{
+    uint32_t off = pos & (RING_SIZE - 1);
+    uint32_t first = FFMIN(len, RING_SIZE - off);
+    memcpy(r->buf + off, data, first);
+    memcpy(r->buf, (const char *)data + first, len - first);
+}
+
+static void ring_copy_out(msg_ring_t *r, uint32_t pos, void *data, uint32_t len)
+{
+    uint32_t off = pos & (RING_SIZE - 1);
+    uint32_t first = FFMIN(len, RING_SIZE - off);
+    memcpy(data, r->buf + off, first);
+    memcpy((char *)data + first, r->buf, len - first);
+}
+
+static void ring_orphan(void *r)
+{
+    pthread_mutex_lock(&rings_lock);
+    // the rings are gone once the writer stopped
+    if (rings)
+        ((msg_ring_t *)r)->orphan = 1;
+    pthread_mutex_unlock(&rings_lock);
+}
+
+static msg_ring_t *ring_register(void)
+{
+    msg_ring_t *r;
+
+    pthread_mutex_lock(&rings_lock);
+    for (r = rings; r; r = r->next)
+        if (r->orphan && LOAD(r->head) == LOAD(r->tail))
+            break;
+    if (r) {
+        r->orphan = 0;
+    } else if ((r = calloc(1, sizeof(*r)))) {
+        r->pending = NO_SEQ;
+        r->next = rings;
+        rings = r;
+    }
+    pthread_mutex_unlock(&rings_lock);
+    if (r)
+        pthread_setspecific(ring_key, r);
+    return r;
+}
+
+/// \return 0 if the ring is full and the message was dropped
+static int ring_push(msg_ring_t *r, int kind, int mod, int lev,
+                     const void *data, uint32_t len)
+{
+    msg_rec_t rec;
+    uint32_t tail = LOAD(r->tail);
+    uint32_t used = tail - LOAD(r->head);
+    uint32_t size = (sizeof(rec) + len + 7) & ~7;
+
+    if (size > RING_SIZE - used) {
+        __sync_add_and_fetch(&r->dropped, 1);
+        return 0;
+    }
+    memset(&rec, 0, sizeof(rec));
+    rec.size = size;
+    rec.kind = kind;
+    rec.mod  = mod;
+    rec.lev  = lev;
+    // announced before it is taken, so the number can only be higher
+    __sync_lock_test_and_set(&r->pending, LOAD(msg_seq));
+    rec.seq  = __sync_fetch_and_add(&msg_seq, 1);
+    ring_copy_in(r, tail, &rec, sizeof(rec));
+    ring_copy_in(r, tail + sizeof(rec), data, len);
+    __sync_add_and_fetch(&r->tail, size);
+    __sync_lock_test_and_set(&r->pending, NO_SEQ);
+    // do not wait for the next period when filling up fast
+    if (used < RING_SIZE / 2 && used + size >= RING_SIZE / 2)
+        pthread_cond_signal(&wake_cond);
+    return 1;
+}
+
+static void trace_format(char *tmp, const mp_trace_t *t)
+{
+    const int64_t *a = t->args;
+    snprintf(tmp, MSGSIZE_MAX, t->format, a[0], a[1], a[2], a[3], a[4], a[5]);
+    tmp[MSGSIZE_MAX-2] = '\n';
+    tmp[MSGSIZE_MAX-1] = 0;
+}
+
+static msg_ring_t *rings_first(void)
+{
+    msg_ring_t *first;
+
+    pthread_mutex_lock(&rings_lock);
+    first = rings;
+    pthread_mutex_unlock(&rings_lock);
+    return first;
+}
+
+/// Find the ring whose next record has the lowest sequence number.
+static msg_ring_t *ring_oldest(msg_ring_t *first, msg_rec_t *rec)
+{
+    msg_ring_t *best = NULL, *r;
+    msg_rec_t cur;
+
+    for (r = first; r; r = r->next) {
+        uint32_t head = LOAD(r->head);
+        if (head == LOAD(r->tail))
+            continue;
+        ring_copy_out(r, head, &cur, sizeof(cur));
+        if (!best || cur.seq < rec->seq) {
+            best = r;
+            *rec = cur;
+        }
+    }
+    return best;
+}
+
+/// \return 1 if some thread may still be publishing a message older than seq
+static int seq_pending(msg_ring_t *first, uint64_t seq)
+{
+    msg_ring_t *r;
+
+    for (r = first; r; r = r->next)
+        if (LOAD(r->pending) <= seq)
+            return 1;
+    return 0;
+}
+
+/// Write out everything queued, oldest message first.
+static void writer_drain(void)
+{
+    char tmp[MSGSIZE_MAX];
+    msg_ring_t *first, *r, *best;
+    msg_rec_t rec, best_rec;
+    int waits = 0;
+
+    for (;;) {
+        uint32_t head;
+
+        best = ring_oldest(rings_first(), &best_rec);
+        if (!best)
+            break;
+        // A message with a lower number than the oldest one found can only
+        // be missing if its thread still announces it as pending, or if it
+        // was published after the scan. Both checks use a list read after
+        // the scan, so a thread registered since can only log newer ones.
+        first = rings_first();
+        if (seq_pending(first, best_rec.seq)) {
+            if (++waits > WRITER_MAX_WAITS)
+                break;
+            sched_yield();
+            continue;
+        }
+        if (ring_oldest(first, &rec) != best || rec.seq != best_rec.seq)
+            continue;
+
+        head = LOAD(best->head) + sizeof(rec);
+        if (best_rec.kind == REC_TRACE) {
+            mp_trace_t t;
+            ring_copy_out(best, head, &t, sizeof(t));
+            trace_format(tmp, &t);
+        } else {
+            uint32_t len = FFMIN(best_rec.size - sizeof(rec), MSGSIZE_MAX);
+            ring_copy_out(best, head, tmp, len);
+            tmp[MSGSIZE_MAX-1] = 0;
+        }
+        __sync_add_and_fetch(&best->head, best_rec.size);
+        msg_print(best_rec.mod, best_rec.lev, tmp);
+    }
+
+    for (r = rings_first(); r; r = r->next) {
+        unsigned dropped = LOAD(r->dropped);
+        if (dropped != r->reported) {
+            snprintf(tmp, MSGSIZE_MAX, "[msgasync] %u messages dropped\n",
+                     dropped - r->reported);
+            msg_print(MSGT_GLOBAL, MSGL_WARN, tmp);
+            r->reported = dropped;
+        }
+    }
+}
+
+static void *writer_loop(void *arg)
+{
+    pthread_mutex_lock(&writer_lock);
+    for (;;) {
+        int quit = writer_quit;
+        pthread_mutex_unlock(&writer_lock);
+        writer_drain();
+        pthread_mutex_lock(&writer_lock);
+        writer_rounds++;
+        pthread_cond_broadcast(&done_cond);
+        if (quit)
+            break;
+        if (!writer_wake && !writer_quit) {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_nsec += WRITER_PERIOD_MS * 1000000;
+            if (ts.tv_nsec >= 1000000000) {
+                ts.tv_sec++;
+                ts.tv_nsec -= 1000000000;
+            }
+            pthread_cond_timedwait(&wake_cond, &writer_lock, &ts);
+        }
+        writer_wake = 0;
+    }
+    pthread_mutex_unlock(&writer_lock);
+    return NULL;
+}
+
+// must not log, it runs under pthread_once() from msg_queue()
+static void writer_start(void)
+{
+    if (pthread_key_create(&ring_key, ring_orphan))
+        return;
+    if (pthread_create(&writer_thread, NULL, writer_loop, NULL))
+        return;
+    writer_running = 1;
+    // messages printed right before a plain exit() must not get lost
+    atexit(writer_stop);
+}
+
+static void writer_stop(void)
+{
+    msg_ring_t *r;
+    int i;
+
+    pthread_mutex_lock(&writer_lock);
+    if (!writer_running) {
+        pthread_mutex_unlock(&writer_lock);
+        return;
+    }
+    writer_running = 0;
+    writer_quit = 1;
+    pthread_cond_signal(&wake_cond);
+    pthread_mutex_unlock(&writer_lock);
+    pthread_join(writer_thread, NULL);
+
+    // Threads still inside msg_queue() may be writing to their ring. The
+    // rings are leaked if one does not leave, which is also the case when
+    // a signal handler interrupted this thread in there on its way to exit.
+    for (i = 0; LOAD(queue_users) && i < 100; i++)
+        usleep(1000);
+    if (LOAD(queue_users))
+        return;
+    pthread_mutex_lock(&rings_lock);
+    while ((r = rings)) {
+        rings = r->next;
+        free(r);
+    }
+    pthread_mutex_unlock(&rings_lock);
+}
+
+void mp_msg_flush(void)
+{
+    unsigned target;
+
+    if (!writer_running)
+        return;
+    pthread_mutex_lock(&writer_lock);
+    // the round in progress may have missed what was queued last
+    target = writer_rounds + 2;
+    writer_wake = 1;
+    pthread_cond_signal(&wake_cond);
+    while ((int)(writer_rounds - target) < 0 && !writer_quit)
+        pthread_cond_wait(&done_cond, &writer_lock);
+    pthread_mutex_unlock(&writer_lock);
+}
+
+/// \return 0 if the message must be printed synchronously
+static int msg_queue(int kind, int mod, int lev, const void *data, uint32_t len)
+{
+    msg_ring_t *r;
+
+    int queued = 0;
+
+    pthread_once(&writer_once, writer_start);
+    // counted before writer_running is checked, so that writer_stop()
+    // sees this thread and does not free its ring underneath it
+    __sync_add_and_fetch(&queue_users, 1);
+    if (!writer_running)
+        goto out;
+    // a crash in the writer cannot wait for the writer
+    if (pthread_equal(pthread_self(), writer_thread))
+        goto out;
+    r = pthread_getspecific(ring_key);
+    if (!r && !(r = ring_register()))
+        goto out;
+    // a signal handler interrupted this thread in here, possibly with
+    // the ring half written or writer_lock held
+    if (r->busy)
+        goto out;
+    r->busy = 1;
+    if (ring_push(r, kind, mod, lev, data, len) && lev <= MSGL_ERR)
+        mp_msg_flush();
+    r->busy = 0;
+    queued = 1;
+out:
+    __sync_sub_and_fetch(&queue_users, 1);
+    return queued;
+}
+
+/* Messages of a thread working in the background are held back until the
+ * thread that started it takes over its result and replays them. */
+
+struct mp_msg_capture {
+    char  *buf;     ///< records: module, level, text up to and with its '\0'
+    size_t len;
+    size_t size;
+};
+
+static pthread_once_t capture_once = PTHREAD_ONCE_INIT;
+static pthread_key_t capture_key;
+
+static void capture_key_create(void)
+{
+    pthread_key_create(&capture_key, NULL);
+}
+
+static struct mp_msg_capture *capture_get(void)
+{
+    pthread_once(&capture_once, capture_key_create);
+    return pthread_getspecific(capture_key);
+}
+
+static void capture_add(struct mp_msg_capture *c, int mod, int lev, const char *tmp)
+{
+    size_t len = strlen(tmp) + 1;
+
+    if (c->len + 2 + len > c->size) {
+        size_t size = FFMAX(2 * c->size, c->len + 2 + len);
+        char *buf = realloc(c->buf, size);
+        if (!buf)
+            return;
+        c->buf  = buf;
+        c->size = size;
+    }
+    c->buf[c->len++] = mod;
+    c->buf[c->len++] = lev;
+    memcpy(c->buf + c->len, tmp, len);
+    c->len += len;
+}
+
+void mp_msg_capture_begin(void)
+{
+    if (!capture_get())
+        pthread_setspecific(capture_key, calloc(1, sizeof(struct mp_msg_capture)));
+}
+
+struct mp_msg_capture *mp_msg_capture_end(void)
+{
+    struct mp_msg_capture *c = capture_get();
+    pthread_setspecific(capture_key, NULL);
+    return c;
+}
+
+void mp_msg_capture_replay(struct mp_msg_capture *c)
+{
+    size_t pos = 0;
+
+    if (!c)
+        return;
+    while (pos < c->len) {
+        int mod = (unsigned char)c->buf[pos];
+        int lev = (unsigned char)c->buf[pos + 1];
+        const char *text = c->buf + pos + 2;
+        mp_msg(mod, lev, "%s", text);
+        pos += 2 + strlen(text) + 1;
+    }
+    mp_msg_capture_free(c);
+}
+
+void mp_msg_capture_free(struct mp_msg_capture *c)
+{
+    if (c)
+        free(c->buf);
+    free(c);
+}
+
+void mp_msg(int mod, int lev, const char *format, ... ){
+    va_list va;
+    va_start(va, format);
+    mp_msg_va(mod, lev, format, va);
+    va_end(va);
+}
+
+void mp_msg_va(int mod, int lev, const char *format, va_list va){
+    char tmp[MSGSIZE_MAX];
+    struct mp_msg_capture *c;
+
+    if (!mp_msg_test(mod, lev)) return; // do not display
+    vsnprintf(tmp, MSGSIZE_MAX, format, va);
+    tmp[MSGSIZE_MAX-2] = '\n';
+    tmp[MSGSIZE_MAX-1] = 0;
+
+    if ((c = capture_get())) {
+        capture_add(c, mod, lev, tmp);
+        return;
+    }
+    if (mp_msg_async && msg_queue(REC_TEXT, mod, lev, tmp, strlen(tmp) + 1))
+        return;
+    msg_print(mod, lev, tmp);
+}
+
+void mp_msg_trace(int mod, int lev, const mp_trace_t *t)
+{
+    char tmp[MSGSIZE_MAX];
+    struct mp_msg_capture *c;
+
+    if (!mp_msg_test(mod, lev))
+        return;
+    c = capture_get();
+    if (!c && mp_msg_async && msg_queue(REC_TRACE, mod, lev, t, sizeof(*t)))
+        return;
+    trace_format(tmp, t);
+    if (c)
+        capture_add(c, mod, lev, tmp);
+    else
+        msg_print(mod, lev, tmp);
 }
@@ -20,6 +20,7 @@
 #define MPLAYER_MP_MSG_H
 
 #include <stdarg.h>
+#include <stdint.h>
 
 // defined in mplayer.c and mencoder.c
 extern int verbose;
@@ -132,6 +133,7 @@ extern int verbose;
 extern char *mp_msg_charset;
 extern int mp_msg_color;
 extern int mp_msg_module;
+extern int mp_msg_async;
 
 extern int mp_msg_levels[MSGT_MAX];
 extern int mp_msg_level_all;
@@ -140,6 +142,18 @@ extern int mp_msg_level_all;
 void mp_msg_init(void);
 void mp_msg_uninit(void);
 int mp_msg_test(int mod, int lev);
+/** \brief Wait until everything logged so far has been written out. */
+void mp_msg_flush(void);
+
+/* Hold back the messages of the calling thread, for work done in the
+ * background that should only be reported once its result is used. */
+struct mp_msg_capture;
+void mp_msg_capture_begin(void);
+/** \brief Stop holding back, returns what was logged since begin. */
+struct mp_msg_capture *mp_msg_capture_end(void);
+/** \brief Print the messages from the current thread and free them. */
+void mp_msg_capture_replay(struct mp_msg_capture *c);
+void mp_msg_capture_free(struct mp_msg_capture *c);
 
 #include "config.h"
 
@@ -152,6 +166,32 @@ void mp_msg(int mod, int lev, const char *format, ... ) __attribute__ ((format (
 #      define mp_dbg(mod,lev, args... ) do { if (0) mp_msg(mod, lev, ## args ); } while (0)
 #   endif
 
+/* Hot-path debug messages: only the format pointer and the arguments are
+ * stored, the message is formatted by the -msgasync writer thread.
+ * The format must be a string literal taking only int64_t arguments
+ * (PRId64/PRIx64), at most MP_TRACE_ARGS of them. */
+#define MP_TRACE_ARGS 6
+
+typedef struct mp_trace {
+    const char *format;
+    int64_t     args[MP_TRACE_ARGS];  ///< unused ones are 0
+} mp_trace_t;
+
+void mp_msg_trace(int mod, int lev, const mp_trace_t *t);
+
+/// never called, only lets the compiler check the format against the arguments
+static inline void __attribute__ ((format (printf, 1, 2)))
+mp_trace_check(const char *format, ...) {}
+
+// the format and the arguments initialize an mp_trace_t in order
+#define mp_trace(mod, lev, ...) \
+    do { \
+        if (0) \
+            mp_trace_check(__VA_ARGS__); \
+        if (mp_msg_test(mod, lev)) \
+            mp_msg_trace(mod, lev, &(const mp_trace_t){ __VA_ARGS__ }); \
+    } while (0)
+
 const char* filename_recode(const char* filename);
 
 #endif /* MPLAYER_MP_MSG_H */
@@ -0,0 +1,69 @@
+/*
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPLAYER_MP_STATS_H
+#define MPLAYER_MP_STATS_H
+
+/* Playback statistics.
+ *
+ * The player publishes them once per frame, which is only a handful of
+ * stores. The status line, properties and the IPC socket take a snapshot
+ * whenever they need one, at their own rate. Updates are bracketed by a
+ * sequence counter, so a snapshot can be taken from any thread without a
+ * lock: the reader just retries if an update was in progress. */
+
+typedef struct mp_stats {
+    volatile unsigned seq;  ///< odd while an update is in progress
+    double a_pos;           ///< audio position as shown to the user
+    double v_pos;           ///< video position
+    double av_drift;        ///< last A-V desynchronization
+    double av_corr;         ///< total A-V correction applied
+    int    frames;          ///< frames shown
+    int    frames_decoded;
+    int    drops;           ///< frames dropped
+    double video_time;      ///< seconds spent in the video decoder
+    double vout_time;       ///< seconds spent in the video output
+    double audio_time;      ///< seconds spent decoding audio
+    double clock;           ///< playback time the *_time values relate to
+} mp_stats_t;
+
+static inline void mp_stats_begin(mp_stats_t *s)
+{
+    s->seq++;
+    __sync_synchronize();
+}
+
+static inline void mp_stats_end(mp_stats_t *s)
+{
+    __sync_synchronize();
+    s->seq++;
+}
+
+static inline void mp_stats_get(const mp_stats_t *s, mp_stats_t *out)
+{
+    unsigned seq;
+    do {
+        while ((seq = s->seq) & 1)
+            ;
+        __sync_synchronize();
+        *out = *s;
+        __sync_synchronize();
+    } while (s->seq != seq);
+}
+
+#endif /* MPLAYER_MP_STATS_H */
@@ -17,6 +17,8 @@
  */
 
 #include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
 #include "stream/stream.h"
 #include "libmpdemux/demuxer.h"
 #include "libmpdemux/stheader.h"
@@ -250,7 +252,8 @@ void common_preinit(int *argc_ptr, char **argv_ptr[])
     (void)argv_ptr;
     sanitize_os();
     InitTimer();
-    srand(GetTimerMS());
+    // the monotonic clock restarts at boot, -shuffle would repeat itself
+    srand(time(NULL) ^ getpid() ^ GetTimerNS());
 
     mp_msg_init();
 }
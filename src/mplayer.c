@@ -21,6 +21,8 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <math.h>
+#include <pthread.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -54,10 +56,12 @@
 #include "stream/cache2.h"
 #include "stream/stream.h"
 #include "access_mpcontext.h"
+#include "av_helpers.h"
 #include "cfg-mplayer-def.h"
 #include "codec-cfg.h"
 #include "command.h"
 #include "help_mp.h"
+#include "ipc.h"
 #include "m_config.h"
 #include "m_option.h"
 #include "m_property.h"
@@ -101,17 +105,27 @@ static MPContext mpctx_s = {
     .set_of_sub_pos = -1,
     .file_format    = DEMUXER_TYPE_UNKNOWN,
     .loop_times     = -1,
+    .hrseek_pts     = MP_NOPTS_VALUE,
+    .hrseek_audio_pts = MP_NOPTS_VALUE,
 };
 
 static MPContext *mpctx = &mpctx_s;
 
 int fixed_vo;
+// open the audio codec on a separate thread while the video codec is opened
+int parallel_init = 1;
+// keep the AO/VO across playlist entries and open the next entry early
+int gapless_playback;
+// how many of the following playlist entries are read ahead, 0 disables
+int prefetch_entries = 8;
 
 // benchmark:
 double video_time_usage;
 double vout_time_usage;
 static double audio_time_usage;
-static int total_time_usage_start;
+static double audio_out_seconds;  // audio played, for decode+filter throughput
+static double audio_out_samples;
+static int64_t total_time_usage_start;
 static int total_frame_cnt;
 static int drop_frame_cnt; // total number of dropped frames
 int benchmark;
@@ -126,13 +140,15 @@ int use_gui;
 static int list_properties;
 
 int osd_level = 1;
-// if nonzero, hide current OSD contents when GetTimerMS() reaches this
-unsigned int osd_visible;
+// if nonzero, hide current OSD contents when GetTimerNS() reaches this
+int64_t osd_visible;
 int osd_duration = 1000;
 int osd_fractions; // determines how fractions of seconds are displayed
                    // on OSD
 
 int term_osd = 1;
+// minimum time between two status lines, in ms
+int status_interval = 100;
 static char *term_osd_esc = "\x1b[A\r\x1b[K";
 static char *playing_msg;
 // seek:
@@ -140,6 +156,7 @@ static double seek_to_sec = MP_NOPTS_VALUE;
 static off_t seek_to_byte;
 static off_t step_sec;
 static int loop_seek;
+static int hr_seek; // decode to the exact seek target
 
 static m_time_size_t end_at = { .type = END_AT_NONE, .pos = 0 };
 
@@ -182,6 +199,7 @@ float audio_delay;
 static int ignore_start;
 
 static int softsleep;
+static int display_sync = 1;
 
 double force_fps;
 static int force_srate;
@@ -448,6 +466,314 @@ static void print_file_properties(const MPContext *mpctx, const char *filename)
     }
 }
 
+// how long before the end of the current file the next one is opened
+#define PRELOAD_SECS 5.0
+
+typedef struct preload {
+    pthread_t thread;
+    int running;          ///< thread was started and not yet joined
+    int done;             ///< preloading already tried for the current file
+    char *filename;
+    stream_t *stream;
+    demuxer_t *demuxer;
+    int file_format;
+    play_tree_t *playlist;  ///< parsed entries if the file is a playlist
+    struct mp_msg_capture *msgs;  ///< shown when the file is taken over
+    struct mp_msg_capture *playlist_msgs;  ///< output of parse_playtree()
+} preload_t;
+
+static preload_t preload;
+
+/// Set when goto_next_file kept the AO open for the next entry.
+static int gapless_ao_kept;
+
+static void preload_open(preload_t *p)
+{
+    sh_audio_t *sh_audio;
+
+    p->stream = open_stream(p->filename, 0, &p->file_format);
+    if (!p->stream)
+        return;
+    if (p->file_format == DEMUXER_TYPE_PLAYLIST)
+        return;
+    p->demuxer = demux_open(p->stream, p->file_format, audio_id, video_id,
+                            sub_id, p->filename);
+    if (!p->demuxer || p->demuxer->type == DEMUXER_TYPE_PLAYLIST) {
+        if (p->demuxer)
+            free_demuxer(p->demuxer);
+        free_stream(p->stream);
+        p->demuxer = NULL;
+        p->stream  = NULL;
+        return;
+    }
+    select_video(p->demuxer, video_id);
+    select_audio(p->demuxer, audio_id, audio_lang);
+    demux_control(p->demuxer, DEMUXER_CTRL_LOAD_CODECDATA, NULL);
+    // The video decoder shares the filter chain and VO with the file
+    // still playing, so only the audio side is opened in advance.
+    sh_audio = p->demuxer->audio->sh;
+    if (sh_audio && !init_best_audio_codec(sh_audio, audio_codec_list,
+                                           audio_fm_list)) {
+        p->demuxer->audio->sh = NULL;
+        p->demuxer->audio->id = -2;
+    }
+}
+
+static void *preload_thread(void *arg)
+{
+    preload_t *p = arg;
+
+    // the current file is still playing, its output must not be mixed
+    // with that of a file that may never be played
+    mp_msg_capture_begin();
+    preload_open(p);
+    p->msgs = mp_msg_capture_end();
+    if (p->stream && p->file_format == DEMUXER_TYPE_PLAYLIST) {
+        // long nested playlists would otherwise be parsed while
+        // switching to them; the parser output is kept apart so it can
+        // follow the "Parsing playlist" message as it does otherwise
+        mp_msg_capture_begin();
+        if (allow_playlist_parsing)
+            p->playlist = parse_playtree(p->stream, use_gui);
+        p->playlist_msgs = mp_msg_capture_end();
+        if (!p->playlist) {
+            free_stream(p->stream);
+            p->stream = NULL;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Wait for the preload thread and release whatever it opened.
+ */
+static void preload_discard(void)
+{
+    if (preload.running)
+        pthread_join(preload.thread, NULL);
+    preload.running = 0;
+    if (preload.demuxer) {
+        if (preload.demuxer->audio->sh)
+            uninit_audio(preload.demuxer->audio->sh);
+        free_demuxer(preload.demuxer);
+    }
+    if (preload.stream)
+        free_stream(preload.stream);
+    if (preload.playlist)
+        play_tree_free(preload.playlist, 1);
+    mp_msg_capture_free(preload.msgs);
+    mp_msg_capture_free(preload.playlist_msgs);
+    preload.demuxer  = NULL;
+    preload.stream   = NULL;
+    preload.playlist = NULL;
+    preload.msgs     = NULL;
+    preload.playlist_msgs = NULL;
+    free(preload.filename);
+    preload.filename = NULL;
+}
+
+/**
+ * @brief Take over the preloaded stream and demuxer if they are for
+ * \p name, otherwise drop them.
+ * @param playlist set to the parsed entries if the file is a playlist
+ * @param playlist_msgs set to what parsing the playlist logged, for the
+ *                      caller to replay with mp_msg_capture_replay()
+ * @return 1 if mpctx->stream and mpctx->demuxer (or *playlist) were set up
+ */
+static int preload_take(const char *name, play_tree_t **playlist,
+                        struct mp_msg_capture **playlist_msgs)
+{
+    int taken = 0;
+    if (preload.running) {
+        pthread_join(preload.thread, NULL);
+        preload.running = 0;
+    }
+    if ((preload.demuxer || preload.playlist) && name &&
+        !strcmp(preload.filename, name)) {
+        mpctx->stream      = preload.stream;
+        mpctx->demuxer     = preload.demuxer;
+        mpctx->file_format = preload.file_format;
+        *playlist          = preload.playlist;
+        *playlist_msgs     = preload.playlist_msgs;
+        preload.stream     = NULL;
+        preload.demuxer    = NULL;
+        preload.playlist   = NULL;
+        preload.playlist_msgs = NULL;
+        mp_msg_capture_replay(preload.msgs);
+        preload.msgs       = NULL;
+        taken = 1;
+    }
+    preload_discard();
+    preload.done = 0;
+    return taken;
+}
+
+/* A few worker threads read the start and the end of the files that may be
+ * played next, where demuxers probe the container and look for the
+ * duration. Opening them then hits the page cache instead of a slow or
+ * spun-down disk, also when stepping through the playlist or shuffling.
+ * Only the data is fetched: demuxers share global option state and are
+ * opened on the main thread, or by the gapless preload for the next file. */
+
+#define PREFETCH_THREADS 2
+#define PREFETCH_MAX     64
+// read at each end of a file
+#define PREFETCH_BYTES   (512 * 1024)
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_t thread[PREFETCH_THREADS];
+    int num_threads;
+    volatile int quit;
+    char *queue[PREFETCH_MAX];  ///< next file first
+    int num_queued;
+} prefetch = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+};
+
+static void prefetch_read(int fd, off_t pos, unsigned char *buf, int size)
+{
+    int left = PREFETCH_BYTES;
+
+    if (lseek(fd, pos, SEEK_SET) < 0)
+        return;
+    while (left > 0 && !prefetch.quit) {
+        int len = read(fd, buf, FFMIN(left, size));
+        if (len <= 0)
+            break;
+        left -= len;
+    }
+}
+
+static void prefetch_file(const char *name, unsigned char *buf, int size)
+{
+    struct stat st;
+    int fd;
+
+    if (!strncmp(name, "file://", 7))
+        name += 7;
+    fd = open(name, O_RDONLY);
+    if (fd < 0)
+        return;
+    if (!fstat(fd, &st) && S_ISREG(st.st_mode)) {
+        prefetch_read(fd, 0, buf, size);
+        if (st.st_size > 2 * PREFETCH_BYTES)
+            prefetch_read(fd, st.st_size - PREFETCH_BYTES, buf, size);
+    }
+    close(fd);
+}
+
+static void *prefetch_thread(void *arg)
+{
+    const int size = 64 * 1024;
+    unsigned char *buf = malloc(size);
+
+    pthread_mutex_lock(&prefetch.lock);
+    while (buf && !prefetch.quit) {
+        char *name;
+        if (!prefetch.num_queued) {
+            pthread_cond_wait(&prefetch.wake, &prefetch.lock);
+            continue;
+        }
+        name = prefetch.queue[0];
+        prefetch.num_queued--;
+        memmove(prefetch.queue, prefetch.queue + 1,
+                prefetch.num_queued * sizeof(*prefetch.queue));
+        pthread_mutex_unlock(&prefetch.lock);
+        prefetch_file(name, buf, size);
+        free(name);
+        pthread_mutex_lock(&prefetch.lock);
+    }
+    pthread_mutex_unlock(&prefetch.lock);
+    free(buf);
+    return NULL;
+}
+
+/// Queue name for prefetching, called with prefetch.lock held.
+static void prefetch_add(const char *name)
+{
+    char *copy;
+    int i;
+
+    // devices, network streams and stdin are left alone
+    if (!name || prefetch.num_queued >= FFMIN(prefetch_entries, PREFETCH_MAX) ||
+        !strcmp(name, "-") || (strstr(name, "://") && strncmp(name, "file://", 7)))
+        return;
+    for (i = 0; i < prefetch.num_queued; i++)
+        if (!strcmp(prefetch.queue[i], name))
+            return;
+    if ((copy = strdup(name)))
+        prefetch.queue[prefetch.num_queued++] = copy;
+}
+
+/**
+ * @brief Replace the prefetch queue with the entries that may be played
+ * after the current one: the following ones in order, or under -shuffle
+ * those not played yet.
+ */
+static void prefetch_next_entries(void)
+{
+    play_tree_iter_t *iter = mpctx->playtree_iter;
+    play_tree_t *pt;
+    int i, n;
+
+    if (prefetch_entries <= 0 || !iter || !iter->tree)
+        return;
+
+    pthread_mutex_lock(&prefetch.lock);
+    for (i = 0; i < prefetch.num_queued; i++)
+        free(prefetch.queue[i]);
+    prefetch.num_queued = 0;
+
+    if (iter->tree->parent && (iter->tree->parent->flags & PLAY_TREE_RND)) {
+        // stepping would pick (and mark) the random entries
+        for (pt = iter->tree->parent->child; pt; pt = pt->next)
+            if (pt != iter->tree && pt->files &&
+                !(pt->flags & PLAY_TREE_RND_PLAYED))
+                for (i = 0; pt->files[i]; i++)
+                    prefetch_add(pt->files[i]);
+    } else if ((iter = play_tree_iter_new_copy(iter))) {
+        // bounded, a looping playlist would otherwise never end
+        for (n = 0; n < 2 * PREFETCH_MAX; n++) {
+            char *next = play_tree_iter_get_file(iter, 1);
+            if (!next) {
+                if (play_tree_iter_step(iter, 1, 0) != PLAY_TREE_ITER_ENTRY ||
+                    (iter->tree->parent &&
+                     (iter->tree->parent->flags & PLAY_TREE_RND)))
+                    break;
+                continue;
+            }
+            prefetch_add(next);
+        }
+        play_tree_iter_free(iter);
+    }
+
+    while (prefetch.num_queued && prefetch.num_threads < PREFETCH_THREADS &&
+           !pthread_create(&prefetch.thread[prefetch.num_threads], NULL,
+                           prefetch_thread, NULL))
+        prefetch.num_threads++;
+    pthread_cond_broadcast(&prefetch.wake);
+    pthread_mutex_unlock(&prefetch.lock);
+}
+
+static void prefetch_uninit(void)
+{
+    int i;
+
+    pthread_mutex_lock(&prefetch.lock);
+    prefetch.quit = 1;
+    pthread_cond_broadcast(&prefetch.wake);
+    pthread_mutex_unlock(&prefetch.lock);
+    for (i = 0; i < prefetch.num_threads; i++)
+        pthread_join(prefetch.thread[i], NULL);
+    prefetch.num_threads = 0;
+    for (i = 0; i < prefetch.num_queued; i++)
+        free(prefetch.queue[i]);
+    prefetch.num_queued = 0;
+}
+
 void uninit_player(unsigned int mask)
 {
     mask &= initialized_flags;
@@ -532,6 +858,7 @@ void uninit_player(unsigned int mask)
     if (mask & INITIALIZED_INPUT) {
         initialized_flags &= ~INITIALIZED_INPUT;
         current_module     = "uninit_input";
+        mp_ipc_uninit();
         mp_input_uninit();
     }
 
@@ -542,7 +869,11 @@ void exit_player_with_rc(enum exit_reason how, int rc)
 {
     if (mpctx->user_muted)
         mixer_mute(&mpctx->mixer);
+    preload_discard();
+    prefetch_uninit();
     uninit_player(INITIALIZED_ALL);
+    // outlives the per-file subtitle uninit so the next file can reuse it
+    sub_dir_cache_free();
 
     common_uninit();
 
@@ -555,6 +886,11 @@ void exit_player_with_rc(enum exit_reason how, int rc)
         play_tree_free(mpctx->playtree, 1);
     mpctx->playtree = NULL;
 
+    if (benchmark && mconfig && mconfig->num_pushes)
+        mp_msg(MSGT_CPLAYER, MSGL_INFO,
+               "BENCHMARKc: %u config levels pushed and popped in %.3f ms\n",
+               mconfig->num_pushes, mconfig->push_pop_time * 1e-6);
+
     switch (how) {
     case EXIT_QUIT:
         mp_msg(MSGT_CPLAYER, MSGL_INFO, MSGTR_ExitingHow, MSGTR_Exit_quit);
@@ -575,6 +911,7 @@ void exit_player_with_rc(enum exit_reason how, int rc)
 
     // must be last since e.g. mp_msg uses option values
     // that will be freed by this.
+    mp_msg_flush();
     if (mconfig)
         m_config_free(mconfig);
     mconfig = NULL;
@@ -600,9 +937,27 @@ static void child_sighandler(int x)
     signal(SIGCHLD, child_sighandler);
 }
 
+/// the worker of start_audio_codec_init(), only valid while running
+static pthread_t audio_init_thread;
+static int audio_init_running;
+static int audio_init_result;
+
+/**
+ * \brief What the calling thread is busy with, for crash reports.
+ * current_module belongs to the main thread, a crash in the audio codec
+ * init worker must not be blamed on whatever the main thread is doing.
+ */
+static const char *thread_module(void)
+{
+    if (audio_init_running && pthread_equal(pthread_self(), audio_init_thread))
+        return "init_audio_codec";
+    return current_module;
+}
+
 static void exit_sighandler(int x)
 {
     static int sig_count;
+    const char *module = thread_module();
 #ifdef CONFIG_CRASH_DEBUG
     if (!crash_debug || x != SIGTRAP)
 #endif
@@ -624,7 +979,7 @@ static void exit_sighandler(int x)
         kill(getpid(), SIGKILL);
     }
     mp_msg(MSGT_CPLAYER, MSGL_FATAL, "\n" MSGTR_IntBySignal, x,
-           current_module ? current_module : MSGTR_Unknown
+           module ? module : MSGTR_Unknown
            );
     mp_msg(MSGT_IDENTIFY, MSGL_INFO, "ID_SIGNAL=%d\n", x);
     if (sig_count <= 1)
@@ -699,19 +1054,28 @@ static void parse_cfgfiles(m_config_t *conf)
 
 #define PROFILE_CFG_PROTOCOL "protocol."
 
-static void load_per_protocol_config(m_config_t *conf, const char *const file)
+/// @return profile name for the protocol of \p file, to be freed with av_free
+static char *protocol_profile_name(const char *const file)
 {
-    char *str;
     char *protocol;
-    m_profile_t *p;
 
     /* does filename actually uses a protocol ? */
-    str = strstr(file, "://");
-    if (!str)
-        return;
+    if (!strstr(file, "://"))
+        return NULL;
 
     protocol = av_asprintf("%s%s", PROFILE_CFG_PROTOCOL, file);
     *strstr(protocol, "://") = 0;
+    return protocol;
+}
+
+static void load_per_protocol_config(m_config_t *conf, const char *const file)
+{
+    char *protocol;
+    m_profile_t *p;
+
+    protocol = protocol_profile_name(file);
+    if (!protocol)
+        return;
     p = m_config_get_profile(conf, protocol);
     if (p) {
         mp_msg(MSGT_CPLAYER, MSGL_INFO, MSGTR_LoadingProtocolProfile, protocol);
@@ -722,18 +1086,27 @@ static void load_per_protocol_config(m_config_t *conf, const char *const file)
 
 #define PROFILE_CFG_EXTENSION "extension."
 
-static void load_per_extension_config(m_config_t *conf, const char *const file)
+/// @return 0 if \p file has no extension, else its profile name is in \p buf
+static int extension_profile_name(const char *const file, char *buf, size_t size)
 {
     char *str;
-    char extension[sizeof(PROFILE_CFG_EXTENSION) + 7];
-    m_profile_t *p;
 
     /* does filename actually have an extension ? */
-    str = strrchr(filename, '.');
+    str = strrchr(file, '.');
     if (!str)
-        return;
+        return 0;
+
+    snprintf(buf, size, "%s%s", PROFILE_CFG_EXTENSION, ++str);
+    return 1;
+}
+
+static void load_per_extension_config(m_config_t *conf, const char *const file)
+{
+    char extension[sizeof(PROFILE_CFG_EXTENSION) + 7];
+    m_profile_t *p;
 
-    snprintf(extension, sizeof(extension), "%s%s", PROFILE_CFG_EXTENSION, ++str);
+    if (!extension_profile_name(file, extension, sizeof(extension)))
+        return;
     p = m_config_get_profile(conf, extension);
     if (p) {
         mp_msg(MSGT_CPLAYER, MSGL_INFO, MSGTR_LoadingExtensionProfile, extension);
@@ -759,6 +1132,7 @@ static void load_per_output_config(m_config_t *conf, char *cfg, char *out)
 
 /**
  * @brief Tries to load a config file.
+ * @param conf NULL to only check whether the file exists
  * @return 0 if file was not found, 1 otherwise
  */
 static int try_load_config(m_config_t *conf, const char *file)
@@ -766,20 +1140,28 @@ static int try_load_config(m_config_t *conf, const char *file)
     struct stat st;
     if (stat(file, &st))
         return 0;
+    if (!conf)
+        return 1;
     mp_msg(MSGT_CPLAYER, MSGL_INFO, MSGTR_LoadingConfig, file);
     m_config_parse_config_file(conf, file, 0);
     return 1;
 }
 
-static void load_per_file_config(m_config_t *conf, const char *const file)
+/**
+ * @param conf NULL to only check whether there is a config for \p file
+ * @return 1 if a config file was found
+ */
+static int load_per_file_config(m_config_t *conf, const char *const file)
 {
     char *confpath;
     char cfg[PATH_MAX];
     const char *name;
+    int found = 0;
 
     if (strlen(file) > PATH_MAX - 14) {
-        mp_msg(MSGT_CPLAYER, MSGL_WARN, MSGTR_FilenameTooLong);
-        return;
+        if (conf)
+            mp_msg(MSGT_CPLAYER, MSGL_WARN, MSGTR_FilenameTooLong);
+        return 0;
     }
     sprintf(cfg, "%s.conf", file);
 
@@ -788,17 +1170,18 @@ static void load_per_file_config(m_config_t *conf, const char *const file)
         char dircfg[PATH_MAX];
         strcpy(dircfg, cfg);
         strcpy(dircfg + (name - cfg), "mplayer.conf");
-        try_load_config(conf, dircfg);
+        found = try_load_config(conf, dircfg);
 
         if (try_load_config(conf, cfg))
-            return;
+            return 1;
     }
 
     if ((confpath = get_path(name)) != NULL) {
-        try_load_config(conf, confpath);
+        found |= try_load_config(conf, confpath);
 
         free(confpath);
     }
+    return found;
 }
 
 static int load_profile_config(m_config_t *conf, const char *const file)
@@ -812,6 +1195,68 @@ static int load_profile_config(m_config_t *conf, const char *const file)
     return file != NULL;
 }
 
+/**
+ * @brief Check whether load_profile_config() would set any option for \p file.
+ */
+static int has_profile_config(m_config_t *conf, const char *const file)
+{
+    char extension[sizeof(PROFILE_CFG_EXTENSION) + 7];
+    char *protocol = protocol_profile_name(file);
+    int found = protocol && m_config_get_profile(conf, protocol);
+
+    av_free(protocol);
+    if (!found && extension_profile_name(file, extension, sizeof(extension)))
+        found = !!m_config_get_profile(conf, extension);
+    return found || load_per_file_config(NULL, file);
+}
+
+/**
+ * @brief Start opening the next playlist entry once the current one is
+ * close to its end, so the switch does not have to wait for it.
+ */
+static void preload_next_file(void)
+{
+    play_tree_iter_t *iter;
+    char *next = NULL;
+    double len;
+
+    if (!gapless_playback || preload.done || !mpctx->playtree_iter ||
+        !mpctx->demuxer)
+        return;
+    // the cache reads the input queue to check for interruption,
+    // which is not safe from a second thread
+    if (stream_cache_size > 0 || seek_to_byte)
+        return;
+    len = demuxer_get_time_length(mpctx->demuxer);
+    if (len <= 0 || len - demuxer_get_current_time(mpctx->demuxer) > PRELOAD_SECS)
+        return;
+    preload.done = 1;
+
+    iter = mpctx->playtree_iter;
+    // shuffled playback picks (and marks) its next entry only when stepping
+    if (iter->tree->parent && (iter->tree->parent->flags & PLAY_TREE_RND))
+        return;
+    iter = play_tree_iter_new_copy(iter);
+    if (!iter)
+        return;
+    next = play_tree_iter_get_file(iter, 1);
+    // entries with their own options must be opened with those applied
+    if (!next && play_tree_iter_step(iter, 1, 0) == PLAY_TREE_ITER_ENTRY &&
+        !iter->tree->params)
+        next = play_tree_iter_get_file(iter, 1);
+    // so must files with a protocol, extension or per-file profile, which
+    // is only loaded when switching to them
+    if (next && has_profile_config(mconfig, next))
+        next = NULL;
+    if (next) {
+        mp_msg(MSGT_CPLAYER, MSGL_V, "Preloading %s\n", filename_recode(next));
+        preload.filename = strdup(next);
+        preload.running  = !pthread_create(&preload.thread, NULL,
+                                           preload_thread, &preload);
+    }
+    play_tree_iter_free(iter);
+}
+
 /* When libmpdemux performs a blocking operation (network connection or
  * cache filling) if the operation fails we use this function to check
  * if it was interrupted by the user.
@@ -957,31 +1402,51 @@ static void sadd_hhmmssf(char *buf, unsigned *pos, int len, float time)
 }
 
 /**
- * @brief Print the status line.
- * @param a_pos audio position
- * @param a_v A-V desynchronization
- * @param corr amount out A-V synchronization
+ * @brief Print how long each startup phase of the current file took.
+ * Shown once the first frame (or the first audio for audio-only files)
+ * has been output.
+ */
+static void print_startup_times(void)
+{
+    const unsigned int *t = mpctx->demuxer->startup_time;
+
+    mpctx->startup_reported = 1;
+    mp_msg(MSGT_CPLAYER, benchmark ? MSGL_INFO : MSGL_V,
+           "Startup: open %.1f ms, probe %.1f ms, header %.1f ms, "
+           "stream info %.1f ms, first packet %.1f ms, first frame %.1f ms\n",
+           mpctx->startup_open * 0.001,
+           t[DEMUX_STARTUP_PROBE] * 0.001,
+           t[DEMUX_STARTUP_HEADER] * 0.001,
+           t[DEMUX_STARTUP_STREAM_INFO] * 0.001,
+           t[DEMUX_STARTUP_FIRST_PACKET] * 0.001,
+           (GetTimer() - mpctx->startup_start) * 0.001);
+}
+
+/**
+ * @brief Print the status line from the current statistics.
  */
-static void print_status(float a_pos, float a_v, float corr)
+static void print_status(void)
 {
     sh_video_t *const sh_video = mpctx->sh_video;
+    char line[512];
     int width;
-    char *line;
     unsigned pos = 0;
+    mp_stats_t st;
+
+    mp_stats_get(&mpctx->stats, &st);
     get_screen_size();
     if (screen_width > 0)
-        width = screen_width;
+        width = FFMIN(screen_width, (int)sizeof(line) - 1);
     else
         width = 80;
-    line = malloc(width + 1); // one additional char for the terminating null
 
     // Audio time
     if (mpctx->sh_audio) {
-        saddf(line, &pos, width, "A:%6.1f ", a_pos);
+        saddf(line, &pos, width, "A:%6.1f ", st.a_pos);
         if (!sh_video) {
             float len = demuxer_get_time_length(mpctx->demuxer);
             saddf(line, &pos, width, "(");
-            sadd_hhmmssf(line, &pos, width, a_pos);
+            sadd_hhmmssf(line, &pos, width, st.a_pos);
             saddf(line, &pos, width, ") of %.1f (", len);
             sadd_hhmmssf(line, &pos, width, len);
             saddf(line, &pos, width, ") ");
@@ -990,38 +1455,36 @@ static void print_status(float a_pos, float a_v, float corr)
 
     // Video time
     if (sh_video)
-        saddf(line, &pos, width, "V:%6.1f ", sh_video->pts);
+        saddf(line, &pos, width, "V:%6.1f ", st.v_pos);
 
     // A-V sync
     if (mpctx->sh_audio && sh_video)
-        saddf(line, &pos, width, "A-V:%7.3f ct:%7.3f ", a_v, corr);
+        saddf(line, &pos, width, "A-V:%7.3f ct:%7.3f ", st.av_drift, st.av_corr);
 
     // Video stats
     if (sh_video)
-        saddf(line, &pos, width, "%3d/%3d ",
-              (int)sh_video->num_frames,
-              (int)sh_video->num_frames_decoded);
+        saddf(line, &pos, width, "%3d/%3d ", st.frames, st.frames_decoded);
 
     // CPU usage
     if (sh_video) {
-        if (sh_video->timer > 0.5)
+        if (st.clock > 0.5)
             saddf(line, &pos, width, "%2d%% %2d%% %4.1f%% ",
-                  (int)(100.0 * video_time_usage * playback_speed / (double)sh_video->timer),
-                  (int)(100.0 * vout_time_usage * playback_speed / (double)sh_video->timer),
-                  (100.0 * audio_time_usage * playback_speed / (double)sh_video->timer));
+                  (int)(100.0 * st.video_time * playback_speed / st.clock),
+                  (int)(100.0 * st.vout_time * playback_speed / st.clock),
+                  (100.0 * st.audio_time * playback_speed / st.clock));
         else
             saddf(line, &pos, width, "??%% ??%% ??,?%% ");
     } else if (mpctx->sh_audio) {
-        if (mpctx->delay > 0.5)
+        if (st.clock > 0.5)
             saddf(line, &pos, width, "%4.1f%% ",
-                  100.0 * audio_time_usage / (double)mpctx->delay);
+                  100.0 * st.audio_time / st.clock);
         else
             saddf(line, &pos, width, "??,?%% ");
     }
 
     // VO stats
     if (sh_video)
-        saddf(line, &pos, width, "%d ", drop_frame_cnt);
+        saddf(line, &pos, width, "%d ", st.drops);
 
     // cache stats
     if (stream_cache_size > 0)
@@ -1040,7 +1503,47 @@ static void print_status(float a_pos, float a_v, float corr)
         line[width] = 0;
         mp_msg(MSGT_STATUSLINE, MSGL_STATUS, "%s\r", line);
     }
-    free(line);
+}
+
+/**
+ * @brief Publish the statistics of the current frame, and print the
+ * status line if the last one is older than -status-interval.
+ * @param a_pos audio position
+ * @param a_v A-V desynchronization
+ * @param corr amount out A-V synchronization
+ */
+static void update_status(float a_pos, float a_v, float corr)
+{
+    static unsigned int last_status;
+    sh_video_t *const sh_video = mpctx->sh_video;
+    mp_stats_t *st = &mpctx->stats;
+    unsigned int now;
+
+    mp_stats_begin(st);
+    st->a_pos    = a_pos;
+    st->av_drift = a_v;
+    st->av_corr  = corr;
+    if (sh_video) {
+        st->v_pos          = sh_video->pts;
+        st->frames         = sh_video->num_frames;
+        st->frames_decoded = sh_video->num_frames_decoded;
+        st->clock          = sh_video->timer;
+    } else {
+        st->clock          = mpctx->delay;
+    }
+    st->drops      = drop_frame_cnt;
+    st->video_time = video_time_usage;
+    st->vout_time  = vout_time_usage;
+    st->audio_time = audio_time_usage;
+    mp_stats_end(st);
+
+    if (quiet || !mp_msg_test(MSGT_STATUSLINE, MSGL_STATUS))
+        return;
+    now = GetTimerMS();
+    if (status_interval && now - last_status < status_interval)
+        return;
+    last_status = now;
+    print_status();
 }
 
 /**
@@ -1171,15 +1674,13 @@ static void clear_osd_msgs(void)
 static mp_osd_msg_t *get_osd_msg(void)
 {
     mp_osd_msg_t *msg, *prev, *last = NULL;
-    static unsigned last_update;
-    unsigned now = GetTimerMS();
+    static int64_t last_update;
+    int64_t now = GetTimerNS();
     unsigned diff;
     char hidden_dec_done = 0;
 
     if (osd_visible) {
-        // 36000000 means max timed visibility is 1 hour into the future, if
-        // the difference is greater assume it's wrapped around from below 0
-        if (osd_visible - now > 36000000) {
+        if (osd_visible <= now) {
             osd_visible = 0;
             vo_osd_progbar_type = -1; // disable
             vo_osd_changed(OSDTYPE_PROGBAR);
@@ -1190,9 +1691,10 @@ static mp_osd_msg_t *get_osd_msg(void)
 
     if (!last_update)
         last_update = now;
-    diff = now >= last_update ? now - last_update : 0;
+    // keep the sub-millisecond remainder for the next call
+    diff = (now - last_update) / 1000000;
 
-    last_update = now;
+    last_update += diff * INT64_C(1000000);
 
     // Look for the first message in the stack with high enough level.
     for (msg = osd_msg_stack; msg; last = msg, msg = prev) {
@@ -1237,7 +1739,7 @@ void set_osd_bar(int type, const char *name, double min, double max, double val)
         return;
 
     if (mpctx->sh_video) {
-        osd_visible = (GetTimerMS() + osd_duration) | 1;
+        osd_visible = GetTimerNS() + osd_duration * INT64_C(1000000);
         vo_osd_progbar_type  = type;
         vo_osd_progbar_value = 256 * (val - min) / (max - min);
         vo_osd_changed(OSDTYPE_PROGBAR);
@@ -1381,6 +1883,23 @@ void reinit_audio_chain(void)
         mp_msg(MSGT_CPLAYER, MSGL_INFO, "==========================================================================\n");
     }
 
+    if (gapless_ao_kept && (initialized_flags & INITIALIZED_AO)) {
+        int srate = force_srate, channels = 0, format = audio_output_format;
+        current_module = "af_preinit";
+        if (init_audio_filters(mpctx->sh_audio, mpctx->sh_audio->samplerate,
+                               &srate, &channels, &format) &&
+            (srate != ao_data.samplerate || channels != ao_data.channels ||
+             format != ao_data.format)) {
+            mp_msg(MSGT_CPLAYER, MSGL_V, "Audio format changed, reopening audio output.\n");
+            // let the previous file play out before closing
+            mpctx->audio_out->uninit(0);
+            initialized_flags     &= ~INITIALIZED_AO;
+            mpctx->audio_out       = NULL;
+            mpctx->mixer.audio_out = NULL;
+        }
+    }
+    gapless_ao_kept = 0;
+
     if (!(initialized_flags & INITIALIZED_AO)) {
         current_module     = "af_preinit";
         ao_data.samplerate = force_srate;
@@ -1477,10 +1996,145 @@ static int is_at_end(MPContext *mpctx, m_time_size_t *end_at, double pts)
     return 0;
 }
 
+/// smoothed delay between flip_page() and the real flip, if the VO knows
+static float vo_flip_latency;
+
+/**
+ * Display locked frame scheduling, used when the VO reports page flips.
+ * Each frame is assigned to the vsync closest to its ideal display time
+ * and handed to the VO, together with that display time, half a refresh
+ * period before that vsync. The flips coming back carry their timestamp
+ * and the frame's display time, giving the refresh period and how late
+ * each frame really was; frames are dropped when they keep missing their
+ * vsync and repeat (stay on screen) when the next one is not due yet.
+ */
+static struct {
+    int active;             ///< refresh period is known
+    double period;          ///< refresh period in microseconds
+    int64_t vsync;          ///< GetMonotonicTimer() time of a seen vsync
+    unsigned int seq;       ///< vblank counter at that vsync
+    unsigned int count;     ///< flips seen so far
+    int64_t next_target;    ///< ideal display time of the frame being shown
+    double late_avg;        ///< smoothed lateness in microseconds
+    int drop;               ///< drop the next frame to catch up
+    unsigned int frames, late, dropped, repeated;
+    double late_sum, late_max;
+} vsync_sched;
+
+static void vsync_sched_reset(void)
+{
+    vsync_sched.next_target = 0;
+    vsync_sched.late_avg    = 0;
+    vsync_sched.drop        = 0;
+}
+
+/// Account for the flip that just completed, if any.
+static void vsync_sched_update(void)
+{
+    mp_flip_info_t flip;
+
+    vsync_sched.next_target = 0;
+    if (mpctx->video_out->control(VOCTRL_GET_FLIP_INFO, &flip) != VO_TRUE) {
+        vsync_sched.active = 0;
+        return;
+    }
+    vo_flip_latency = flip.latency > 50000 ? 0.05 : flip.latency * 0.000001;
+    if (flip.count == vsync_sched.count)
+        return;
+
+    if (vsync_sched.count && flip.sequence > vsync_sched.seq &&
+        flip.sequence - vsync_sched.seq <= 8) {
+        unsigned int vsyncs = flip.sequence - vsync_sched.seq;
+        double period = (double)(flip.flip_time - vsync_sched.vsync) / vsyncs;
+        // 20 to 240 Hz, anything else is a stall or a bogus counter
+        if (period > 4000 && period < 50000) {
+            vsync_sched.period = vsync_sched.active ?
+                                 0.95 * vsync_sched.period + 0.05 * period : period;
+            vsync_sched.active = 1;
+            // the frame before stayed up longer than planned
+            if (vsyncs > 1 && flip.target &&
+                flip.flip_time > flip.target + vsync_sched.period / 2)
+                vsync_sched.repeated++;
+        }
+    }
+    vsync_sched.vsync = flip.flip_time;
+    vsync_sched.seq   = flip.sequence;
+    vsync_sched.count = flip.count;
+
+    // the VO reports the target of the frame that actually flipped
+    if (flip.target && vsync_sched.active) {
+        double late = flip.flip_time - flip.target;
+        vsync_sched.frames++;
+        vsync_sched.late_sum += late;
+        if (late > vsync_sched.late_max)
+            vsync_sched.late_max = late;
+        if (late > vsync_sched.period / 2)
+            vsync_sched.late++;
+        vsync_sched.late_avg = 0.9 * vsync_sched.late_avg + 0.1 * late;
+        if (vsync_sched.late_avg > vsync_sched.period) {
+            // consistently a vsync behind, skip one frame to catch up
+            vsync_sched.drop      = 1;
+            vsync_sched.late_avg -= vsync_sched.period;
+        }
+    }
+}
+
+/**
+ * \brief Sleep until the frame due in \p time_frame seconds can be
+ * handed over for its vsync.
+ * \return time left until the frame's ideal display time
+ */
+static double vsync_sched_sleep(double time_frame)
+{
+    double period  = vsync_sched.period;
+    int64_t now    = GetMonotonicTimer();
+    int64_t target = now + (int64_t)(time_frame * 1000000);
+    int64_t vsync  = vsync_sched.vsync +
+                     (int64_t)(llrint((target - vsync_sched.vsync) / period) * period);
+
+    if (vsync <= now) // missed it, take the next one
+        vsync += (int64_t)((floor((now - vsync) / period) + 1) * period);
+    if (vsync - period / 2 > now) {
+        current_module = "sleep_vsync";
+        usec_sleep_until(vsync - period / 2);
+    }
+    vsync_sched.next_target = target;
+    (void)GetRelativeTime(); // the other timing code works on deltas
+    return (target - GetMonotonicTimer()) * 0.000001;
+}
+
+static void print_vsync_stats(void)
+{
+    if (!vsync_sched.frames)
+        return;
+    mp_msg(MSGT_CPLAYER, benchmark ? MSGL_INFO : MSGL_V,
+           "Display sync: %.3f Hz, %u frames, %u late, %u dropped, %u repeated, "
+           "lateness avg %.2f ms max %.2f ms\n",
+           1000000 / vsync_sched.period, vsync_sched.frames, vsync_sched.late,
+           vsync_sched.dropped, vsync_sched.repeated,
+           vsync_sched.late_sum / vsync_sched.frames * 0.001,
+           vsync_sched.late_max * 0.001);
+    vsync_sched.frames   = vsync_sched.late     = 0;
+    vsync_sched.dropped  = vsync_sched.repeated = 0;
+    vsync_sched.late_sum = vsync_sched.late_max = 0;
+}
+
 static int check_framedrop(double frame_time)
 {
     // check for frame-drop:
     current_module = "check_framedrop";
+    if (display_sync && vsync_sched.active) {
+        ++total_frame_cnt;
+        if (vsync_sched.drop && mpctx->osd_function != OSD_PAUSE) {
+            vsync_sched.drop = 0;
+            if (frame_dropping) {
+                ++drop_frame_cnt;
+                ++vsync_sched.dropped;
+            }
+            return frame_dropping;
+        }
+        return 0;
+    }
     if (mpctx->sh_audio && !mpctx->d_audio->eof) {
         static int dropped_frames;
         float delay = playback_speed * mpctx->audio_out->get_delay();
@@ -1509,6 +2163,7 @@ static int generate_video_frame(sh_video_t *sh_video, demux_stream_t *d_video)
 
     while (1) {
         int drop_frame = 0;
+        int hrseek     = mpctx->hrseek_pts != MP_NOPTS_VALUE;
         void *decoded_frame;
         current_module = "decode video";
         // XXX Time used in this call is not counted in any performance
@@ -1523,20 +2178,34 @@ static int generate_video_frame(sh_video_t *sh_video, demux_stream_t *d_video)
             start   = NULL;
             pts     = MP_NOPTS_VALUE;
             hit_eof = 1;
+        } else if (hrseek) {
+            if (pts != MP_NOPTS_VALUE && pts < mpctx->hrseek_pts)
+                drop_frame = VDFLAGS_HRSEEK;
         } else
 	    drop_frame = check_framedrop(sh_video->frametime);
         if (in_size > max_framesize)
             max_framesize = in_size;
         current_module = "decode video";
         decoded_frame  = decode_video(sh_video, start, in_size, drop_frame, pts, endpts, NULL);
+        if (decoded_frame && hrseek && !hit_eof) {
+            // stop at the first frame that is visible at the target,
+            // allowing for rounding in frame end times
+            double end = sh_video->endpts != MP_NOPTS_VALUE ?
+                         sh_video->endpts : sh_video->pts + sh_video->frametime;
+            if (sh_video->pts != MP_NOPTS_VALUE &&
+                sh_video->pts < mpctx->hrseek_pts &&
+                end <= mpctx->hrseek_pts + 0.001)
+                continue; // skip filters and OSD for the frame
+            mpctx->hrseek_pts = MP_NOPTS_VALUE;
+        }
         if (decoded_frame) {
             update_subtitles(sh_video, sh_video->pts, mpctx->d_sub, 0);
             update_osd_msg();
             current_module = "filter video";
             if (filter_video(sh_video, decoded_frame, sh_video->pts, sh_video->endpts))
                 break;
-        } else if (drop_frame)
-            return -1;
+        } else if (drop_frame && !hrseek)
+            return -1;  // a precise seek keeps decoding up to its target
         if (hit_eof)
             return 0;
     }
@@ -1545,7 +2214,7 @@ static int generate_video_frame(sh_video_t *sh_video, demux_stream_t *d_video)
 
 int rtc_fd = -1;
 
-static float timing_sleep(float time_frame)
+static double timing_sleep(double time_frame)
 {
     if (rtc_fd >= 0) {
         // -------- RTC -----------
@@ -1558,12 +2227,12 @@ static float timing_sleep(float time_frame)
         }
     } else
     {
-        // assume kernel HZ=100 for softsleep, works with larger HZ but with
-        // unnecessarily high CPU usage
-        float margin = softsleep ? 0.011 : 0;
+        // absolute monotonic deadlines do not accumulate wakeup latency,
+        // softsleep only has to cover the timer slack
+        float margin = softsleep ? 0.002 : 0;
         current_module = "sleep_timer";
-        while (time_frame > margin) {
-            usec_sleep(1000000 * (time_frame - margin));
+        if (time_frame > margin) {
+            usec_sleep_until(GetMonotonicTimer() + (int64_t)(1000000 * (time_frame - margin)));
             time_frame -= GetRelativeTime();
         }
         if (softsleep) {
@@ -1610,7 +2279,7 @@ static int select_subtitle(MPContext *mpctx)
     return found;
 }
 
-static void adjust_sync_and_print_status(int between_frames, float timing_error)
+static void adjust_sync_and_print_status(int between_frames, double timing_error)
 {
     current_module = "av_sync";
 
@@ -1678,21 +2347,47 @@ static void adjust_sync_and_print_status(int between_frames, float timing_error)
                 mpctx->delay += x;
                 c_total      += x;
             }
-            if (!quiet)
-                print_status(a_pts - audio_delay, AV_delay, c_total);
+            update_status(a_pts - audio_delay, AV_delay, c_total);
         }
     } else {
         // No audio:
 
-        if (!quiet)
-            print_status(0, 0, 0);
+        update_status(0, 0, 0);
+    }
+}
+
+/**
+ * @brief Drop decoded audio that lies before the target of a precise seek.
+ * @return 1 if all buffered audio was dropped and more has to be decoded
+ */
+static int hrseek_trim_audio(sh_audio_t *sh_audio)
+{
+    int frame_size = ao_data.channels * af_fmt2bits(ao_data.format) / 8;
+    double skip    = mpctx->hrseek_audio_pts -
+                     written_audio_pts(sh_audio, mpctx->d_audio);
+    int bytes;
+
+    if (skip <= 0) {
+        mpctx->hrseek_audio_pts = MP_NOPTS_VALUE;
+        return 0;
     }
+    bytes = skip / playback_speed * ao_data.bps;
+    if (frame_size > 0)
+        bytes -= bytes % frame_size;
+    if (bytes >= sh_audio->a_out_buffer_len) {
+        sh_audio->a_out_buffer_len = 0;
+        return 1;
+    }
+    sh_audio->a_out_buffer_len -= bytes;
+    memmove(sh_audio->a_out_buffer, &sh_audio->a_out_buffer[bytes],
+            sh_audio->a_out_buffer_len);
+    mpctx->hrseek_audio_pts = MP_NOPTS_VALUE;
+    return 0;
 }
 
 static int fill_audio_out_buffers(void)
 {
-    unsigned int t;
-    double tt;
+    int64_t t;
     int playsize;
     int playflags = 0;
     int audio_eof = 0;
@@ -1734,7 +2429,7 @@ static int fill_audio_out_buffers(void)
 
         // Fill buffer if needed:
         current_module = "decode_audio";
-        t = GetTimer();
+        t = GetTimerNS();
         if (!sh_audio->a_buffer_format_change) {
             res = mp_decode_audio(sh_audio, playsize);
             sh_audio->a_buffer_format_change = res == -2;
@@ -1745,9 +2440,14 @@ static int fill_audio_out_buffers(void)
                 if (sh_audio->a_out_buffer_len == 0)
                     return 0;
             }
-        t  = GetTimer() - t;
-        tt = t * 0.000001f;
-        audio_time_usage += tt;
+        if (mpctx->hrseek_audio_pts != MP_NOPTS_VALUE &&
+            !sh_audio->a_buffer_format_change && res >= 0 &&
+            hrseek_trim_audio(sh_audio)) {
+            // everything decoded so far is before the seek target
+            bytes_to_write += playsize;
+            continue;
+        }
+        audio_time_usage += (GetTimerNS() - t) * 1e-9;
         if (playsize > sh_audio->a_out_buffer_len) {
             playsize = sh_audio->a_out_buffer_len;
             if (audio_eof || sh_audio->a_buffer_format_change)
@@ -1770,6 +2470,8 @@ static int fill_audio_out_buffers(void)
             memmove(sh_audio->a_out_buffer, &sh_audio->a_out_buffer[playsize],
                     sh_audio->a_out_buffer_len);
             mpctx->delay += playback_speed * playsize / (double)ao_data.bps;
+            audio_out_seconds += playsize / (double)ao_data.bps;
+            audio_out_samples += playsize / (double)ao_data.bps * ao_data.samplerate;
         } else if ((sh_audio->a_buffer_format_change || audio_eof) &&
                    mpctx->audio_out->get_delay() < .04) {
             // Sanity check to avoid hanging in case current ao doesn't output
@@ -1789,9 +2491,10 @@ static int fill_audio_out_buffers(void)
     return 1;
 }
 
-static int sleep_until_update(float *time_frame, float *aq_sleep_time)
+static int sleep_until_update(double *time_frame, double *aq_sleep_time)
 {
     int frame_time_remaining = 0;
+    int use_vsync_sched = display_sync && vsync_sched.active && !benchmark;
     current_module = "calc_sleep_time";
 
 
@@ -1811,8 +2514,8 @@ static int sleep_until_update(float *time_frame, float *aq_sleep_time)
              * sync to settle at the right value (but it eventually will.)
              * This settling time is very short for values below 100.
              */
-            float predicted  = mpctx->delay / playback_speed + *time_frame;
-            float difference = delay - predicted;
+            double predicted  = mpctx->delay / playback_speed + *time_frame;
+            double difference = delay - predicted;
             delay = predicted + difference / (float)autosync;
         }
 
@@ -1837,6 +2540,11 @@ static int sleep_until_update(float *time_frame, float *aq_sleep_time)
             *time_frame = 0;
     }
 
+    // a flip only reaches the screen at the next vblank, so hand the
+    // frame over that much earlier
+    if (!use_vsync_sched)
+        *time_frame -= vo_flip_latency;
+
     //============================== SLEEP: ===================================
 
     // flag 256 means: libvo driver does its timing (dvb card)
@@ -1846,7 +2554,9 @@ static int sleep_until_update(float *time_frame, float *aq_sleep_time)
             usec_sleep(200000);
             *time_frame -= GetRelativeTime();
             frame_time_remaining = 1;
-    } else if (*time_frame > 0.001)
+    } else if (use_vsync_sched)
+            *time_frame = vsync_sched_sleep(*time_frame);
+        else if (*time_frame > 0.001)
             *time_frame = timing_sleep(*time_frame);
     }
 
@@ -1855,6 +2565,67 @@ static int sleep_until_update(float *time_frame, float *aq_sleep_time)
     return frame_time_remaining;
 }
 
+static void *audio_codec_init_thread(void *arg)
+{
+    audio_init_result = init_best_audio_codec(arg, audio_codec_list,
+                                              audio_fm_list);
+    return NULL;
+}
+
+/**
+ * @brief Start opening the audio codec in the background.
+ * Both codec lists may need several init attempts until one succeeds,
+ * so let them overlap. The audio side runs on the worker since video
+ * decoders may configure the VO during init. The video chain may read
+ * from the demuxer while the audio codec decodes its first packets during
+ * init, the demuxer lock keeps the two threads apart. Codec data found
+ * in those packets is held back by the demuxer until
+ * join_audio_codec_init().
+ *
+ * The worker only uses its own sh_audio, its own codecs.conf walk and
+ * the demuxer; libavcodec is set up here, on the main thread, so the two
+ * codec inits do not race on it. current_module stays with the main
+ * thread, see thread_module().
+ */
+static void start_audio_codec_init(void)
+{
+    int hold = 1;
+
+    if (!parallel_init || !mpctx->sh_audio ||
+        (initialized_flags & INITIALIZED_ACODEC))
+        return;
+    init_avcodec();
+    // the video codec reads the codec data the worker's packets may carry
+    demux_control(mpctx->demuxer, DEMUXER_CTRL_HOLD_CODECDATA, &hold);
+    audio_init_running = !pthread_create(&audio_init_thread, NULL,
+                                         audio_codec_init_thread, mpctx->sh_audio);
+    if (!audio_init_running) {
+        hold = 0;
+        demux_control(mpctx->demuxer, DEMUXER_CTRL_HOLD_CODECDATA, &hold);
+    }
+}
+
+/**
+ * @brief Wait for start_audio_codec_init() and take over its result,
+ * falling back to nosound if no audio codec could be opened.
+ */
+static void join_audio_codec_init(void)
+{
+    int hold = 0;
+
+    if (!audio_init_running)
+        return;
+    pthread_join(audio_init_thread, NULL);
+    audio_init_running = 0;
+    demux_control(mpctx->demuxer, DEMUXER_CTRL_HOLD_CODECDATA, &hold);
+    if (audio_init_result) {
+        initialized_flags |= INITIALIZED_ACODEC;
+    } else {
+        mpctx->sh_audio    = mpctx->d_audio->sh = NULL; // -> nosound
+        mpctx->d_audio->id = -2;
+    }
+}
+
 int reinit_video_chain(void)
 {
     sh_video_t *const sh_video = mpctx->sh_video;
@@ -1905,9 +2676,11 @@ int reinit_video_chain(void)
 
     current_module = "init_video_codec";
 
+    start_audio_codec_init();
     mp_msg(MSGT_CPLAYER, MSGL_INFO, "==========================================================================\n");
     init_best_video_codec(sh_video, video_codec_list, video_fm_list);
     mp_msg(MSGT_CPLAYER, MSGL_INFO, "==========================================================================\n");
+    join_audio_codec_init();
 
     if (!sh_video->initialized) {
         if (!fixed_vo)
@@ -2059,6 +2832,7 @@ static void pause_loop(void)
         }
         if (mpctx->sh_video && mpctx->video_out && vo_config_count)
             mpctx->video_out->check_events();
+        mp_ipc_update(mpctx);
         if (!quiet && stream_cache_size > 0) {
             int new_cache_fill = cache_fill_status(mpctx->stream);
             if (new_cache_fill != old_cache_fill) {
@@ -2088,6 +2862,36 @@ static void pause_loop(void)
     if (mpctx->video_out && mpctx->sh_video && vo_config_count)
         mpctx->video_out->control(VOCTRL_RESUME, NULL);  // resume video
     (void)GetRelativeTime(); // ignore time that passed during pause
+    vsync_sched_reset();
+}
+
+/**
+ * @brief Compute the pts a precise seek should stop at.
+ * @return MP_NOPTS_VALUE if the seek cannot be done precisely
+ */
+static double hrseek_target(MPContext *mpctx, double amount, int style)
+{
+    double pts;
+
+    // video without correct-pts has no reliable per-frame pts to decode to
+    if (!hr_seek || (style & SEEK_FACTOR) ||
+        (mpctx->sh_video && !correct_pts))
+        return MP_NOPTS_VALUE;
+    if (style & SEEK_ABSOLUTE) {
+        double start_time = 0;
+        demux_control(mpctx->demuxer, DEMUXER_CTRL_GET_START_TIME, &start_time);
+        return start_time + amount;
+    }
+    if (mpctx->sh_video)
+        pts = mpctx->sh_video->pts;
+    else if (mpctx->sh_audio)
+        pts = playing_audio_pts(mpctx->sh_audio, mpctx->d_audio,
+                                mpctx->audio_out);
+    else
+        return MP_NOPTS_VALUE;
+    if (pts == MP_NOPTS_VALUE)
+        return MP_NOPTS_VALUE;
+    return pts + amount;
 }
 
 // style & SEEK_ABSOLUTE == 0 means seek relative to current position, == 1 means absolute
@@ -2095,10 +2899,25 @@ static void pause_loop(void)
 // return -1 if seek failed (non-seekable stream?), 0 otherwise
 static int seek(MPContext *mpctx, double amount, int style)
 {
+    double hrseek_pts = hrseek_target(mpctx, amount, style);
+
     current_module = "seek";
+    if (hrseek_pts != MP_NOPTS_VALUE) {
+        // Relative seeks in the demuxer start from its read position,
+        // which may be far ahead of what is shown.
+        if (!(style & SEEK_ABSOLUTE)) {
+            double start_time = 0;
+            demux_control(mpctx->demuxer, DEMUXER_CTRL_GET_START_TIME, &start_time);
+            amount = hrseek_pts - start_time;
+        }
+        style = SEEK_ABSOLUTE | SEEK_HR;
+    }
     if (demux_seek(mpctx->demuxer, amount, audio_delay, style) == 0)
         return -1;
 
+    mpctx->hrseek_pts       = mpctx->sh_video ? hrseek_pts : MP_NOPTS_VALUE;
+    mpctx->hrseek_audio_pts = mpctx->sh_audio ? hrseek_pts : MP_NOPTS_VALUE;
+
     mpctx->startup_decode_retry = DEFAULT_STARTUP_DECODE_RETRY;
     if (mpctx->sh_video) {
         current_module = "seek_video_reset";
@@ -2107,6 +2926,7 @@ static int seek(MPContext *mpctx, double amount, int style)
         mpctx->num_buffered_frames = 0;
         mpctx->delay           = 0;
         mpctx->time_frame      = 0;
+        vsync_sched_reset();
         // Not all demuxers set d_video->pts during seek, so this value
         // (which is used by at least vobsub and edl code below) may
         // be completely wrong (probably 0).
@@ -2124,6 +2944,8 @@ static int seek(MPContext *mpctx, double amount, int style)
     c_total = 0;
     max_pts_correction = 0.1;
     audio_time_usage   = 0;
+    audio_out_seconds  = 0;
+    audio_out_samples  = 0;
     video_time_usage   = 0;
     vout_time_usage    = 0;
     drop_frame_cnt     = 0;
@@ -2139,15 +2961,22 @@ int main(int argc, char *argv[])
 {
     int opt_exit = 0; // Flag indicating whether MPlayer should exit without playing anything.
     int profile_config_loaded;
+    int preloaded;
+    play_tree_t *preloaded_playlist;
+    struct mp_msg_capture *preloaded_msgs;
     int i;
+    int64_t opt_start, opt_registered;
 
     common_preinit(&argc, &argv);
 
     // Create the config context and register the options
+    opt_start = GetTimerNS();
     mconfig = m_config_new();
     m_config_register_options(mconfig, mplayer_opts);
     m_config_register_options(mconfig, common_opts);
     mp_input_register_options(mconfig);
+    property_register_runtime_options(mpctx, mconfig);
+    opt_registered = GetTimerNS();
 
     // Preparse the command line
     m_config_preparse_command_line(mconfig, argc, argv);
@@ -2163,6 +2992,11 @@ int main(int argc, char *argv[])
     } else
         mpctx->playtree = play_tree_cleanup(mpctx->playtree);
 
+    mp_msg(MSGT_CPLAYER, benchmark ? MSGL_INFO : MSGL_V,
+           "BENCHMARKo: %u options registered in %.3f ms, config files and command line parsed in %.3f ms\n",
+           mconfig->num_opts, (opt_registered - opt_start) * 1e-6,
+           (GetTimerNS() - opt_registered) * 1e-6);
+
     mpctx->playtree_iter = mpctx->playtree ? play_tree_iter_new(mpctx->playtree, mconfig) : NULL;
     if (mpctx->playtree_iter && play_tree_iter_step(mpctx->playtree_iter, 0, 0) != PLAY_TREE_ITER_ENTRY) {
         play_tree_iter_free(mpctx->playtree_iter);
@@ -2284,6 +3118,8 @@ int main(int argc, char *argv[])
         mp_input_add_cmd_fd(0, USE_SELECT, MP_INPUT_SLAVE_CMD_FUNC, NULL);
     else if (!noconsolecontrols)
         mp_input_add_event_fd(0, getch2);
+    if (ipc_socket_path)
+        mp_ipc_init(ipc_socket_path);
     // Set the libstream interrupt callback
     stream_set_interrupt_callback(mp_input_check_interrupt);
 
@@ -2356,6 +3192,7 @@ play_next_file:
         while (!(cmd = mp_input_get_cmd(0, 1, 0))) { // wait for command
             if (mpctx->video_out && vo_config_count)
                 mpctx->video_out->check_events();
+            mp_ipc_update(mpctx);
             usec_sleep(20000);
         }
         switch (cmd->id) {
@@ -2440,7 +3277,13 @@ play_next_file:
     mpctx->sh_video = NULL;
 
     current_module = "open_stream";
-    mpctx->stream  = open_stream(filename, 0, &mpctx->file_format);
+    mpctx->startup_start    = GetTimer();
+    mpctx->startup_reported = 0;
+    preloaded_playlist = NULL;
+    preloaded_msgs     = NULL;
+    preloaded = preload_take(filename, &preloaded_playlist, &preloaded_msgs);
+    if (!preloaded)
+        mpctx->stream = open_stream(filename, 0, &mpctx->file_format);
     if (!mpctx->stream) { // error...
         mpctx->eof = libmpdemux_was_interrupted(PT_NEXT_ENTRY);
         goto goto_next_file;
@@ -2453,7 +3296,10 @@ play_next_file:
         current_module = "handle_playlist";
         mp_msg(MSGT_CPLAYER, MSGL_V, "Parsing playlist %s...\n",
                filename_recode(filename));
-        if (allow_playlist_parsing) {
+        if (preloaded_playlist) {
+            mp_msg_capture_replay(preloaded_msgs);
+            mpctx->eof = playtree_add_playlist(preloaded_playlist);
+        } else if (allow_playlist_parsing) {
             entry      = parse_playtree(mpctx->stream, use_gui);
             mpctx->eof = playtree_add_playlist(entry);
         } else {
@@ -2461,7 +3307,8 @@ play_next_file:
         }
         goto goto_next_file;
     }
-    mpctx->stream->start_pos += seek_to_byte;
+    if (!preloaded)
+        mpctx->stream->start_pos += seek_to_byte;
 
 // CACHE2: initial prefill: 20%  later: 5%  (should be set by -cacheopts)
 goto_enable_cache:
@@ -2478,8 +3325,10 @@ goto_enable_cache:
 
 //============ Open DEMUXERS --- DETECT file type =======================
     current_module = "demux_open";
+    mpctx->startup_open = GetTimer() - mpctx->startup_start;
 
-    mpctx->demuxer = demux_open(mpctx->stream, mpctx->file_format, audio_id, video_id, sub_id, filename);
+    if (!preloaded)
+        mpctx->demuxer = demux_open(mpctx->stream, mpctx->file_format, audio_id, video_id, sub_id, filename);
 
     // HACK to get MOV Reference Files working
     if (mpctx->demuxer && mpctx->demuxer->type == DEMUXER_TYPE_PLAYLIST) {
@@ -2547,14 +3396,23 @@ goto_enable_cache:
     mpctx->d_video = mpctx->demuxer->video;
     mpctx->d_sub   = mpctx->demuxer->sub;
 
-    // select video stream
-    select_video(mpctx->demuxer, video_id);
+    // the preloader already selected the streams, switching
+    // again would drop the packets the audio codec was opened with
+    if (!preloaded) {
+        // select video stream
+        select_video(mpctx->demuxer, video_id);
 
-    // select audio stream
-    select_audio(mpctx->demuxer, audio_id, audio_lang);
+        // select audio stream
+        select_audio(mpctx->demuxer, audio_id, audio_lang);
+    }
 
     mpctx->sh_audio = mpctx->d_audio->sh;
     mpctx->sh_video = mpctx->d_video->sh;
+    if (mpctx->sh_audio && mpctx->sh_audio->initialized)
+        initialized_flags |= INITIALIZED_ACODEC;
+    // the preloader did this before opening the audio codec
+    if (!preloaded)
+        demux_control(mpctx->demuxer, DEMUXER_CTRL_LOAD_CODECDATA, NULL);
 
     if (mpctx->sh_video) {
         current_module = "video_read_properties";
@@ -2674,15 +3532,20 @@ goto_enable_cache:
             mpctx->loop_times = -1;
 
         mp_msg(MSGT_CPLAYER, MSGL_INFO, MSGTR_StartPlaying);
+        prefetch_next_entries();
 
-        total_time_usage_start = GetTimer();
+        total_time_usage_start = GetTimerNS();
         audio_time_usage       = 0;
+        audio_out_seconds      = 0;
+        audio_out_samples      = 0;
         video_time_usage       = 0;
         vout_time_usage = 0;
         total_frame_cnt = 0;
         drop_frame_cnt  = 0;         // fix for multifile fps benchmark
         play_n_frames   = play_n_frames_mf;
         mpctx->startup_decode_retry = DEFAULT_STARTUP_DECODE_RETRY;
+        mpctx->hrseek_pts       = MP_NOPTS_VALUE;
+        mpctx->hrseek_audio_pts = MP_NOPTS_VALUE;
 
         if (play_n_frames == 0) {
             mpctx->eof = PT_NEXT_ENTRY;
@@ -2695,7 +3558,9 @@ goto_enable_cache:
         }
 
         while (!mpctx->eof) {
-            float aq_sleep_time = 0;
+            double aq_sleep_time = 0;
+
+            preload_next_file();
 
             if (!mpctx->sh_audio && mpctx->d_audio->sh) {
                 mpctx->sh_audio     = mpctx->d_audio->sh;
@@ -2728,8 +3593,9 @@ goto_enable_cache:
                 if (mpctx->sh_audio)
                     a_pos = playing_audio_pts(mpctx->sh_audio, mpctx->d_audio, mpctx->audio_out);
 
-                if (!quiet)
-                    print_status(a_pos, 0, 0);
+                update_status(a_pos, 0, 0);
+                if (!mpctx->startup_reported && mpctx->sh_audio)
+                    print_startup_times();
 
                 if (is_at_end(mpctx, &end_at, a_pos))
                     mpctx->eof = PT_NEXT_ENTRY;
@@ -2801,11 +3667,9 @@ goto_enable_cache:
                     mpctx->video_out->check_events();
 
                 if (heartbeat_cmd) {
-                    static unsigned last_heartbeat;
-                    unsigned now = GetTimerMS();
-                    // compare as unsigned so that any mistakes (overflow etc)
-                    // trigger a heartbeat, thus resetting the logic.
-                    if (now - last_heartbeat > (unsigned)(heartbeat_interval * 1000)) {
+                    static int64_t last_heartbeat;
+                    int64_t now = GetTimerNS();
+                    if (now - last_heartbeat > (int64_t)(heartbeat_interval * 1e9)) {
                         last_heartbeat = now;
                         system(heartbeat_cmd);
                     }
@@ -2818,13 +3682,20 @@ goto_enable_cache:
 
                     current_module = "flip_page";
                     if (!frame_time_remaining && blit_frame) {
-                        unsigned int t2 = GetTimer();
+                        int64_t t2 = GetTimerNS();
 
-                        if (vo_config_count)
+                        if (vo_config_count) {
+                            if (vsync_sched.next_target)
+                                mpctx->video_out->control(VOCTRL_SET_FLIP_TARGET,
+                                                          &vsync_sched.next_target);
                             mpctx->video_out->flip_page();
+                            vsync_sched_update();
+                        }
                         mpctx->num_buffered_frames--;
 
-                        vout_time_usage += (GetTimer() - t2) * 0.000001;
+                        vout_time_usage += (GetTimerNS() - t2) * 1e-9;
+                        if (!mpctx->startup_reported)
+                            print_startup_times();
                     }
 //====================== A-V TIMESTAMP CORRECTION: =========================
 
@@ -2866,6 +3737,7 @@ goto_enable_cache:
             {
                 mp_cmd_t *cmd;
                 int brk_cmd = 0;
+                mp_ipc_update(mpctx);
                 while (!brk_cmd && (cmd = mp_input_get_cmd(0, 0, 0)) != NULL) {
                     brk_cmd = run_command(mpctx, cmd);
                     mp_cmd_free(cmd);
@@ -2919,11 +3791,13 @@ goto_next_file:  // don't jump here after ao/vo/getch initialization!
 
     mp_msg(MSGT_CPLAYER, MSGL_INFO, "\n");
 
+    print_vsync_stats();
+    vsync_sched_reset();
+
     if (benchmark) {
         double tot = video_time_usage + vout_time_usage + audio_time_usage;
         double total_time_usage;
-        total_time_usage_start = GetTimer() - total_time_usage_start;
-        total_time_usage       = (float)total_time_usage_start * 0.000001;
+        total_time_usage = (GetTimerNS() - total_time_usage_start) * 1e-9;
         mp_msg(MSGT_CPLAYER, MSGL_INFO, "\nBENCHMARKs: VC:%8.3fs VO:%8.3fs A:%8.3fs Sys:%8.3fs = %8.3fs\n",
                video_time_usage, vout_time_usage, audio_time_usage,
                total_time_usage - tot, total_time_usage);
@@ -2934,6 +3808,11 @@ goto_next_file:  // don't jump here after ao/vo/getch initialization!
                    100.0 * audio_time_usage         / total_time_usage,
                    100.0 * (total_time_usage - tot) / total_time_usage,
                    100.0);
+        if (audio_time_usage > 0.0)
+            mp_msg(MSGT_CPLAYER, MSGL_INFO, "BENCHMARKa: %.3fs of audio decoded+filtered in %.3fs: %.0f samples/s, %.2fx realtime\n",
+                   audio_out_seconds, audio_time_usage,
+                   audio_out_samples / audio_time_usage,
+                   audio_out_seconds / audio_time_usage);
         if (total_frame_cnt && frame_dropping)
             mp_msg(MSGT_CPLAYER, MSGL_INFO, "BENCHMARKn: disp: %d (%3.2f fps)  drop: %d (%d%%)  total: %d (%3.2f fps)\n",
                    total_frame_cnt - drop_frame_cnt,
@@ -2984,12 +3863,22 @@ goto_next_file:  // don't jump here after ao/vo/getch initialization!
     }
 
     if (mpctx->playtree_iter != NULL || player_idle_mode) {
+        unsigned int keep;
         if (!mpctx->playtree_iter && !use_gui)
             filename = NULL;
         mpctx->eof = 0;
 
         // time to uninit all, except global stuff:
-        uninit_player(INITIALIZED_ALL - (INITIALIZED_GUI + INITIALIZED_INPUT + (fixed_vo ? INITIALIZED_VO : 0)));
+        keep = INITIALIZED_GUI + INITIALIZED_INPUT;
+        if (fixed_vo || gapless_playback)
+            keep += INITIALIZED_VO;
+        // keep the AO running so the next file continues its buffer;
+        // reinit_audio_chain() reopens it if the format changes
+        gapless_ao_kept = gapless_playback && mpctx->playtree_iter &&
+                          (initialized_flags & INITIALIZED_AO);
+        if (gapless_ao_kept)
+            keep += INITIALIZED_AO;
+        uninit_player(INITIALIZED_ALL - keep);
 
         goto play_next_file;
     }
@@ -19,6 +19,8 @@
 #ifndef MPLAYER_MPLAYER_H
 #define MPLAYER_MPLAYER_H
 
+#include <stdint.h>
+
 extern char  *filename;
 extern char  *current_module;
 extern char **audio_fm_list;
@@ -27,7 +29,7 @@ extern char **video_driver_list;
 extern char **audio_driver_list;
 
 extern int osd_level;
-extern unsigned int osd_visible;
+extern int64_t osd_visible;
 extern int autosync;
 extern int frame_dropping;
 extern int slave_mode;
@@ -36,8 +38,10 @@ extern int use_menu;
 extern float heartbeat_interval;
 
 extern float  audio_delay;
+extern float  start_volume;
 extern double start_pts;
 extern int progbar_align;
+extern int status_interval;
 
 extern int allow_playlist_parsing;
 
@@ -30,6 +30,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <signal.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <sys/ioctl.h>
@@ -127,8 +128,26 @@ int load_termcap(char *termtype){
   return getch2_key_db;
 }
 
+#ifdef SIGWINCH
+static volatile sig_atomic_t screen_size_changed = 1;
+
+static void sigwinch_handler(int sig){
+  screen_size_changed = 1;
+}
+#endif
+
 void get_screen_size(void){
   struct winsize ws;
+#ifdef SIGWINCH
+  // only ask the terminal again after it told us it was resized
+  static int handler_installed;
+  if (!handler_installed) {
+    signal(SIGWINCH, sigwinch_handler);
+    handler_installed = 1;
+  }
+  if (!screen_size_changed) return;
+  screen_size_changed = 0;
+#endif
   if (ioctl(0, TIOCGWINSZ, &ws) < 0 || !ws.ws_row || !ws.ws_col) return;
 /*  printf("Using IOCTL\n"); */
   screen_width=ws.ws_col;
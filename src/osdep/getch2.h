@@ -33,7 +33,7 @@ extern int screen_height;
 /* Termcap code to erase to end of line */
 extern char * erase_to_end_of_line;
 
-/* Get screen-size using IOCTL call. */
+/* Get screen-size using IOCTL call, cached until the next SIGWINCH. */
 void get_screen_size(void);
 
 /* Load key definitions from the TERMCAP database. 'termtype' can be NULL */
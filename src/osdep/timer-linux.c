@@ -19,10 +19,10 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <errno.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <time.h>
-#include <sys/time.h>
 #include "config.h"
 #include "timer.h"
 
@@ -36,37 +36,55 @@ int usec_sleep(int usec_delay)
     return nanosleep(&ts, NULL);
 }
 
-// Returns current time in microseconds
+// Sleeps until the given GetMonotonicTimer() time, without drifting
+// when interrupted or woken early
+int usec_sleep_until(int64_t deadline)
+{
+    struct timespec ts;
+    int ret;
+    ts.tv_sec  = deadline / 1000000;
+    ts.tv_nsec = (deadline % 1000000) * 1000;
+    while ((ret = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL)) == EINTR);
+    return ret ? -1 : 0;
+}
+
+// Returns CLOCK_MONOTONIC time in nanoseconds. Unlike GetTimer() it
+// does not wrap and does not jump with the wall clock.
+int64_t GetTimerNS(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Returns CLOCK_MONOTONIC time in microseconds, the clock DRM
+// page flip events are stamped with
+int64_t GetMonotonicTimer(void)
+{
+    return GetTimerNS() / 1000;
+}
+
+// Returns current time in microseconds, wraps every 71 minutes
 unsigned int GetTimer(void)
 {
-    struct timeval tv;
-    //float s;
-    gettimeofday(&tv,NULL);
-    //s = tv.tv_usec; s *= 0.000001; s += tv.tv_sec;
-    return tv.tv_sec * 1000000 + tv.tv_usec;
+    return GetTimerNS() / 1000;
 }
 
 // Returns current time in milliseconds
 unsigned int GetTimerMS(void)
 {
-    struct timeval tv;
-    //float s;
-    gettimeofday(&tv,NULL);
-    //s = tv.tv_usec; s *= 0.000001; s += tv.tv_sec;
-    return tv.tv_sec * 1000 + tv.tv_usec / 1000;
+    return GetTimerNS() / 1000000;
 }
 
-static unsigned int RelativeTime = 0;
+static int64_t RelativeTime;
 
 // Returns time spent between now and last call in seconds
-float GetRelativeTime(void)
+double GetRelativeTime(void)
 {
-    unsigned int t,r;
-    t = GetTimer();
-    //t *= 16; printf("time = %ud\n", t);
-    r = t - RelativeTime;
+    int64_t t = GetTimerNS();
+    int64_t r = t - RelativeTime;
     RelativeTime = t;
-    return (float) r * 0.000001F;
+    return r * 1e-9;
 }
 
 // Initialize timer, must be called at least once at start
@@ -19,14 +19,19 @@
 #ifndef MPLAYER_TIMER_H
 #define MPLAYER_TIMER_H
 
+#include <stdint.h>
+
 extern const char timer_name[];
 
 void InitTimer(void);
 unsigned int GetTimer(void);
 unsigned int GetTimerMS(void);
-float GetRelativeTime(void);
+double GetRelativeTime(void);
+int64_t GetTimerNS(void);
+int64_t GetMonotonicTimer(void);
 
 int usec_sleep(int usec_delay);
+int usec_sleep_until(int64_t deadline);
 
 /* timer's callback handling */
 typedef void timer_callback( void );
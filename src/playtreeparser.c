@@ -61,104 +61,111 @@ strstrip(char* str) {
     str[0] = '\0';
 }
 
+/// Read more of the stream, \return 0 at EOF or when out of memory.
+static int
+play_tree_parser_fill(play_tree_parser_t* p) {
+  int r, consumed = p->iter - p->buffer;
+  char *i, *end;
+
+  if(p->buffer_size - p->buffer_end <= 1) {
+    if(!p->keep && consumed >= p->buffer_size / 2) {
+      // drop the lines already returned, this moves at most half the buffer
+      p->buffer_end -= consumed;
+      memmove(p->buffer, p->iter, p->buffer_end + 1);
+      p->scan -= consumed;
+      p->iter = p->buffer;
+    } else {
+      char *tmp;
+      if (p->buffer_size > INT_MAX / 2)
+        return 0;
+      tmp = realloc(p->buffer, 2 * p->buffer_size);
+      if (!tmp)
+        return 0;
+      p->buffer = tmp;
+      p->iter = p->buffer + consumed;
+      p->buffer_size *= 2;
+    }
+  }
+
+  r = stream_read(p->stream, p->buffer + p->buffer_end, p->buffer_size - p->buffer_end - 1);
+  if(r <= 0)
+    return 0;
+  // lines are handed out as C strings, treat embedded 0 bytes as line breaks
+  end = p->buffer + p->buffer_end + r;
+  for(i = p->buffer + p->buffer_end; (i = memchr(i, '\0', end - i)); i++)
+    *i = '\n';
+  p->buffer_end += r;
+  p->buffer[p->buffer_end] = '\0';
+  return r;
+}
+
+/// Return the next line, without its line break.
+/** While the parser keeps its input (format detection), the line is a copy,
+ *  since the same lines are read again after play_tree_parser_reset().
+ *  Afterwards lines are terminated in place in the buffer and are valid
+ *  until the next call.
+ */
 static char*
 play_tree_parser_get_line(play_tree_parser_t* p) {
-  char *end,*line_end;
-  int r,resize = 0;
+  char *end, *line_end, *next, *line;
+  int len;
 
   if(p->buffer == NULL) {
     p->buffer = malloc(BUF_STEP);
+    if(!p->buffer)
+      return NULL;
     p->buffer_size = BUF_STEP;
     p->buffer[0] = 0;
     p->iter = p->buffer;
+    p->scan = 0;
   }
 
-  if(p->stream->eof && (p->buffer_end == 0 || p->iter[0] == '\0'))
+  if(p->stream->eof && p->iter[0] == '\0')
     return NULL;
 
-  assert(p->buffer_end < p->buffer_size);
-  assert(!p->buffer[p->buffer_end]);
-  while(1) {
-
-    if(resize) {
-      char *tmp;
-      r = p->iter - p->buffer;
+  // scan only the data that arrived since the last try
+  while(!(end = memchr(p->buffer + p->scan, '\n', p->buffer_end - p->scan))) {
+    p->scan = p->buffer_end;
+    if(p->stream->eof || !play_tree_parser_fill(p)) {
       end = p->buffer + p->buffer_end;
-      if (p->buffer_size > INT_MAX - BUF_STEP)
-        break;
-      tmp = realloc(p->buffer, p->buffer_size + BUF_STEP);
-      if (!tmp)
-        break;
-      p->buffer = tmp;
-      p->iter = p->buffer + r;
-      p->buffer_size += BUF_STEP;
-      resize = 0;
-    }
-
-    if(p->buffer_size - p->buffer_end > 1 && ! p->stream->eof) {
-      r = stream_read(p->stream,p->buffer + p->buffer_end,p->buffer_size - p->buffer_end - 1);
-      if(r > 0) {
-	p->buffer_end += r;
-	assert(p->buffer_end < p->buffer_size);
-	p->buffer[p->buffer_end] = '\0';
-	while(strlen(p->buffer + p->buffer_end - r) != r)
-	  p->buffer[p->buffer_end - r + strlen(p->buffer + p->buffer_end - r)] = '\n';
-      }
-      assert(!p->buffer[p->buffer_end]);
-    }
-
-    end = strchr(p->iter,'\n');
-    if(!end) {
-      if(p->stream->eof) {
-	end = p->buffer + p->buffer_end;
-	break;
-      }
-      resize = 1;
-      continue;
+      break;
     }
-    break;
   }
 
   line_end = (end > p->iter && *(end-1) == '\r') ? end-1 : end;
-  if(line_end - p->iter >= 0)
-    p->line = realloc(p->line, line_end - p->iter + 1);
-  else
-    return NULL;
-  if(line_end - p->iter > 0)
-    strncpy(p->line,p->iter,line_end - p->iter);
-  p->line[line_end - p->iter] = '\0';
-  if(end[0] != '\0')
-    end++;
-
-  if(!p->keep) {
-    if(end[0] != '\0') {
-      p->buffer_end -= end-p->iter;
-      memmove(p->buffer,end,p->buffer_end);
-    } else
-      p->buffer_end = 0;
-    p->buffer[p->buffer_end] = '\0';
-    p->iter = p->buffer;
-  } else
-    p->iter = end;
+  next = end[0] != '\0' ? end + 1 : end;
+  len = line_end - p->iter;
+  if(p->keep) {
+    if(len >= p->line_size) {
+      char *tmp = realloc(p->line, len + 1);
+      if(!tmp)
+        return NULL;
+      p->line = tmp;
+      p->line_size = len + 1;
+    }
+    memcpy(p->line, p->iter, len);
+    p->line[len] = '\0';
+    line = p->line;
+  } else {
+    *line_end = '\0';
+    line = p->iter;
+  }
 
-  return p->line;
+  p->iter = next;
+  p->scan = next - p->buffer;
+  return line;
 }
 
 static void
 play_tree_parser_reset(play_tree_parser_t* p) {
   p->iter = p->buffer;
+  p->scan = 0;
 }
 
 static void
 play_tree_parser_stop_keeping(play_tree_parser_t* p) {
+  // the lines before iter are dropped when the buffer fills up
   p->keep = 0;
-  if(p->iter && p->iter != p->buffer) {
-    p->buffer_end -= p->iter -p->buffer;
-    if(p->buffer_end)
-      memmove(p->buffer,p->iter,p->buffer_end);
-    p->buffer[p->buffer_end] = 0;
-    p->iter = p->buffer;
-  }
 }
 
 static char*
@@ -36,6 +36,8 @@ typedef struct play_tree_parser {
   struct stream *stream;
   char *buffer,*iter,*line;
   int buffer_size , buffer_end;
+  int line_size;  ///< allocated size of line
+  int scan;       ///< buffer offset where the search for the next newline resumes
   int deep,keep;
 } play_tree_parser_t;
 
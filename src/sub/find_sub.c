@@ -36,13 +36,14 @@ static int current_sub=0;
 static int nosub_range_start=-1;
 static int nosub_range_end=-1;
 static const sub_data *last_sub_data = NULL;
+static int last_sub_num;
+// copy of the shown subtitle while a background load may move the array
+static subtitle stream_sub;
 
-
-void step_sub(sub_data *subd, float pts, int movement) {
+static void step_sub_locked(sub_data *subd, float pts, int movement) {
     subtitle *subs;
     int key;
 
-    if (subd == NULL) return;
     subs = subd->subtitles;
     key = (pts-sub_delay) * (subd->sub_uses_time ? 100 : sub_fps);
 
@@ -67,17 +68,25 @@ void step_sub(sub_data *subd, float pts, int movement) {
     sub_delay = pts - subs[current_sub].start / (subd->sub_uses_time ? 100 : sub_fps);
 }
 
-void find_sub(sub_data* subd,int key){
+void step_sub(sub_data *subd, float pts, int movement) {
+    if (subd == NULL) return;
+    sub_lock(subd);
+    if (subd->sub_num > 0)
+        step_sub_locked(subd, pts, movement);
+    sub_unlock(subd);
+}
+
+static void find_sub_locked(sub_data* subd,int key){
     subtitle *subs;
     subtitle *new_sub = NULL;
     int i,j;
 
-    if ( !subd || subd->sub_num == 0) return;
     subs = subd->subtitles;
 
-    if (last_sub_data != subd) {
+    if (last_sub_data != subd || last_sub_num != subd->sub_num) {
         // Sub data changed, reset nosub range.
         last_sub_data = subd;
+        last_sub_num = subd->sub_num;
         nosub_range_start = -1;
         nosub_range_end = -1;
     }
@@ -172,5 +181,22 @@ void find_sub(sub_data* subd,int key){
 
     new_sub=NULL; // no sub here
 update:
+    if (new_sub && subd->loader) {
+        stream_sub = *new_sub;
+        new_sub = &stream_sub;
+    }
     set_osd_subtitle(new_sub);
 }
+
+void find_sub(sub_data* subd,int key){
+    if (!subd) return;
+    sub_lock(subd);
+    if (subd->sub_num > 0)
+        find_sub_locked(subd, key);
+    else if (last_sub_data == subd) {
+        // a background load dropped the file after a read error
+        last_sub_data = NULL;
+        set_osd_subtitle(NULL);
+    }
+    sub_unlock(subd);
+}
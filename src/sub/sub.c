@@ -46,16 +46,12 @@ struct osd_text_t {
     int osd_kerning, //kerning with the previous word
 	osd_length,  //orizontal length inside the bbox
 	text_length, //number of characters
-	*text;       //characters
-    struct osd_text_t *prev,
-                      *next;
+	text;        //index of the first character in layout.chars
 };
 
 struct osd_text_p {
     int  value;
-    struct osd_text_t *ott;
-    struct osd_text_p *prev,
-                      *next;
+    int  word;       //index of the first word in layout.words
 };
 //^
 
@@ -133,8 +129,8 @@ static void draw_alpha_buf(mp_osd_obj_t* obj, int x0,int y0, int w,int h, unsign
     }
 }
 
-// allocates/enlarges the alpha/bitmap buffer
-static void alloc_buf(mp_osd_obj_t* obj)
+// allocates/enlarges the alpha/bitmap buffer, returns the size in use
+static int resize_buf(mp_osd_obj_t* obj)
 {
     int len;
     if (obj->bbox.x2 < obj->bbox.x1) obj->bbox.x2 = obj->bbox.x1;
@@ -148,6 +144,13 @@ static void alloc_buf(mp_osd_obj_t* obj)
 	obj->bitmap_buffer = av_malloc(len);
 	obj->alpha_buffer  = av_malloc(len);
     }
+    return len;
+}
+
+// allocates/enlarges the alpha/bitmap buffer and clears it
+static void alloc_buf(mp_osd_obj_t* obj)
+{
+    int len = resize_buf(obj);
     memset(obj->bitmap_buffer, sub_bg_color, len);
     memset(obj->alpha_buffer, sub_bg_alpha, len);
 }
@@ -402,6 +405,261 @@ static inline void vo_update_text_progbar(mp_osd_obj_t *obj, int dxs, int dys)
 
 subtitle* vo_sub=NULL;
 
+// Scratch arrays for the subtitle layout, reused by every update.
+static struct {
+    struct osd_text_t *words;
+    int *chars;
+    struct osd_text_p *lines;
+    unsigned int words_size, chars_size, lines_size;
+    int num_words, num_chars, num_lines;
+} layout;
+
+// Make room for n elements, the arrays only ever grow.
+static int layout_reserve(void *arr, unsigned int *size, int n, size_t elem)
+{
+    void *p;
+    if (n * elem <= *size)
+        return 1;
+    p = av_fast_realloc(*(void **)arr, size, n * elem);
+    if (!p)
+        return 0;
+    *(void **)arr = p;
+    return 1;
+}
+
+static void layout_add_word(int first, int xsize, int start)
+{
+    struct osd_text_t *w = &layout.words[layout.num_words++];
+    w->osd_kerning = first ? 0 : sub_font->charspace + sub_font->width[' '];
+    w->osd_length  = xsize;
+    w->text        = start;
+    w->text_length = layout.num_chars - start;
+}
+
+#ifdef NEW_SPLITTING
+// the 'sum of the differences in length among the lines',
+// a measure of the evenness of the lengths of the lines
+static int layout_spread(const struct osd_text_p *l, int n)
+{
+    int i, j, sum = 0;
+    for (i = 0; i < n; i++)
+        for (j = i + 1; j < n; j++)
+            sum += abs(l[i].value - l[j].value);
+    return sum;
+}
+#endif
+
+/**
+ * \brief Split the words [w0, num_words) of one subtitle line into
+ * osd lines no wider than xlimit.
+ */
+static int layout_split_line(int w0, int xlimit)
+{
+    struct osd_text_t *words = layout.words;
+    struct osd_text_p *lines;
+    int l0 = layout.num_lines, n;
+    int w = w0, value = 0;
+
+    for (;;) {
+        if (!layout_reserve(&layout.lines, &layout.lines_size,
+                            layout.num_lines + 1, sizeof(*layout.lines)))
+            return 0;
+        layout.lines[layout.num_lines].word = w;
+        do {
+            value += words[w].osd_kerning + words[w].osd_length;
+            w++;
+        } while (w < layout.num_words &&
+                 value + words[w].osd_kerning + words[w].osd_length <= xlimit);
+        layout.lines[layout.num_lines++].value = value;
+        if (w == layout.num_words)
+            break;
+        value = -2 * sub_font->charspace - sub_font->width[' '];
+    }
+
+    lines = layout.lines + l0;
+    n     = layout.num_lines - l0;
+#ifdef NEW_SPLITTING
+    if (n > 1) {
+        int minimum = layout_spread(lines, n);
+        int i, hold;
+
+        // until the last word of a line can be moved to the beginning of following line
+        // reducing the 'sum of the differences in length among the lines', it is done
+        do {
+            hold = -1;
+            for (i = 0; i < n - 1; i++) {
+                struct osd_text_p *cur = &lines[i], *next = &lines[i + 1];
+                int last = next->word - 1, mem1, mem2, value;
+
+                if (last == cur->word ||
+                    next->value + words[last].osd_length + words[next->word].osd_kerning > xlimit)
+                    continue;
+                mem1 = cur->value;
+                mem2 = next->value;
+                cur->value  = mem1 - words[last].osd_length - words[last].osd_kerning;
+                next->value = mem2 + words[last].osd_length + words[next->word].osd_kerning;
+                value = layout_spread(lines, n);
+                if (value < minimum) {
+                    minimum = value;
+                    hold = i;
+                }
+                cur->value  = mem1;
+                next->value = mem2;
+            }
+            // merging
+            if (hold >= 0) {
+                struct osd_text_p *cur = &lines[hold], *next = &lines[hold + 1];
+                int last = next->word - 1;
+                cur->value  -= words[last].osd_length + words[last].osd_kerning;
+                next->value += words[last].osd_length + words[next->word].osd_kerning;
+                next->word   = last;
+            }
+        } while (hold >= 0);
+    }
+#endif
+    return 1;
+}
+
+/* Layout cache.
+ * Subtitles are relaid out whenever the OSD is forced to update, which
+ * mostly happens with the text and the screen size unchanged. The last
+ * few results are kept, rendered bitmap included. */
+
+#define SUB_CACHE_SIZE 4
+
+typedef struct {
+    int dxs, dys, obj_dys;
+    int width_p, pos, align, justify, bg_color, bg_alpha;
+    int overlap, utf8, unicode, sub_alignment;
+} sub_layout_key_t;
+
+typedef struct {
+    sub_layout_key_t key;
+    char *text;                 ///< all lines, '\n' separated
+    int text_len;
+    unsigned int last_use;
+    int x, y;
+    mp_osd_bbox_t bbox;
+    unsigned char alignment;
+    int stride, len;
+    unsigned char *bitmap, *alpha;
+} sub_layout_cache_t;
+
+static sub_layout_cache_t sub_cache[SUB_CACHE_SIZE];
+static unsigned int sub_cache_clock;
+static char *sub_cache_text;
+static unsigned int sub_cache_text_size;
+
+static void sub_cache_flush(void)
+{
+    int i;
+    for (i = 0; i < SUB_CACHE_SIZE; i++) {
+        free(sub_cache[i].text);
+        av_freep(&sub_cache[i].bitmap);
+        av_freep(&sub_cache[i].alpha);
+        memset(&sub_cache[i], 0, sizeof(sub_cache[i]));
+    }
+}
+
+static void sub_cache_key(sub_layout_key_t *key, const mp_osd_obj_t *obj,
+                          int dxs, int dys)
+{
+    memset(key, 0, sizeof(*key));
+    key->dxs           = dxs;
+    key->dys           = dys;
+    key->obj_dys       = obj->dys;
+    key->width_p       = sub_width_p;
+    key->pos           = sub_pos;
+    key->align         = sub_alignment;
+    key->justify       = sub_justify;
+    key->bg_color      = sub_bg_color;
+    key->bg_alpha      = sub_bg_alpha;
+    key->overlap       = suboverlap_enabled;
+    key->utf8          = sub_utf8;
+    key->unicode       = sub_unicode;
+    key->sub_alignment = vo_sub->alignment;
+}
+
+/// Join the lines of vo_sub into sub_cache_text, returns the length or -1.
+static int sub_cache_join(void)
+{
+    int i, len = 0;
+    for (i = 0; i < vo_sub->lines; i++) {
+        int l = strlen(vo_sub->text[i]);
+        if (!layout_reserve(&sub_cache_text, &sub_cache_text_size, len + l + 1, 1))
+            return -1;
+        memcpy(sub_cache_text + len, vo_sub->text[i], l);
+        len += l;
+        sub_cache_text[len++] = '\n';
+    }
+    return len;
+}
+
+static sub_layout_cache_t *sub_cache_find(const sub_layout_key_t *key, int len)
+{
+    int i;
+    for (i = 0; i < SUB_CACHE_SIZE; i++) {
+        sub_layout_cache_t *e = &sub_cache[i];
+        if (e->text && e->text_len == len &&
+            !memcmp(&e->key, key, sizeof(*key)) &&
+            !memcmp(e->text, sub_cache_text, len))
+            return e;
+    }
+    return NULL;
+}
+
+static void sub_cache_store(const mp_osd_obj_t *obj, const sub_layout_key_t *key, int len)
+{
+    sub_layout_cache_t *e = &sub_cache[0];
+    int i, size = obj->stride * (obj->bbox.y2 - obj->bbox.y1);
+
+    for (i = 1; i < SUB_CACHE_SIZE; i++)
+        if (sub_cache[i].last_use < e->last_use)
+            e = &sub_cache[i];
+    if (e->len < size) {
+        av_freep(&e->bitmap);
+        av_freep(&e->alpha);
+        e->bitmap = av_malloc(size);
+        e->alpha  = av_malloc(size);
+    }
+    free(e->text);
+    e->text = malloc(len);
+    if (!e->text || !e->bitmap || !e->alpha) {
+        free(e->text);
+        av_freep(&e->bitmap);
+        av_freep(&e->alpha);
+        memset(e, 0, sizeof(*e));
+        return;
+    }
+    memcpy(e->text, sub_cache_text, len);
+    e->text_len  = len;
+    e->key       = *key;
+    e->last_use  = ++sub_cache_clock;
+    e->x         = obj->x;
+    e->y         = obj->y;
+    e->bbox      = obj->bbox;
+    e->alignment = obj->alignment;
+    e->stride    = obj->stride;
+    e->len       = FFMAX(e->len, size);
+    memcpy(e->bitmap, obj->bitmap_buffer, size);
+    memcpy(e->alpha,  obj->alpha_buffer,  size);
+}
+
+static void sub_cache_restore(mp_osd_obj_t *obj, sub_layout_cache_t *e)
+{
+    int size;
+
+    e->last_use    = ++sub_cache_clock;
+    obj->x         = e->x;
+    obj->y         = e->y;
+    obj->bbox      = e->bbox;
+    obj->alignment = e->alignment;
+    obj->flags    |= OSDFLAG_BBOX;
+    size = resize_buf(obj);
+    memcpy(obj->bitmap_buffer, e->bitmap, size);
+    memcpy(obj->alpha_buffer,  e->alpha,  size);
+}
+
 static inline void vo_update_text_sub(mp_osd_obj_t *obj, int dxs, int dys)
 {
    unsigned char *t;
@@ -411,6 +669,9 @@ static inline void vo_update_text_sub(mp_osd_obj_t *obj, int dxs, int dys)
    int xmin=dxs,xmax=0;
    int h,lasth;
    int xtblc, utblc;
+   sub_layout_key_t key;
+   sub_layout_cache_t *cached;
+   int text_len;
 
    obj->flags|=OSDFLAG_CHANGED|OSDFLAG_VISIBLE;
 
@@ -419,6 +680,13 @@ static inline void vo_update_text_sub(mp_osd_obj_t *obj, int dxs, int dys)
        return;
    }
 
+   sub_cache_key(&key, obj, dxs, dys);
+   text_len = sub_cache_join();
+   if (text_len >= 0 && (cached = sub_cache_find(&key, text_len))) {
+       sub_cache_restore(obj, cached);
+       return;
+   }
+
    obj->bbox.y2=obj->y=dys;
    obj->params.subtitle.lines=0;
 
@@ -428,22 +696,25 @@ static inline void vo_update_text_sub(mp_osd_obj_t *obj, int dxs, int dys)
       l=vo_sub->lines;
 
     {
-	struct osd_text_t *osl, *cp_ott, *tmp_ott, *tmp;
-	struct osd_text_p *otp_sub = NULL, *otp_sub_tmp,	// these are used to store the whole sub text osd
-	                  *otp, *tmp_otp, *pmt;	// these are used to manage sub text osd coming from a single sub line
-	int *char_seq, char_position, xlimit = dxs * sub_width_p / 100, counter;
+	int xlimit = dxs * sub_width_p / 100, word_start, first;
+	struct osd_text_p *line;
+
+	layout.num_words = layout.num_chars = layout.num_lines = 0;
 
       while (l) {
 	    xsize = -sub_font->charspace;
 	  l--;
 	  t=vo_sub->text[i++];
-	    char_position = 0;
-	    char_seq = calloc(strlen(t), sizeof(int));
+	    if (!layout_reserve(&layout.chars, &layout.chars_size,
+	                        layout.num_chars + strlen(t), sizeof(int)) ||
+	        !layout_reserve(&layout.words, &layout.words_size,
+	                        layout.num_words + strlen(t) + 1, sizeof(*layout.words)))
+		break;
+	    word_start = layout.num_chars;
+	    first = layout.num_words;
 
 	  prevc = -1;
 
-	    otp = NULL;
-	    osl = NULL;
 	    x = 1;
 
 	    // reading the subtitle words from vo_sub->text[]
@@ -460,23 +731,8 @@ static inline void vo_update_text_sub(mp_osd_obj_t *obj, int dxs, int dys)
 	      render_one_glyph(sub_font, c);
 
 		if (c == ' ') {
-		    struct osd_text_t *tmp_ott = calloc(1, sizeof(struct osd_text_t));
-
-		    if (osl == NULL) {
-			osl = cp_ott = tmp_ott;
-		    } else {
-			tmp_ott->prev = cp_ott;
-			cp_ott->next = tmp_ott;
-			tmp_ott->osd_kerning =
-			    sub_font->charspace + sub_font->width[' '];
-			cp_ott = tmp_ott;
-		    }
-		    tmp_ott->osd_length = xsize;
-		    tmp_ott->text_length = char_position;
-		    tmp_ott->text = malloc(char_position * sizeof(int));
-		    for (counter = 0; counter < char_position; ++counter)
-			tmp_ott->text[counter] = char_seq[counter];
-		    char_position = 0;
+		    layout_add_word(layout.num_words == first, xsize, word_start);
+		    word_start = layout.num_chars;
 		    xsize = 0;
 		    prevc = c;
 		} else {
@@ -485,7 +741,7 @@ static inline void vo_update_text_sub(mp_osd_obj_t *obj, int dxs, int dys)
 		    if (xsize + delta_xsize <= dxs) {
 			if (!x) x = 1;
 			prevc = c;
-			char_seq[char_position++] = c;
+			layout.chars[layout.num_chars++] = c;
 			xsize += delta_xsize;
 			if ((!suboverlap_enabled) && ((font = sub_font->font[c]) >= 0)) {
 			    if (sub_font->pic_a[font]->h > h) {
@@ -501,136 +757,12 @@ static inline void vo_update_text_sub(mp_osd_obj_t *obj, int dxs, int dys)
 		}
 	    }// for len (all words from subtitle line read)
 
-	    // osl holds an ordered (as they appear in the lines) chain of the subtitle words
-	    {
-		struct osd_text_t *tmp_ott = calloc(1, sizeof(struct osd_text_t));
-
-		if (osl == NULL) {
-		    osl = cp_ott = tmp_ott;
-		} else {
-		    tmp_ott->prev = cp_ott;
-		    cp_ott->next = tmp_ott;
-		    tmp_ott->osd_kerning =
-			sub_font->charspace + sub_font->width[' '];
-		    cp_ott = tmp_ott;
-		}
-		tmp_ott->osd_length = xsize;
-		tmp_ott->text_length = char_position;
-		tmp_ott->text = malloc(char_position * sizeof(int));
-		for (counter = 0; counter < char_position; ++counter)
-		    tmp_ott->text[counter] = char_seq[counter];
-		char_position = 0;
-		xsize = -sub_font->charspace;
-	    }
-	    free(char_seq);
-
-	    if (osl != NULL) {
-		int value = 0, exit = 0, minimum = 0;
-
-		// otp will contain the chain of the osd subtitle lines coming from the single vo_sub line.
-		otp = tmp_otp = calloc(1, sizeof(struct osd_text_p));
-		tmp_otp->ott = osl;
-		for (tmp_ott = tmp_otp->ott; exit == 0; ) {
-		    do {
-			value += tmp_ott->osd_kerning + tmp_ott->osd_length;
-			tmp_ott = tmp_ott->next;
-		    } while ((tmp_ott != NULL) && (value + tmp_ott->osd_kerning + tmp_ott->osd_length <= xlimit));
-		    if (tmp_ott != NULL) {
-			struct osd_text_p *tmp = calloc(1, sizeof(struct osd_text_p));
-
-			tmp_otp->value = value;
-			tmp_otp->next = tmp;
-			tmp->prev = tmp_otp;
-			tmp_otp = tmp;
-			tmp_otp->ott = tmp_ott;
-			value = -2 * sub_font->charspace - sub_font->width[' '];
-		    } else {
-			tmp_otp->value = value;
-			exit = 1;
-		    }
-		}
-
-
-#ifdef NEW_SPLITTING
-		// minimum holds the 'sum of the differences in length among the lines',
-		// a measure of the evenness of the lengths of the lines
-		for (tmp_otp = otp; tmp_otp->next != NULL; tmp_otp = tmp_otp->next) {
-		    pmt = tmp_otp->next;
-		    while (pmt != NULL) {
-			minimum += abs(tmp_otp->value - pmt->value);
-			pmt = pmt->next;
-		    }
-		}
-
-		if (otp->next != NULL) {
-		    int mem1, mem2;
-		    struct osd_text_p *mem, *hold;
-
-		    exit = 0;
-		    // until the last word of a line can be moved to the beginning of following line
-		    // reducing the 'sum of the differences in length among the lines', it is done
-		    while (exit == 0) {
-			hold = NULL;
-			exit = 1;
-			for (tmp_otp = otp; tmp_otp->next != NULL; tmp_otp = tmp_otp->next) {
-			    pmt = tmp_otp->next;
-			    for (tmp = tmp_otp->ott; tmp->next != pmt->ott; tmp = tmp->next);
-			    if (pmt->value + tmp->osd_length + pmt->ott->osd_kerning <= xlimit) {
-				mem1 = tmp_otp->value;
-				mem2 = pmt->value;
-				tmp_otp->value = mem1 - tmp->osd_length - tmp->osd_kerning;
-				pmt->value = mem2 + tmp->osd_length + pmt->ott->osd_kerning;
-
-				value = 0;
-				for (mem = otp; mem->next != NULL; mem = mem->next) {
-				    pmt = mem->next;
-				    while (pmt != NULL) {
-					value += abs(mem->value - pmt->value);
-					pmt = pmt->next;
-				    }
-				}
-				if (value < minimum) {
-				    minimum = value;
-				    hold = tmp_otp;
-				    exit = 0;
-				}
-				tmp_otp->value = mem1;
-				tmp_otp->next->value = mem2;
-			    }
-			}
-			// merging
-			if (exit == 0) {
-			    tmp_otp = hold;
-			    pmt = tmp_otp->next;
-			    for (tmp = tmp_otp->ott; tmp->next != pmt->ott; tmp = tmp->next);
-			    mem1 = tmp_otp->value;
-			    mem2 = pmt->value;
-			    tmp_otp->value = mem1 - tmp->osd_length - tmp->osd_kerning;
-			    pmt->value = mem2 + tmp->osd_length + pmt->ott->osd_kerning;
-			    pmt->ott = tmp;
-			}//~merging
-		    }//~while(exit == 0)
-		}//~if(otp->next!=NULL)
-#endif
+	    // the words array holds, in order, the words of all subtitle lines
+	    layout_add_word(layout.num_words == first, xsize, word_start);
 
-		// adding otp (containing splitted lines) to otp chain
-		if (otp_sub == NULL) {
-		    otp_sub = otp;
-		    for (otp_sub_tmp = otp_sub; otp_sub_tmp->next != NULL; otp_sub_tmp = otp_sub_tmp->next);
-		} else {
-		    //updating ott chain
-		    tmp = otp_sub->ott;
-		    while (tmp->next != NULL) tmp = tmp->next;
-		    tmp->next = otp->ott;
-		    otp->ott->prev = tmp;
-		    //attaching new subtitle line at the end
-		    otp_sub_tmp->next = otp;
-		    otp->prev = otp_sub_tmp;
-		    do
-			otp_sub_tmp = otp_sub_tmp->next;
-		    while (otp_sub_tmp->next != NULL);
-		}
-	    }//~ if(osl != NULL)
+	    // split the words of this subtitle line into osd lines
+	    if (!layout_split_line(first, xlimit))
+		break;
 	} // while
 
 	// write lines into utbl
@@ -638,7 +770,9 @@ static inline void vo_update_text_sub(mp_osd_obj_t *obj, int dxs, int dys)
 	utblc = 0;
 	obj->y = dys;
 	obj->params.subtitle.lines = 0;
-	for (tmp_otp = otp_sub; tmp_otp != NULL; tmp_otp = tmp_otp->next) {
+	for (line = layout.lines; line < layout.lines + layout.num_lines; line++) {
+	    int end = line + 1 < layout.lines + layout.num_lines ? line[1].word : layout.num_words;
+	    int w;
 
 	    if ((obj->params.subtitle.lines++) >= MAX_UCSLINES)
 		break;
@@ -647,20 +781,20 @@ static inline void vo_update_text_sub(mp_osd_obj_t *obj, int dxs, int dys)
 		obj->y -= lasth - sub_font->height;	// correct the y position
 		break;
 	    }
-	    xsize = tmp_otp->value;
+	    xsize = line->value;
 	    obj->params.subtitle.xtbl[xtblc++] = (dxs - xsize) / 2;
 	    if (xmin > (dxs - xsize) / 2)
 		xmin = (dxs - xsize) / 2;
 	    if (xmax < (dxs + xsize) / 2)
 		xmax = (dxs + xsize) / 2;
 
-	    tmp = (tmp_otp->next == NULL) ? NULL : tmp_otp->next->ott;
-	    for (tmp_ott = tmp_otp->ott; tmp_ott != tmp; tmp_ott = tmp_ott->next) {
-		for (counter = 0; counter < tmp_ott->text_length; ++counter) {
+	    for (w = line->word; w < end; w++) {
+		const struct osd_text_t *word = &layout.words[w];
+		for (counter = 0; counter < word->text_length; ++counter) {
 		    if (utblc > MAX_UCS) {
 			break;
 		    }
-		    c = tmp_ott->text[counter];
+		    c = layout.chars[word->text + counter];
 		    render_one_glyph(sub_font, c);
 		    obj->params.subtitle.utbl[utblc++] = c;
 		    k++;
@@ -674,22 +808,6 @@ static inline void vo_update_text_sub(mp_osd_obj_t *obj, int dxs, int dys)
 	}
 	if(obj->params.subtitle.lines)
 	    obj->y = dys - ((obj->params.subtitle.lines - 1) * sub_font->height + sub_font->pic_a[sub_font->font[40]]->h);
-
-	// free memory
-	if (otp_sub != NULL) {
-	    for (tmp = otp_sub->ott; tmp->next != NULL; free(tmp->prev)) {
-		free(tmp->text);
-		tmp = tmp->next;
-	    }
-	    free(tmp->text);
-	    free(tmp);
-
-	    for(pmt = otp_sub; pmt->next != NULL; free(pmt->prev)) {
-		pmt = pmt->next;
-	    }
-	    free(pmt);
-	}
-
     }
     /// vertical alignment
     h = dys - obj->y;
@@ -775,6 +893,8 @@ static inline void vo_update_text_sub(mp_osd_obj_t *obj, int dxs, int dys)
 	}
     }
 
+    if (text_len >= 0)
+        sub_cache_store(obj, &key, text_len);
 }
 
 static int draw_alpha_init_flag=0;
@@ -805,6 +925,7 @@ void free_osd_list(void){
 	obj=next;
     }
     vo_osd_list=NULL;
+    sub_cache_flush();
 }
 
 #define FONT_LOAD_DEFER 6
@@ -835,6 +956,8 @@ static int vo_update_osd_ext(int dxs,int dys, int left_border, int top_border,
 	if (defer_counter >= FONT_LOAD_DEFER) force_load_font = 1;
     }
 
+    if (force_load_font || !sub_font)
+	sub_cache_flush();
     if (force_load_font) {
 	force_load_font = 0;
         load_font_ft(dxs, dys, &vo_font, font_name, osd_font_scale_factor);
@@ -27,7 +27,10 @@
 #include <ctype.h>
 
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <dirent.h>
+#include <pthread.h>
+#include <time.h>
 
 #include "config.h"
 #include "mp_msg.h"
@@ -47,15 +50,37 @@ char *enca_sub_cp=NULL;
 
 /* Maximal length of line of a subtitle */
 #define LINE_LEN 1000
-static float mpsub_position=0;
-static float mpsub_multiplier=1.;
-static int sub_slacktime = 20000; //20 sec
+
+/* What the line readers carry from one subtitle to the next. Every load
+ * has its own, so several files can be parsed at the same time. */
+struct sub_read_state {
+    float mpsub_position;
+    float mpsub_multiplier;
+    int slacktime;
+    char sami_line[LINE_LEN+1];
+    char *sami_s;
+    int ssa_max_comma;
+    unsigned jaco_timeres;
+    int jaco_shift;
+};
+
+static void sub_read_state_init(struct sub_read_state *rs, int uses_time)
+{
+    memset(rs, 0, sizeof(*rs));
+    rs->mpsub_multiplier = uses_time ? 100.0 : 1.0;
+    rs->slacktime = 20000; //20 sec
+    rs->ssa_max_comma = 32; /* let's use 32 for the case that the */
+                /*  amount of commas increase with newer SSA versions */
+    rs->jaco_timeres = 30;
+}
 
 int sub_no_text_pp=0;   // 1 => do not apply text post-processing
                         // like {\...} elimination in SSA format.
 
 int sub_match_fuzziness=0; // level of sub name matching fuzziness
 
+int sub_stream_load=0; // 1 => parse subtitle files in a background thread
+
 /* Use the SUB_* constant defined in the header file */
 int sub_format=SUB_INVALID;
 
@@ -96,9 +121,9 @@ static void sami_add_line(subtitle *current, char *buffer, char **pos) {
     *pos = buffer;
 }
 
-static subtitle *sub_read_line_sami(stream_t* st, subtitle *current, int utf16) {
-    static char line[LINE_LEN+1];
-    static char *s = NULL, *slacktime_s;
+static subtitle *sub_read_line_sami(stream_t* st, subtitle *current, int utf16,
+                                 struct sub_read_state *rs) {
+    char *line = rs->sami_line, *s = rs->sami_s, *slacktime_s;
     char text[LINE_LEN+1], *p=NULL, *q;
     int state;
 
@@ -116,7 +141,7 @@ static subtitle *sub_read_line_sami(stream_t* st, subtitle *current, int utf16)
 	case 0: /* find "START=" or "Slacktime:" */
 	    slacktime_s = stristr (s, "Slacktime:");
 	    if (slacktime_s)
-                sub_slacktime = strtol (slacktime_s+10, NULL, 0) / 10;
+                rs->slacktime = strtol (slacktime_s+10, NULL, 0) / 10;
 
 	    s = stristr (s, "Start=");
 	    if (s) {
@@ -219,6 +244,7 @@ static subtitle *sub_read_line_sami(stream_t* st, subtitle *current, int utf16)
 	    if (current->start > 0) {
 		break; // if it is the last subtitle
 	    } else {
+		rs->sami_s = NULL;
 		return 0;
 	    }
 	}
@@ -227,10 +253,11 @@ static subtitle *sub_read_line_sami(stream_t* st, subtitle *current, int utf16)
 
     // For the last subtitle
     if (current->end <= 0) {
-        current->end = current->start + sub_slacktime;
+        current->end = current->start + rs->slacktime;
         sami_add_line(current, text, &p);
     }
 
+    rs->sami_s = s;
     return current;
 }
 
@@ -273,7 +300,8 @@ static subtitle *set_multiline_text(subtitle *current, const char *text, int sta
     return current;
 }
 
-static subtitle *sub_read_line_microdvd(stream_t *st,subtitle *current, int utf16) {
+static subtitle *sub_read_line_microdvd(stream_t *st,subtitle *current, int utf16,
+                                 struct sub_read_state *rs) {
     char line[LINE_LEN+1];
     char line2[LINE_LEN+1];
     char *p;
@@ -292,7 +320,8 @@ static subtitle *sub_read_line_microdvd(stream_t *st,subtitle *current, int utf1
     return set_multiline_text(current, p, 0);
 }
 
-static subtitle *sub_read_line_mpl2(stream_t *st,subtitle *current, int utf16) {
+static subtitle *sub_read_line_mpl2(stream_t *st,subtitle *current, int utf16,
+                                 struct sub_read_state *rs) {
     char line[LINE_LEN+1];
     char line2[LINE_LEN+1];
 
@@ -307,7 +336,8 @@ static subtitle *sub_read_line_mpl2(stream_t *st,subtitle *current, int utf16) {
     return set_multiline_text(current, line2, 0);
 }
 
-static subtitle *sub_read_line_subrip(stream_t* st, subtitle *current, int utf16) {
+static subtitle *sub_read_line_subrip(stream_t* st, subtitle *current, int utf16,
+                                 struct sub_read_state *rs) {
     char line[LINE_LEN+1];
     int a1,a2,a3,a4,b1,b2,b3,b4;
     char *p=NULL, *q=NULL;
@@ -337,7 +367,8 @@ static subtitle *sub_read_line_subrip(stream_t* st, subtitle *current, int utf16
     return current;
 }
 
-static subtitle *sub_read_line_subviewer(stream_t *st,subtitle *current, int utf16) {
+static subtitle *sub_read_line_subviewer(stream_t *st,subtitle *current, int utf16,
+                                 struct sub_read_state *rs) {
     char line[LINE_LEN+1];
     int a1,a2,a3,a4,b1,b2,b3,b4;
     char *p=NULL;
@@ -389,7 +420,8 @@ static subtitle *sub_read_line_subviewer(stream_t *st,subtitle *current, int utf
     return current;
 }
 
-static subtitle *sub_read_line_subviewer2(stream_t *st,subtitle *current, int utf16) {
+static subtitle *sub_read_line_subviewer2(stream_t *st,subtitle *current, int utf16,
+                                 struct sub_read_state *rs) {
     char line[LINE_LEN+1];
     int a1,a2,a3,a4;
     char *p=NULL;
@@ -422,7 +454,8 @@ static subtitle *sub_read_line_subviewer2(stream_t *st,subtitle *current, int ut
 }
 
 
-static subtitle *sub_read_line_vplayer(stream_t *st,subtitle *current, int utf16) {
+static subtitle *sub_read_line_vplayer(stream_t *st,subtitle *current, int utf16,
+                                 struct sub_read_state *rs) {
 	char line[LINE_LEN+1];
 	int a1,a2,a3;
 	char *p=NULL, separator;
@@ -461,7 +494,8 @@ static subtitle *sub_read_line_vplayer(stream_t *st,subtitle *current, int utf16
 	return current;
 }
 
-static subtitle *sub_read_line_google(stream_t *st, subtitle *current, int utf16)
+static subtitle *sub_read_line_google(stream_t *st, subtitle *current, int utf16,
+                                 struct sub_read_state *rs)
 {
     uint8_t part[LINE_LEN+1];
     uint8_t *p;
@@ -489,7 +523,8 @@ static subtitle *sub_read_line_google(stream_t *st, subtitle *current, int utf16
     return current;
 }
 
-static subtitle *sub_read_line_rt(stream_t *st,subtitle *current, int utf16) {
+static subtitle *sub_read_line_rt(stream_t *st,subtitle *current, int utf16,
+                                 struct sub_read_state *rs) {
 	//TODO: This format uses quite rich (sub/super)set of xhtml
 	// I couldn't check it since DTD is not included.
 	// WARNING: full XML parses can be required for proper parsing
@@ -575,7 +610,8 @@ static subtitle *sub_read_line_rt(stream_t *st,subtitle *current, int utf16) {
     return current;
 }
 
-static subtitle *sub_read_line_ssa(stream_t *st,subtitle *current, int utf16) {
+static subtitle *sub_read_line_ssa(stream_t *st,subtitle *current, int utf16,
+                                 struct sub_read_state *rs) {
 /*
  * Sub Station Alpha v4 (and v2?) scripts have 9 commas before subtitle
  * other Sub Station Alpha scripts have only 8 commas before subtitle
@@ -586,8 +622,6 @@ static subtitle *sub_read_line_ssa(stream_t *st,subtitle *current, int utf16) {
  * http://www.eswat.demon.co.uk is where the SSA specs can be found
  */
         int comma;
-        static int max_comma = 32; /* let's use 32 for the case that the */
-                    /*  amount of commas increase with newer SSA versions */
 
 	int hour1, min1, sec1, hunsec1,
 	    hour2, min2, sec2, hunsec2, nothing;
@@ -617,7 +651,7 @@ static subtitle *sub_read_line_ssa(stream_t *st,subtitle *current, int utf16) {
         if (!line2) return NULL;
         brace = strchr(line2, '{');
 
-        for (comma = 4; comma < max_comma; comma ++)
+        for (comma = 4; comma < rs->ssa_max_comma; comma ++)
           {
             tmp = line2;
             if(!(tmp=strchr(++tmp, ','))) break;
@@ -627,7 +661,7 @@ static subtitle *sub_read_line_ssa(stream_t *st,subtitle *current, int utf16) {
             line2 = tmp;
           }
 
-        if(comma < max_comma)max_comma = comma;
+        if(comma < rs->ssa_max_comma)rs->ssa_max_comma = comma;
 	/* eliminate the trailing comma */
 	if(*line2 == ',') line2++;
 
@@ -680,7 +714,8 @@ static void sub_pp_ssa(subtitle *sub) {
  *
  * by set, based on code by szabi (dunnowhat sub format ;-)
  */
-static subtitle *sub_read_line_pjs(stream_t *st,subtitle *current, int utf16) {
+static subtitle *sub_read_line_pjs(stream_t *st,subtitle *current, int utf16,
+                                 struct sub_read_state *rs) {
     char line[LINE_LEN+1];
     char text[LINE_LEN+1], *s, *d;
 
@@ -718,7 +753,8 @@ static subtitle *sub_read_line_pjs(stream_t *st,subtitle *current, int utf16) {
     return current;
 }
 
-static subtitle *sub_read_line_mpsub(stream_t *st, subtitle *current, int utf16) {
+static subtitle *sub_read_line_mpsub(stream_t *st, subtitle *current, int utf16,
+                                 struct sub_read_state *rs) {
 	char line[LINE_LEN+1];
 	float a,b;
 	int num=0;
@@ -729,10 +765,10 @@ static subtitle *sub_read_line_mpsub(stream_t *st, subtitle *current, int utf16)
 		if (!stream_read_line(st, line, LINE_LEN, utf16)) return NULL;
 	} while (sscanf (line, "%f %f", &a, &b) !=2);
 
-	mpsub_position += a*mpsub_multiplier;
-	current->start=(int) mpsub_position;
-	mpsub_position += b*mpsub_multiplier;
-	current->end=(int) mpsub_position;
+	rs->mpsub_position += a*rs->mpsub_multiplier;
+	current->start=(int) rs->mpsub_position;
+	rs->mpsub_position += b*rs->mpsub_multiplier;
+	current->end=(int) rs->mpsub_position;
 
 	while (num < SUB_MAX_TEXT) {
 		if (!stream_read_line (st, line, LINE_LEN, utf16)) {
@@ -761,7 +797,8 @@ static subtitle *sub_read_line_mpsub(stream_t *st, subtitle *current, int utf16)
 //we don't need this if we use previous_sub_end
 subtitle *previous_aqt_sub = NULL;
 
-static subtitle *sub_read_line_aqt(stream_t *st,subtitle *current, int utf16) {
+static subtitle *sub_read_line_aqt(stream_t *st,subtitle *current, int utf16,
+                                 struct sub_read_state *rs) {
     char line[LINE_LEN+1];
 
 retry:
@@ -802,7 +839,8 @@ retry:
 
 subtitle *previous_subrip09_sub = NULL;
 
-static subtitle *sub_read_line_subrip09(stream_t *st,subtitle *current, int utf16) {
+static subtitle *sub_read_line_subrip09(stream_t *st,subtitle *current, int utf16,
+                                 struct sub_read_state *rs) {
     char line[LINE_LEN+1];
     int a1,a2,a3;
     int len;
@@ -840,12 +878,11 @@ retry:
     return current;
 }
 
-static subtitle *sub_read_line_jacosub(stream_t* st, subtitle * current, int utf16)
+static subtitle *sub_read_line_jacosub(stream_t* st, subtitle * current, int utf16,
+                                 struct sub_read_state *rs)
 {
     char line1[LINE_LEN], line2[LINE_LEN], directive[LINE_LEN], *p, *q;
     unsigned a1, a2, a3, a4, b1, b2, b3, b4, comment = 0;
-    static unsigned jacoTimeres = 30;
-    static int jacoShift = 0;
 
     memset(current, 0, sizeof(subtitle));
     memset(line1, 0, LINE_LEN);
@@ -862,7 +899,7 @@ static subtitle *sub_read_line_jacosub(stream_t* st, subtitle * current, int utf
 		if (line1[0] == '#') {
 		    int hours = 0, minutes = 0, seconds, delta, inverter =
 			1;
-		    unsigned units = jacoShift;
+		    unsigned units = rs->jaco_shift;
 		    switch (toupper(line1[1])) {
 		    case 'S':
 			if (isalpha(line1[2])) {
@@ -893,9 +930,9 @@ static subtitle *sub_read_line_jacosub(stream_t* st, subtitle * current, int utf
 				       &units);
 				seconds *= inverter;
 			    }
-			    jacoShift =
+			    rs->jaco_shift =
 				((hours * 3600 + minutes * 60 +
-				  seconds) * jacoTimeres +
+				  seconds) * rs->jaco_timeres +
 				 units) * inverter;
 			}
 			break;
@@ -905,28 +942,28 @@ static subtitle *sub_read_line_jacosub(stream_t* st, subtitle * current, int utf
 			} else {
 			    delta = 2;
 			}
-			sscanf(&line1[delta], "%u", &jacoTimeres);
+			sscanf(&line1[delta], "%u", &rs->jaco_timeres);
 			break;
 		    }
 		}
 		continue;
 	    } else {
 		current->start =
-		    (unsigned long) ((a4 + jacoShift) * 100.0 /
-				     jacoTimeres);
+		    (unsigned long) ((a4 + rs->jaco_shift) * 100.0 /
+				     rs->jaco_timeres);
 		current->end =
-		    (unsigned long) ((b4 + jacoShift) * 100.0 /
-				     jacoTimeres);
+		    (unsigned long) ((b4 + rs->jaco_shift) * 100.0 /
+				     rs->jaco_timeres);
 	    }
 	} else {
 	    current->start =
 		(unsigned
-		 long) (((a1 * 3600 + a2 * 60 + a3) * jacoTimeres + a4 +
-			 jacoShift) * 100.0 / jacoTimeres);
+		 long) (((a1 * 3600 + a2 * 60 + a3) * rs->jaco_timeres + a4 +
+			 rs->jaco_shift) * 100.0 / rs->jaco_timeres);
 	    current->end =
 		(unsigned
-		 long) (((b1 * 3600 + b2 * 60 + b3) * jacoTimeres + b4 +
-			 jacoShift) * 100.0 / jacoTimeres);
+		 long) (((b1 * 3600 + b2 * 60 + b3) * rs->jaco_timeres + b4 +
+			 rs->jaco_shift) * 100.0 / rs->jaco_timeres);
 	}
 	current->lines = 0;
 	p = line2;
@@ -1121,12 +1158,12 @@ void	subcp_close (void)
 	}
 }
 
-void subcp_recode (subtitle *sub)
+static void sub_recode(iconv_t cd, subtitle *sub)
 {
 	int l=sub->lines;
 	size_t ileft, oleft;
 	char *op, *ip, *ot;
-	if(icdsc == (iconv_t)(-1)) return;
+	if(cd == (iconv_t)(-1)) return;
 
 	while (l){
 		ip = sub->text[--l];
@@ -1138,14 +1175,14 @@ void subcp_recode (subtitle *sub)
 		   	continue;
 		}
 		op = ot;
-		if (iconv(icdsc, &ip, &ileft,
+		if (iconv(cd, &ip, &ileft,
 			  &op, &oleft) == (size_t)(-1)) {
 			mp_msg(MSGT_SUBREADER,MSGL_WARN,"SUB: error recoding line.\n");
 			free(ot);
 			continue;
 		}
 		// In some stateful encodings, we must clear the state to handle the last character
-		if (iconv(icdsc, NULL, NULL,
+		if (iconv(cd, NULL, NULL,
 			  &op, &oleft) == (size_t)(-1)) {
 			mp_msg(MSGT_SUBREADER,MSGL_WARN,"SUB: error recoding line, can't clear encoding state.\n");
 		}
@@ -1156,6 +1193,11 @@ void subcp_recode (subtitle *sub)
 	return;
 }
 
+void subcp_recode (subtitle *sub)
+{
+	sub_recode(icdsc, sub);
+}
+
 
 /**
  * Do conversion necessary for right-to-left language support via fribidi.
@@ -1228,125 +1270,24 @@ static void adjust_subs_time(subtitle* sub, float subtime, float fps, int block,
 }
 
 struct subreader {
-    subtitle * (*read)(stream_t *st,subtitle *dest,int utf16);
+    subtitle * (*read)(stream_t *st,subtitle *dest,int utf16,
+                       struct sub_read_state *rs);
     void       (*post)(subtitle *dest);
     const char *name;
 };
 
-sub_data* sub_read_file (const char *filename, float fps) {
-    int utf16;
-    stream_t* fd;
-    int n_max, n_first, i, j, sub_first, sub_orig;
-    subtitle *first, *second, *sub, *return_sub, *alloced_sub = NULL;
-    sub_data *subt_data;
-    int uses_time = 0, sub_num = 0, sub_errs = 0;
-    static const struct subreader sr[]=
-    {
-	    { sub_read_line_microdvd, NULL, "microdvd" },
-	    { sub_read_line_subrip, NULL, "subrip" },
-	    { sub_read_line_subviewer, NULL, "subviewer" },
-	    { sub_read_line_sami, NULL, "sami" },
-	    { sub_read_line_vplayer, NULL, "vplayer" },
-	    { sub_read_line_rt, NULL, "rt" },
-	    { sub_read_line_ssa, sub_pp_ssa, "ssa" },
-	    { sub_read_line_pjs, NULL, "pjs" },
-	    { sub_read_line_mpsub, NULL, "mpsub" },
-	    { sub_read_line_aqt, NULL, "aqt" },
-	    { sub_read_line_subviewer2, NULL, "subviewer 2.0" },
-	    { sub_read_line_subrip09, NULL, "subrip 0.9" },
-	    { sub_read_line_jacosub, NULL, "jacosub" },
-	    { sub_read_line_mpl2, NULL, "mpl2" },
-	    { sub_read_line_google, NULL, "google" },
-    };
-    const struct subreader *srp;
-
-    if(filename==NULL) return NULL; //qnx segfault
-    fd=open_stream (filename, NULL, NULL); if (!fd) return NULL;
-
-    sub_format = SUB_INVALID;
-    for (utf16 = 0; sub_format == SUB_INVALID && utf16 < 3; utf16++) {
-        sub_format=sub_autodetect (fd, &uses_time, utf16);
-        stream_reset(fd);
-        stream_seek(fd,0);
-    }
-    utf16--;
-
-    mpsub_multiplier = (uses_time ? 100.0 : 1.0);
-    if (sub_format==SUB_INVALID) {mp_msg(MSGT_SUBREADER,MSGL_WARN,"SUB: Could not determine file format\n");return NULL;}
-    srp=sr+sub_format;
-    mp_msg(MSGT_SUBREADER, MSGL_V, "SUB: Detected subtitle file format: %s\n", srp->name);
-
-    sub_utf8_prev=sub_utf8;
-    {
-	    int l,k;
-	    k = -1;
-	    if ((l=strlen(filename))>4){
-		    static const char exts[][8] = {".utf", ".utf8", ".utf-8" };
-		    for (k=3;--k>=0;)
-			if (l >= strlen(exts[k]) && !av_strcasecmp(filename+(l - strlen(exts[k])), exts[k])){
-			    sub_utf8 = 1;
-			    break;
-			}
-	    }
-	    if (k<0) subcp_open(fd);
-    }
-
-    sub_num=0;n_max=32;
-    first=malloc(n_max*sizeof(subtitle));
-    if(!first){
-	  subcp_close();
-          sub_utf8=sub_utf8_prev;
-	    return NULL;
-    }
-
-    while(1){
-        if(sub_num>=n_max){
-            n_max+=16;
-            first=realloc(first,n_max*sizeof(subtitle));
-        }
-	sub = &first[sub_num];
-	memset(sub, '\0', sizeof(subtitle));
-        sub=srp->read(fd,sub,utf16);
-        if(!sub) break;   // EOF
-	if ((sub!=ERR) && sub_utf8 == 2 && utf16 == 0) subcp_recode(sub);
-	if ( sub == ERR || !sub_fribidi(sub,sub_utf8,0))
-	 {
-          subcp_close();
-	  free(first);
-	  free(alloced_sub);
-	  return NULL;
-	 }
-        // Apply any post processing that needs recoding first
-        if ((sub!=ERR) && !sub_no_text_pp && srp->post) srp->post(sub);
-        if(sub==ERR) ++sub_errs; else ++sub_num; // Error vs. Valid
-    }
-
-    free_stream(fd);
-
-    subcp_close();
-    free(alloced_sub);
-
-//    printf ("SUB: Subtitle format %s time.\n", uses_time?"uses":"doesn't use");
-    mp_msg(MSGT_SUBREADER, MSGL_V,"SUB: Read %i subtitles, %i bad line(s).\n",
-           sub_num, sub_errs);
-
-    if(sub_num<=0){
-	free(first);
-	return NULL;
-    }
+/**
+ * \brief Turn the blocks of overlapping subtitles in first[] into
+ * sequences of non-overlapping ones, each line keeping its screen position.
+ * Frees the texts of first[], but not the array itself.
+ * \param num set to the number of entries in the returned array
+ */
+static subtitle *sub_merge_overlaps(subtitle *first, int n_first, int *num)
+{
+    int n_max, sub_first, i, j;
+    int sub_num = 0;
+    subtitle *second = NULL;
 
-    // we do overlap if the user forced it (suboverlap_enable == 2) or
-    // the user didn't forced no-overlapsub and the format is Jacosub or Ssa.
-    // this is because usually overlapping subtitles are found in these formats,
-    // while in others they are probably result of bad timing
-if ((suboverlap_enabled == 2) ||
-    ((suboverlap_enabled) && ((sub_format == SUB_JACOSUB) || (sub_format == SUB_SSA)))) {
-    adjust_subs_time(first, 6.0, fps, 0, sub_num, uses_time);/*~6 secs AST*/
-// here we manage overlapping subtitles
-    sub_orig = sub_num;
-    n_first = sub_num;
-    sub_num = 0;
-    second = NULL;
     // for each subtitle in first[] we deal with its 'block' of
     // bonded subtitles
     for (sub_first = 0; sub_first < n_first; ++sub_first) {
@@ -1534,11 +1475,376 @@ if ((suboverlap_enabled == 2) ||
 	sub_first += sub_to_add;
     }
 
-    for (j = sub_orig - 1; j >= 0; --j) {
+    for (j = n_first - 1; j >= 0; --j) {
 	for (i = first[j].lines - 1; i >= 0; --i) {
 	    free(first[j].text[i]);
 	}
     }
+
+    *num = sub_num;
+    return second;
+}
+
+/**
+ * \brief Whether blocks of overlapping subtitles get merged.
+ * We do overlap if the user forced it (suboverlap_enable == 2) or
+ * the user didn't forced no-overlapsub and the format is Jacosub or Ssa.
+ * This is because usually overlapping subtitles are found in these formats,
+ * while in others they are probably result of bad timing.
+ */
+static int sub_wants_overlap(void)
+{
+    return suboverlap_enabled == 2 ||
+           (suboverlap_enabled && (sub_format == SUB_JACOSUB || sub_format == SUB_SSA));
+}
+
+/* -sub-stream: the file is parsed by a thread that appends entries to
+ * sub_data.subtitles in batches, so playback starts as soon as the format
+ * is known instead of after the whole file was read. Entries are adjusted
+ * the same way as with a synchronous load, only one batch at a time: an
+ * entry is final once its successor is known, a block of overlapping
+ * subtitles once an entry starting after all of it was read. */
+
+#define SUB_STREAM_BATCH 256
+
+struct sub_loader {
+    pthread_t thread;
+    pthread_mutex_t lock;   ///< protects subtitles, sub_num and sub_errs
+    int allocated;          ///< size of the subtitles array
+    int joined;
+    int quit;               ///< set by sub_free(), checked between batches
+    int dropped;            ///< entries taken back after a read error
+
+    stream_t *fd;
+    const struct subreader *srp;
+    struct sub_read_state rs;
+    iconv_t icd;
+    int utf16;
+    int utf8;               ///< sub_utf8 when the load started
+    int overlap;
+    float fps;
+};
+
+void sub_lock(sub_data *subd)
+{
+    if (subd->loader)
+        pthread_mutex_lock(&subd->loader->lock);
+}
+
+void sub_unlock(sub_data *subd)
+{
+    if (subd->loader)
+        pthread_mutex_unlock(&subd->loader->lock);
+}
+
+static void free_sub_texts(subtitle *subs, int num)
+{
+    int i, j;
+
+    for (i = 0; i < num; i++)
+        for (j = 0; j < subs[i].lines; j++)
+            free(subs[i].text[j]);
+}
+
+static void sub_stream_append(sub_data *subd, subtitle *subs, int num)
+{
+    struct sub_loader *ld = subd->loader;
+    subtitle *p = subd->subtitles;
+
+    pthread_mutex_lock(&ld->lock);
+    if (subd->sub_num + num > ld->allocated) {
+        int allocated = FFMAX(2 * ld->allocated, subd->sub_num + num);
+        p = realloc(subd->subtitles, allocated * sizeof(subtitle));
+        if (p) {
+            subd->subtitles = p;
+            ld->allocated   = allocated;
+        }
+    }
+    if (p) {
+        memcpy(subd->subtitles + subd->sub_num, subs, num * sizeof(subtitle));
+        subd->sub_num += num;
+    }
+    pthread_mutex_unlock(&ld->lock);
+
+    if (!p) {
+        mp_msg(MSGT_SUBREADER, MSGL_WARN, "SUB: error allocating mem.\n");
+        free_sub_texts(subs, num);
+    }
+}
+
+/**
+ * \brief Adjust the entries read since the last call and publish the ones
+ * later entries cannot change any more.
+ * \param adjusted raw[0..*adjusted) already went through adjust_subs_time()
+ * \return number of entries left in raw[]
+ */
+static int sub_stream_flush(sub_data *subd, subtitle *raw, int n, int *adjusted,
+                            int eof)
+{
+    struct sub_loader *ld = subd->loader;
+    int ready, num, known;
+
+    if (n > *adjusted) {
+        adjust_subs_time(raw + *adjusted, 6.0, ld->fps, !ld->overlap,
+                         n - *adjusted, subd->sub_uses_time);
+        // the last one is adjusted again together with its successor
+        *adjusted = n - 1;
+    }
+    known = eof ? n : *adjusted;
+    ready = known;
+
+    if (ld->overlap) {
+        subtitle *merged;
+
+        // only whole blocks can be merged
+        ready = 0;
+        while (ready < known) {
+            unsigned long global_end = raw[ready].end;
+            int next;
+            for (next = ready + 1; next < known && raw[next].start < global_end; next++)
+                if (raw[next].end > global_end)
+                    global_end = raw[next].end;
+            if (next == known && !eof)
+                break;
+            ready = next;
+        }
+        if (ready) {
+            merged = sub_merge_overlaps(raw, ready, &num);
+            if (merged)
+                sub_stream_append(subd, merged, num);
+            free(merged);
+        }
+    } else if (ready)
+        sub_stream_append(subd, raw, ready);
+
+    memmove(raw, raw + ready, (n - ready) * sizeof(subtitle));
+    *adjusted = FFMAX(*adjusted - ready, 0);
+    return n - ready;
+}
+
+static void *sub_stream_thread(void *arg)
+{
+    sub_data *subd = arg;
+    struct sub_loader *ld = subd->loader;
+    subtitle *raw = NULL, *sub;
+    int n = 0, n_max = 0, adjusted = 0, eof = 0, quit = 0;
+
+    while (!eof && !quit) {
+        if (n >= n_max) {
+            n_max += SUB_STREAM_BATCH;
+            sub = realloc(raw, n_max * sizeof(subtitle));
+            if (!sub) {
+                mp_msg(MSGT_SUBREADER, MSGL_WARN, "SUB: error allocating mem.\n");
+                break;
+            }
+            raw = sub;
+        }
+        sub = &raw[n];
+        memset(sub, '\0', sizeof(subtitle));
+        sub = ld->srp->read(ld->fd, sub, ld->utf16, &ld->rs);
+        if (sub == ERR) {
+            // like a synchronous load, give up on the whole file
+            mp_msg(MSGT_SUBREADER, MSGL_ERR, "SUB: Read error in %s, dropping it.\n",
+                   subd->filename);
+            // The shown entry may still point to the texts, they are
+            // only freed by sub_free().
+            pthread_mutex_lock(&ld->lock);
+            ld->dropped = subd->sub_num;
+            subd->sub_num = 0;
+            subd->sub_errs++;
+            pthread_mutex_unlock(&ld->lock);
+            quit = 1;
+            break;
+        } else if (!sub) {
+            eof = 1;
+        } else {
+            if (ld->utf8 == 2 && ld->utf16 == 0)
+                sub_recode(ld->icd, sub);
+            // Apply any post processing that needs recoding first
+            if (!sub_no_text_pp && ld->srp->post)
+                ld->srp->post(sub);
+            n++;
+        }
+        if (eof || n - adjusted > SUB_STREAM_BATCH) {
+            n = sub_stream_flush(subd, raw, n, &adjusted, eof);
+            pthread_mutex_lock(&ld->lock);
+            quit = ld->quit;
+            pthread_mutex_unlock(&ld->lock);
+        }
+    }
+    free_sub_texts(raw, n);
+    free(raw);
+
+    free_stream(ld->fd);
+    if (ld->icd != (iconv_t)(-1))
+        iconv_close(ld->icd);
+    mp_msg(MSGT_SUBREADER, MSGL_V, "SUB: Read %i subtitles from %s in the background.\n",
+           subd->sub_num, subd->filename);
+    return NULL;
+}
+
+/**
+ * \brief Hand the rest of the load over to a background thread.
+ * The thread takes ownership of fd and the iconv descriptor.
+ * \return NULL if the thread could not be started, the caller then reads
+ *         the file itself
+ */
+static sub_data *sub_stream_start(const char *filename, stream_t *fd,
+                                  const struct subreader *srp, int utf16,
+                                  int uses_time, float fps)
+{
+    sub_data *subd = calloc(1, sizeof(sub_data));
+    struct sub_loader *ld = calloc(1, sizeof(struct sub_loader));
+
+    if (!subd || !ld || !(subd->filename = strdup(filename)))
+        goto fail;
+    subd->sub_uses_time = uses_time;
+    subd->loader = ld;
+    ld->fd       = fd;
+    ld->srp      = srp;
+    ld->utf16    = utf16;
+    ld->utf8     = sub_utf8;
+    ld->fps      = fps;
+    ld->overlap  = sub_wants_overlap();
+    ld->icd      = icdsc;
+    icdsc        = (iconv_t)(-1);
+    sub_read_state_init(&ld->rs, uses_time);
+    pthread_mutex_init(&ld->lock, NULL);
+    if (pthread_create(&ld->thread, NULL, sub_stream_thread, subd)) {
+        pthread_mutex_destroy(&ld->lock);
+        icdsc = ld->icd;
+        goto fail;
+    }
+    mp_msg(MSGT_SUBREADER, MSGL_V, "SUB: Loading %s in the background.\n", filename);
+    return subd;
+
+fail:
+    if (subd)
+        free(subd->filename);
+    free(subd);
+    free(ld);
+    return NULL;
+}
+
+/// Wait for a background load to finish.
+static void sub_stream_join(sub_data *subd)
+{
+    if (subd->loader && !subd->loader->joined) {
+        pthread_join(subd->loader->thread, NULL);
+        subd->loader->joined = 1;
+    }
+}
+
+static sub_data *read_sub_file(const char *filename, float fps)
+{
+    int utf16;
+    stream_t* fd;
+    int n_max;
+    subtitle *first, *second, *sub, *return_sub, *alloced_sub = NULL;
+    sub_data *subt_data;
+    struct sub_read_state rs;
+    int uses_time = 0, sub_num = 0, sub_errs = 0;
+    static const struct subreader sr[]=
+    {
+	    { sub_read_line_microdvd, NULL, "microdvd" },
+	    { sub_read_line_subrip, NULL, "subrip" },
+	    { sub_read_line_subviewer, NULL, "subviewer" },
+	    { sub_read_line_sami, NULL, "sami" },
+	    { sub_read_line_vplayer, NULL, "vplayer" },
+	    { sub_read_line_rt, NULL, "rt" },
+	    { sub_read_line_ssa, sub_pp_ssa, "ssa" },
+	    { sub_read_line_pjs, NULL, "pjs" },
+	    { sub_read_line_mpsub, NULL, "mpsub" },
+	    { sub_read_line_aqt, NULL, "aqt" },
+	    { sub_read_line_subviewer2, NULL, "subviewer 2.0" },
+	    { sub_read_line_subrip09, NULL, "subrip 0.9" },
+	    { sub_read_line_jacosub, NULL, "jacosub" },
+	    { sub_read_line_mpl2, NULL, "mpl2" },
+	    { sub_read_line_google, NULL, "google" },
+    };
+    const struct subreader *srp;
+
+    fd=open_stream (filename, NULL, NULL); if (!fd) return NULL;
+
+    sub_format = SUB_INVALID;
+    for (utf16 = 0; sub_format == SUB_INVALID && utf16 < 3; utf16++) {
+        sub_format=sub_autodetect (fd, &uses_time, utf16);
+        stream_reset(fd);
+        stream_seek(fd,0);
+    }
+    utf16--;
+
+    if (sub_format==SUB_INVALID) {mp_msg(MSGT_SUBREADER,MSGL_WARN,"SUB: Could not determine file format\n");return NULL;}
+    srp=sr+sub_format;
+    mp_msg(MSGT_SUBREADER, MSGL_V, "SUB: Detected subtitle file format: %s\n", srp->name);
+
+    sub_utf8_prev=sub_utf8;
+    {
+	    int l,k;
+	    k = -1;
+	    if ((l=strlen(filename))>4){
+		    static const char exts[][8] = {".utf", ".utf8", ".utf-8" };
+		    for (k=3;--k>=0;)
+			if (l >= strlen(exts[k]) && !av_strcasecmp(filename+(l - strlen(exts[k])), exts[k])){
+			    sub_utf8 = 1;
+			    break;
+			}
+	    }
+	    if (k<0) subcp_open(fd);
+    }
+
+    if (sub_stream_load &&
+        (subt_data = sub_stream_start(filename, fd, srp, utf16, uses_time, fps)))
+        return subt_data;
+
+    sub_read_state_init(&rs, uses_time);
+    sub_num=0;n_max=32;
+    first=malloc(n_max*sizeof(subtitle));
+    if(!first){
+	  subcp_close();
+          sub_utf8=sub_utf8_prev;
+	    return NULL;
+    }
+
+    while(1){
+        if(sub_num>=n_max){
+            n_max+=16;
+            first=realloc(first,n_max*sizeof(subtitle));
+        }
+	sub = &first[sub_num];
+	memset(sub, '\0', sizeof(subtitle));
+        sub=srp->read(fd,sub,utf16,&rs);
+        if(!sub) break;   // EOF
+	if ((sub!=ERR) && sub_utf8 == 2 && utf16 == 0) subcp_recode(sub);
+	if ( sub == ERR || !sub_fribidi(sub,sub_utf8,0))
+	 {
+          subcp_close();
+	  free(first);
+	  free(alloced_sub);
+	  return NULL;
+	 }
+        // Apply any post processing that needs recoding first
+        if ((sub!=ERR) && !sub_no_text_pp && srp->post) srp->post(sub);
+        if(sub==ERR) ++sub_errs; else ++sub_num; // Error vs. Valid
+    }
+
+    free_stream(fd);
+
+    subcp_close();
+    free(alloced_sub);
+
+//    printf ("SUB: Subtitle format %s time.\n", uses_time?"uses":"doesn't use");
+    mp_msg(MSGT_SUBREADER, MSGL_V,"SUB: Read %i subtitles, %i bad line(s).\n",
+           sub_num, sub_errs);
+
+    if(sub_num<=0){
+	free(first);
+	return NULL;
+    }
+
+if (sub_wants_overlap()) {
+    adjust_subs_time(first, 6.0, fps, 0, sub_num, uses_time);/*~6 secs AST*/
+    second = sub_merge_overlaps(first, sub_num, &sub_num);
     free(first);
 
     return_sub = second;
@@ -1553,9 +1859,15 @@ if ((suboverlap_enabled == 2) ||
     subt_data->sub_num = sub_num;
     subt_data->sub_errs = sub_errs;
     subt_data->subtitles = return_sub;
+    subt_data->loader = NULL;
     return subt_data;
 }
 
+sub_data* sub_read_file (const char *filename, float fps) {
+    if(filename==NULL) return NULL; //qnx segfault
+    return read_sub_file(filename, fps);
+}
+
 static void strcpy_trim(char *d, const char *s)
 {
     // skip leading whitespace
@@ -1600,17 +1912,6 @@ static void strcpy_strip_ext_lower(char *d, const char *s)
     }
 }
 
-static void strcpy_get_ext(char *d, const char *s)
-{
-    char *tmp = strrchr(s,'.');
-    if (!tmp) {
-	strcpy(d, "");
-	return;
-    } else {
-	strcpy(d, tmp+1);
-   }
-}
-
 static int whiteonly(const char *s)
 {
     while (*s) {
@@ -1642,160 +1943,361 @@ struct sub_list {
     int sid;
 };
 
-/**
- * @brief Append all the subtitles in the given path matching fname
- *
- * @param path Look for subtitles in this directory
- * @param fname Subtitle filename (pattern)
- * @param limit_fuzziness Ignore flag when sub_fuziness == 2
- */
-static void append_dir_subtitles(struct sub_list *slist, const char *path,
-                                 const char *fname, int limit_fuzziness)
+// the first three are UTF-8 coded and get a bonus
+static const char * const sub_exts[] = {"utf", "utf8", "utf-8", "sub", "srt", "smi", "rt", "txt", "ssa", "aqt", "jss", "js", "ass", NULL};
+
+/* The subtitle files of a directory, read once rather than for every file
+ * played from it. An index is rebuilt when the directory mtime changes,
+ * or when it was built in the same second the directory was last changed
+ * and may have missed part of that change. */
+
+#define SUB_DIR_CACHE_SIZE 8
+
+typedef struct sub_dir_entry {
+    char *name;         ///< as returned by readdir()
+    char *trim;         ///< lowercase, without extension, whitespace trimmed
+    int ext;            ///< index into sub_exts[]
+    int next;           ///< next entry in the same hash chain, -1 ends it
+} sub_dir_entry;
+
+typedef struct sub_dir_index {
+    struct sub_dir_index *next;     ///< LRU order
+    char *path;
+    time_t mtime;
+    time_t built;
+    sub_dir_entry *entries;
+    int num;
+    int *bucket;                    ///< first entry of each chain, -1 if empty
+    unsigned int mask;
+} sub_dir_index;
+
+static sub_dir_index *sub_dir_cache;
+
+static unsigned int sub_name_hash(const char *s)
+{
+    // FNV-1a
+    unsigned int h = 2166136261U;
+    for (; *s; s++)
+        h = (h ^ (unsigned char)*s) * 16777619U;
+    return h;
+}
+
+static void sub_dir_index_free(sub_dir_index *idx)
 {
-    char *f_fname, *f_fname_noext, *f_fname_trim, *tmp, *tmp_sub_id;
-    char *tmp_fname_noext, *tmp_fname_trim, *tmp_fname_ext, *tmpresult;
+    int i;
 
-    int len, found, i;
-    char *sub_exts[] = {"utf", "utf8", "utf-8", "sub", "srt", "smi", "rt", "txt", "ssa", "aqt", "jss", "js", "ass", NULL};
+    for (i = 0; i < idx->num; i++) {
+        free(idx->entries[i].name);
+        free(idx->entries[i].trim);
+    }
+    free(idx->entries);
+    free(idx->bucket);
+    free(idx->path);
+    free(idx);
+}
 
-    FILE *f;
+// case-insensitive, so that movie.sub still finds movie.IDX
+static int compare_names(const void *a, const void *b)
+{
+    return av_strcasecmp(*(char * const *)a, *(char * const *)b);
+}
 
+static sub_dir_index *sub_dir_index_build(const char *path, time_t mtime)
+{
+    sub_dir_index *idx;
     DIR *d;
     struct dirent *de;
+    char **names = NULL, **tmp;
+    int num_names = 0, max_names = 0, i, j;
+    unsigned int size;
+
+    d = opendir(path);
+    if (!d)
+        return NULL;
+    while ((de = readdir(d))) {
+        if (num_names == max_names) {
+            max_names = 2 * max_names + 64;
+            tmp = realloc(names, max_names * sizeof(*names));
+            if (!tmp)
+                break;
+            names = tmp;
+        }
+        if (!(names[num_names] = strdup(de->d_name)))
+            break;
+        num_names++;
+    }
+    closedir(d);
+    // sorted, so that vobsub .idx files can be looked up
+    qsort(names, num_names, sizeof(*names), compare_names);
+
+    idx = calloc(1, sizeof(*idx));
+    if (!idx || !(idx->path = strdup(path)))
+        goto fail;
+    idx->mtime = mtime;
+    idx->built = time(NULL);
+
+    for (i = 0; i < num_names; i++) {
+        char *name = names[i];
+        char *ext = strrchr(name, '.');
+        sub_dir_entry *e;
+
+        // does it end with a subtitle extension?
+        if (!ext)
+            continue;
+        for (j = 0; sub_exts[j]; j++)
+            if (av_strcasecmp(sub_exts[j], ext + 1) == 0)
+                break;
+        if (!sub_exts[j])
+            continue;
+
+        // If it's a .sub, check if there is a .idx with the same name. If
+        // there is one, it's certainly a vobsub so we skip it.
+        if (av_strcasecmp(ext + 1, "sub") == 0) {
+            char *idxname = strdup(name);
+            int vobsub;
+
+            if (!idxname)
+                continue;
+            strcpy(idxname + (ext + 1 - name), "idx");
+            vobsub = !!bsearch(&idxname, names, num_names, sizeof(*names),
+                               compare_names);
+            free(idxname);
+            if (vobsub)
+                continue;
+        }
 
-    len = (strlen(fname) > 256 ? strlen(fname) : 256)
-         + (strlen(path) > 256 ? strlen(path) : 256) + 2;
+        if (!(idx->num & (idx->num + 1))) {
+            e = realloc(idx->entries, (2 * idx->num + 1) * sizeof(*e));
+            if (!e)
+                goto fail;
+            idx->entries = e;
+        }
+        e = &idx->entries[idx->num];
+        e->name = strdup(name);
+        e->trim = malloc(strlen(name) + 1);
+        e->ext  = j;
+        idx->num++;
+        if (!e->name || !e->trim)
+            goto fail;
+        strcpy_strip_ext_lower(e->trim, name);
+        strcpy_trim(e->trim, e->trim);
+    }
 
-    f_fname       = strdup(mp_basename(fname));
-    f_fname_noext = malloc(len);
-    f_fname_trim  = malloc(len);
+    for (size = 1; size < 2 * idx->num; size <<= 1)
+        ;
+    idx->mask   = size - 1;
+    idx->bucket = malloc(size * sizeof(*idx->bucket));
+    if (!idx->bucket)
+        goto fail;
+    memset(idx->bucket, -1, size * sizeof(*idx->bucket));
+    for (i = idx->num - 1; i >= 0; i--) {
+        unsigned int h = sub_name_hash(idx->entries[i].trim) & idx->mask;
+        idx->entries[i].next = idx->bucket[h];
+        idx->bucket[h] = i;
+    }
 
-    tmp_fname_noext = malloc(len);
-    tmp_fname_trim  = malloc(len);
-    tmp_fname_ext   = malloc(len);
+    for (i = 0; i < num_names; i++)
+        free(names[i]);
+    free(names);
+    mp_msg(MSGT_SUBREADER, MSGL_V, "SUB: Indexed %d of %d files in %s\n",
+           idx->num, num_names, path);
+    return idx;
+
+fail:
+    for (i = 0; i < num_names; i++)
+        free(names[i]);
+    free(names);
+    if (idx)
+        sub_dir_index_free(idx);
+    return NULL;
+}
 
-    tmpresult = malloc(len);
+/// Free all cached directory indexes.
+void sub_dir_cache_free(void)
+{
+    while (sub_dir_cache) {
+        sub_dir_index *idx = sub_dir_cache;
+        sub_dir_cache = idx->next;
+        sub_dir_index_free(idx);
+    }
+}
 
-    strcpy_strip_ext_lower(f_fname_noext, f_fname);
-    strcpy_trim(f_fname_trim, f_fname_noext);
+/// Find the index of path in the cache, building it if needed.
+static sub_dir_index *sub_dir_index_get(const char *path)
+{
+    sub_dir_index **p, *idx;
+    struct stat st;
+    int n;
+
+    if (stat(path, &st) < 0 || !S_ISDIR(st.st_mode))
+        return NULL;
+
+    for (p = &sub_dir_cache; *p; p = &(*p)->next)
+        if (!strcmp((*p)->path, path))
+            break;
+    idx = *p;
+    if (idx) {
+        *p = idx->next;
+        if (idx->mtime != st.st_mtime || idx->mtime >= idx->built) {
+            sub_dir_index_free(idx);
+            idx = NULL;
+        }
+    }
+    if (!idx)
+        idx = sub_dir_index_build(path, st.st_mtime);
+    if (!idx)
+        return NULL;
+
+    // most recently used first, drop the ones past the end
+    idx->next = sub_dir_cache;
+    sub_dir_cache = idx;
+    for (n = 1, p = &idx->next; *p; n++) {
+        if (n < SUB_DIR_CACHE_SIZE) {
+            p = &(*p)->next;
+        } else {
+            sub_dir_index *old = *p;
+            *p = old->next;
+            sub_dir_index_free(old);
+        }
+    }
+    return idx;
+}
+
+/**
+ * @brief Score a subtitle file against the movie name
+ *
+ * @param trim Normalized subtitle filename
+ * @param f_fname_trim Normalized movie filename
+ * @param sub_id Normalized -slang, or NULL
+ * @param lang_name f_fname_trim followed by sub_id
+ * @return 0 if the file does not match
+ */
+static int sub_priority(const char *trim, const char *f_fname_trim,
+                        const char *sub_id, const char *lang_name,
+                        int limit_fuzziness)
+{
+    const char *tmp;
+
+    mp_msg(MSGT_SUBREADER, MSGL_DBG2, "Potential sub: %s\n", trim);
+    if (lang_name && strcmp(trim, lang_name) == 0 && sub_match_fuzziness >= 1) {
+        // matches the movie name + lang extension
+        return 5;
+    }
+    if (strcmp(trim, f_fname_trim) == 0) {
+        // matches the movie name
+        return 4;
+    }
+    if ((tmp = strstr(trim, f_fname_trim)) && (sub_match_fuzziness >= 1)) {
+        // contains the movie name
+        tmp += strlen(f_fname_trim);
+        if (sub_id && strstr(tmp, sub_id)) {
+            // with sub_id specified prefer localized subtitles
+            return 3;
+        } else if ((sub_id == NULL) && whiteonly(tmp)) {
+            // without sub_id prefer "plain" name
+            return 3;
+        } else {
+            // with no localized subs found, try any else instead
+            return 2;
+        }
+    }
+    // doesn't contain the movie name
+    if (!limit_fuzziness && sub_match_fuzziness >= 2)
+        return 1;
+    return 0;
+}
+
+static void append_dir_subtitle(struct sub_list *slist, const char *path,
+                                const sub_dir_entry *e, int prio)
+{
+    char *subpath;
+    FILE *f;
+
+    prio += prio;
+    if (e->ext < 3) { // prefer UTF-8 coded
+        prio++;
+    }
+    subpath = mp_dir_join(path, e->name);
+    // fprintf(stderr, "%s priority %d\n", subpath, prio);
+    if ((f = fopen(subpath, "rt"))) {
+        struct subfn *sub = &slist->subs[slist->sid++];
+
+        fclose(f);
+        sub->priority = prio;
+        sub->fname    = subpath;
+    } else
+        free(subpath);
+}
+
+/**
+ * @brief Append all the subtitles in the given path matching fname
+ *
+ * @param path Look for subtitles in this directory
+ * @param fname Subtitle filename (pattern)
+ * @param limit_fuzziness Ignore flag when sub_fuziness == 2
+ */
+static void append_dir_subtitles(struct sub_list *slist, const char *path,
+                                 const char *fname, int limit_fuzziness)
+{
+    const char *f_fname = mp_basename(fname);
+    char *f_fname_trim, *tmp_sub_id = NULL, *lang_name = NULL;
+    const sub_dir_entry *e;
+    sub_dir_index *idx;
+    int i, prio;
+
+    idx = sub_dir_index_get(path);
+    if (!idx)
+        return;
+    mp_msg(MSGT_SUBREADER, MSGL_INFO, "Load subtitles in %s\n", path);
+
+    f_fname_trim = malloc(strlen(f_fname) + 1);
+    if (!f_fname_trim)
+        return;
+    strcpy_strip_ext_lower(f_fname_trim, f_fname);
+    strcpy_trim(f_fname_trim, f_fname_trim);
 
-    tmp_sub_id = NULL;
     if (sub_lang && !whiteonly(sub_lang)) {
         tmp_sub_id = malloc(strlen(sub_lang) + 1);
-        strcpy_trim(tmp_sub_id, sub_lang);
+        lang_name  = malloc(strlen(f_fname_trim) + strlen(sub_lang) + 2);
+        if (tmp_sub_id && lang_name) {
+            strcpy_trim(tmp_sub_id, sub_lang);
+            sprintf(lang_name, "%s %s", f_fname_trim, tmp_sub_id);
+        } else {
+            free(tmp_sub_id);
+            free(lang_name);
+            tmp_sub_id = lang_name = NULL;
+        }
     }
 
     // 0 = nothing
     // 1 = any subtitle file
     // 2 = any sub file containing movie name
     // 3 = sub file containing movie name and the lang extension
-    d = opendir(path);
-    if (d) {
-        mp_msg(MSGT_SUBREADER, MSGL_INFO, "Load subtitles in %s\n", path);
-        while ((de = readdir(d))) {
-            // retrieve various parts of the filename
-            strcpy_strip_ext_lower(tmp_fname_noext, de->d_name);
-            strcpy_get_ext(tmp_fname_ext, de->d_name);
-            strcpy_trim(tmp_fname_trim, tmp_fname_noext);
-
-            // If it's a .sub, check if there is a .idx with the same name. If
-            // there is one, it's certainly a vobsub so we skip it.
-            if (av_strcasecmp(tmp_fname_ext, "sub") == 0) {
-                char *idx, *idxname = strdup(de->d_name);
-
-                strcpy(idxname + strlen(de->d_name) - sizeof("idx") + 1, "idx");
-                idx = mp_dir_join(path, idxname);
-                free(idxname);
-                f = fopen(idx, "rt");
-                free(idx);
-                if (f) {
-                    fclose(f);
-                    continue;
-                }
-            }
-
-            // does it end with a subtitle extension?
-            found = 0;
-            for (i = (sub_cp ? 3 : 0); sub_exts[i]; i++) {
-                if (av_strcasecmp(sub_exts[i], tmp_fname_ext) == 0) {
-                    found = 1;
-                    break;
-                }
-            }
-
-            // we have a (likely) subtitle file
-            if (found) {
-                int prio = 0;
-                if (!prio && tmp_sub_id)
-                {
-                    sprintf(tmpresult, "%s %s", f_fname_trim, tmp_sub_id);
-                    mp_msg(MSGT_SUBREADER, MSGL_DBG2, "Potential sub: %s\n", tmp_fname_trim);
-                    if (strcmp(tmp_fname_trim, tmpresult) == 0 && sub_match_fuzziness >= 1) {
-                        // matches the movie name + lang extension
-                        prio = 5;
-                    }
-                }
-                if (!prio && strcmp(tmp_fname_trim, f_fname_trim) == 0) {
-                    // matches the movie name
-                    prio = 4;
-                }
-                if (!prio && (tmp = strstr(tmp_fname_trim, f_fname_trim)) && (sub_match_fuzziness >= 1)) {
-                    // contains the movie name
-                    tmp += strlen(f_fname_trim);
-                    if (tmp_sub_id && strstr(tmp, tmp_sub_id)) {
-                        // with sub_id specified prefer localized subtitles
-                        prio = 3;
-                    } else if ((tmp_sub_id == NULL) && whiteonly(tmp)) {
-                        // without sub_id prefer "plain" name
-                        prio = 3;
-                    } else {
-                        // with no localized subs found, try any else instead
-                        prio = 2;
-                    }
-                }
-                if (!prio) {
-                    // doesn't contain the movie name
-                    if (!limit_fuzziness && sub_match_fuzziness >= 2) {
-                        prio = 1;
-                    }
-                }
-
-                if (prio) {
-                    char *subpath;
-                    prio += prio;
-                    if (i < 3){ // prefer UTF-8 coded
-                        prio++;
-                    }
-                    subpath = mp_dir_join(path, de->d_name);
-                    // fprintf(stderr, "%s priority %d\n", subpath, prio);
-                    if ((f = fopen(subpath, "rt"))) {
-                        struct subfn *sub = &slist->subs[slist->sid++];
-
-                        fclose(f);
-                        sub->priority = prio;
-                        sub->fname    = subpath;
-                    } else
-                        free(subpath);
-                }
-
-            }
-            if (slist->sid >= MAX_SUBTITLE_FILES)
-                break;
+    if (sub_match_fuzziness < 1) {
+        // only an exact name match can score, so one hash chain holds them all
+        for (i = idx->bucket[sub_name_hash(f_fname_trim) & idx->mask];
+             i >= 0 && slist->sid < MAX_SUBTITLE_FILES; i = e->next) {
+            e = &idx->entries[i];
+            if (sub_cp && e->ext < 3)
+                continue;
+            if (strcmp(e->trim, f_fname_trim) == 0)
+                append_dir_subtitle(slist, path, e, 4);
+        }
+    } else {
+        for (i = 0; i < idx->num && slist->sid < MAX_SUBTITLE_FILES; i++) {
+            e = &idx->entries[i];
+            if (sub_cp && e->ext < 3)
+                continue;
+            prio = sub_priority(e->trim, f_fname_trim, tmp_sub_id, lang_name,
+                                limit_fuzziness);
+            if (prio)
+                append_dir_subtitle(slist, path, e, prio);
         }
-        closedir(d);
     }
 
     free(tmp_sub_id);
-
-    free(f_fname);
-    free(f_fname_noext);
+    free(lang_name);
     free(f_fname_trim);
-
-    free(tmp_fname_noext);
-    free(tmp_fname_trim);
-    free(tmp_fname_ext);
-
-    free(tmpresult);
 }
 
 /**
@@ -1866,7 +2368,10 @@ void load_subtitles(const char *fname, float fps, open_sub_func add_f)
 
 void list_sub_file(sub_data* subd){
     int i,j;
-    subtitle *subs = subd->subtitles;
+    subtitle *subs;
+
+    sub_stream_join(subd);
+    subs = subd->subtitles;
 
     for(j=0; j < subd->sub_num; j++){
 	subtitle* egysub=&subs[j];
@@ -1888,13 +2393,18 @@ void list_sub_file(sub_data* subd){
 
 void sub_free( sub_data * subd )
 {
-    int i, j;
-
     if ( !subd ) return;
 
-    for (i = 0; i < subd->sub_num; i++)
-        for (j = 0; j < subd->subtitles[i].lines; j++)
-            free( subd->subtitles[i].text[j] );
+    if (subd->loader) {
+        sub_lock(subd);
+        subd->loader->quit = 1;
+        sub_unlock(subd);
+        sub_stream_join(subd);
+        subd->sub_num += subd->loader->dropped;
+        pthread_mutex_destroy(&subd->loader->lock);
+        free(subd->loader);
+    }
+    free_sub_texts(subd->subtitles, subd->sub_num);
     free( subd->subtitles );
     free( subd->filename );
     free( subd );
@@ -26,6 +26,7 @@
 extern int suboverlap_enabled;
 extern int sub_no_text_pp;  // disable text post-processing
 extern int sub_match_fuzziness;
+extern int sub_stream_load;
 extern int sub_format;
 extern char *sub_cp;
 extern char *enca_sub_cp;
@@ -73,12 +74,15 @@ typedef struct {
     unsigned char alignment;
 } subtitle;
 
+struct sub_loader;
+
 typedef struct {
     subtitle *subtitles;
     char *filename;
     int sub_uses_time;
     int sub_num;          // number of subtitle structs
     int sub_errs;
+    struct sub_loader *loader; // background reader with -sub-stream, else NULL
 } sub_data;
 
 extern char *fribidi_charset;
@@ -99,6 +103,11 @@ const char* guess_buffer_cp(unsigned char* buffer, int buflen, const char *prefe
 void load_subtitles(const char *fname, float fps, open_sub_func add_f);
 void load_vob_subtitle(const char *fname, const char * const spudec_ifo, void **spu, open_vob_func add_f);
 void sub_free( sub_data * subd );
+// drop the cached subtitle listings of the directories seen so far
+void sub_dir_cache_free(void);
+// guard subtitles and sub_num while a background load may append to them
+void sub_lock(sub_data *subd);
+void sub_unlock(sub_data *subd);
 void find_sub(sub_data* subd,int key);
 void step_sub(sub_data *subd, float pts, int movement);
 void sub_add_text(subtitle *sub, const char *txt, int len, double endpts, int strip_markup);
@@ -0,0 +1,34 @@
+#!/bin/sh
+# A per-file config must also apply to the entry that -gapless opens in
+# advance: the second file selects its second (mono) audio stream
+# through file2.mka.conf, which the preload must not bypass.
+#
+# usage: tests/gapless-aid.sh [path/to/mplayer]
+
+MPLAYER=${1:-./mplayer}
+FFMPEG=${FFMPEG:-ffmpeg}
+
+command -v "$FFMPEG" >/dev/null 2>&1 || { echo "$FFMPEG not found, skipped"; exit 0; }
+
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+
+# two audio streams: 0 is stereo, 1 is mono
+for f in file1 file2; do
+    "$FFMPEG" -v error -y \
+        -f lavfi -i "sine=d=2,aformat=channel_layouts=stereo" \
+        -f lavfi -i "sine=d=2:f=880,aformat=channel_layouts=mono" \
+        -map 0 -map 1 -c:a pcm_s16le "$dir/$f.mka" || exit 1
+done
+echo "aid=1" > "$dir/file2.mka.conf"
+
+"$MPLAYER" -noconfig all -use-filedir-conf -gapless -identify \
+    -vo null -ao null -nocache "$dir/file1.mka" "$dir/file2.mka" \
+    > "$dir/out" 2>&1 || { cat "$dir/out"; exit 1; }
+
+nch=$(sed -n 's/^ID_AUDIO_NCH=//p' "$dir/out" | tr '\n' ' ')
+if [ "$nch" != "2 1 " ]; then
+    echo "expected ID_AUDIO_NCH 2 then 1, got: $nch"
+    exit 1
+fi
+echo "ok"